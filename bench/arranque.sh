@@ -0,0 +1,45 @@
+#!/bin/sh
+#
+# Mide el tiempo desde que arranca el simulador hasta que envía el primer
+# turno, compilando una versión con el número de equipos, naves y tamaño de
+# mapa indicados.
+#
+# Uso: bench/arranque.sh [equipos] [naves_por_equipo] [lado_mapa]
+#
+
+EQUIPOS=${1:-4}
+NAVES=${2:-2500}
+LADO=${3:-128}
+
+RAIZ=$(cd "$(dirname "$0")/.." && pwd)
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+make -s -C "$RAIZ/src" simulador TARGET="$DIR" \
+	CPPFLAGS="-DN_EQUIPOS=$EQUIPOS -DN_NAVES=$NAVES -DMAPA_MAXX=$LADO -DMAPA_MAXY=$LADO" || exit 1
+
+# El simulador va en su propio grupo de procesos para poder terminar a todos
+setsid "$DIR/simulador" > "$DIR/salida" 2>&1 &
+PID=$!
+
+for i in $(seq 1 300); do
+	grep -q "primer turno" "$DIR/salida" && break
+	sleep 0.1
+done
+
+# Jefes y naves en segundo plano ignoran SIGINT: se terminan con SIGTERM y
+# después el simulador libera los recursos al recibir SIGINT
+for HIJO in $(pgrep -g "$PID"); do
+	[ "$HIJO" != "$PID" ] && kill -TERM "$HIJO" 2>/dev/null
+done
+kill -INT "$PID" 2>/dev/null
+wait "$PID" 2>/dev/null
+
+LINEA=$(grep "primer turno" "$DIR/salida")
+if [ -z "$LINEA" ]; then
+	echo "ERROR: el simulador no llegó al primer turno"
+	tail -5 "$DIR/salida"
+	exit 1
+fi
+
+echo "$EQUIPOS equipos x $NAVES naves, mapa ${LADO}x${LADO}: ${LINEA#Simulador: }"
@@ -0,0 +1,42 @@
+#!/bin/sh
+#
+# Compara el rendimiento de las compilaciones debug, release y pgo jugando la
+# misma partida sin procesos (semilla fija) con cada una. Todas se compilan
+# con el mismo tamaño de mapa y número de naves.
+#
+# Uso: bench/compilaciones.sh [repeticiones] [turnos] [semilla]
+#      NAVES y LADO fijan el tamaño (200 naves por equipo, mapa de 128x128);
+#      OPT y MARCH se pasan a las versiones optimizadas (p. ej. MARCH=native)
+#
+
+REPETICIONES=${1:-5}
+TURNOS=${2:-300}
+SEMILLA=${3:-1}
+
+RAIZ=$(cd "$(dirname "$0")/.." && pwd)
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+OPCIONES="CPPFLAGS=-DN_NAVES=${NAVES:-200} -DMAPA_MAXX=${LADO:-128} -DMAPA_MAXY=${LADO:-128}"
+OPTIMIZACION="OPT=${OPT:--O2}"
+[ -n "$MARCH" ] && OPTIMIZACION="$OPTIMIZACION MARCH=$MARCH"
+
+make -s -C "$RAIZ/src" simulador TARGET="$DIR" "$OPCIONES" > /dev/null || exit 1
+make -s -C "$RAIZ/src" release TARGET="$DIR" "$OPCIONES" $OPTIMIZACION > /dev/null || exit 1
+make -s -C "$RAIZ/src" pgo TARGET="$DIR" "$OPCIONES" $OPTIMIZACION PGO_PARTIDA="-H $SEMILLA -t $TURNOS" > /dev/null || exit 1
+
+echo "# naves=${NAVES:-200} lado=${LADO:-128} turnos=$TURNOS semilla=$SEMILLA repeticiones=$REPETICIONES"
+echo "# variante turnos acciones mediana_turnos/s mejor_turnos/s"
+for VARIANTE in debug release pgo; do
+	case $VARIANTE in
+		debug) BIN="$DIR/simulador" ;;
+		*) BIN="$DIR/$VARIANTE/simulador" ;;
+	esac
+	for i in $(seq 1 "$REPETICIONES"); do
+		"$BIN" -H "$SEMILLA" -t "$TURNOS" -v 0 | grep "^Partida sin procesos"
+	done | tr -d '(,' | sort -n -k 13 | awk -v v="$VARIANTE" '{
+		turnos = $6; acciones = $8; t[NR] = $13
+	} END {
+		printf "%s %d %d %.1f %.1f\n", v, turnos, acciones, t[int((NR + 1) / 2)], t[NR]
+	}'
+done
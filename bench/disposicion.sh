@@ -0,0 +1,52 @@
+#!/bin/sh
+#
+# Compara el coste de las consultas en un cuadrado alrededor de una casilla
+# (src/cajas.c) con cada orden de las casillas en memoria: por filas, por
+# teselas y Morton dentro de las teselas. Todos leen las mismas casillas, así
+# que la columna de ocupadas tiene que coincidir entre órdenes.
+#
+# Uso: bench/disposicion.sh [repeticiones] [lado_mapa] [consultas]
+#      TESELA fija el lado de las teselas (8 por defecto); OPT y MARCH se
+#      pasan a la compilación como en la versión release
+#
+
+REPETICIONES=${1:-5}
+LADO=${2:-1024}
+CONSULTAS=${3:-1000000}
+TESELA=${TESELA:-8}
+
+RAIZ=$(cd "$(dirname "$0")/.." && pwd)
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+# Naves suficientes para ocupar el 10% del mapa entre los 4 equipos
+NAVES=$((LADO * LADO / 40 + 1))
+CFLAGS_CAJAS="${OPT:--O2} $([ -n "$MARCH" ] && echo "-march=$MARCH") -flto=auto -g -Wall -pthread -I."
+
+echo "# repeticiones=$REPETICIONES lado=$LADO consultas=$CONSULTAS tesela=$TESELA cpus=$(nproc)"
+echo "# orden radio mediana_ns_consulta mediana_ns_casilla ocupadas frente_a_filas"
+for ORDEN in 0 1 2; do
+	case $ORDEN in
+		0) NOMBRE=filas ;;
+		1) NOMBRE=teselas ;;
+		2) NOMBRE=morton ;;
+	esac
+	OPCIONES="CPPFLAGS=-DMAPA_MAXX=$LADO -DMAPA_MAXY=$LADO -DN_NAVES=$NAVES -DMAPA_ORDEN=$ORDEN -DMAPA_TESELA=$TESELA"
+	if ! make -s -C "$RAIZ/src" cajas TARGET="$DIR/$NOMBRE" "$OPCIONES" CFLAGS="$CFLAGS_CAJAS" > "$DIR/$NOMBRE.log" 2>&1; then
+		cat "$DIR/$NOMBRE.log"
+		echo "$NOMBRE no compila"
+		continue
+	fi
+
+	for i in $(seq 1 "$REPETICIONES"); do
+		"$DIR/$NOMBRE/cajas" -c "$CONSULTAS" | grep -v '^#'
+	done > "$DIR/$NOMBRE.medidas"
+
+	# Mediana por radio
+	for RADIO in $(awk '{ print $1 }' "$DIR/$NOMBRE.medidas" | sort -n -u); do
+		awk -v r="$RADIO" '$1 == r' "$DIR/$NOMBRE.medidas" | sort -n -k 2 |
+			awk -v n="$NOMBRE" '{ t[NR] = $0 } END { split(t[int((NR + 1) / 2)], c, " "); print n, c[1], c[2], c[3], c[4] }'
+	done >> "$DIR/medianas"
+done
+
+awk '$1 == "filas" { base[$2] = $3 } { printf "%s %d %.2f %.3f %d %+.1f%%\n", $1, $2, $3, $4, $5, (base[$2] > 0) ? ($3 / base[$2] - 1) * 100 : 0 }' "$DIR/medianas"
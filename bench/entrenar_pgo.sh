@@ -0,0 +1,27 @@
+#!/bin/sh
+#
+# Carga de entrenamiento de la compilación PGO (la usa 'make pgo'). Juega una
+# partida sin procesos con semilla fija y después dibuja con el monitor el mapa
+# de un simulador en modo externo con carga del generador.
+#
+# Uso: bench/entrenar_pgo.sh directorio_binarios "opciones_partida"
+#
+
+DIR=$(cd "$1" && pwd)
+PARTIDA=${2:-"-H 1 -t 300"}
+
+cd "$DIR" || exit 1
+./simulador $PARTIDA -v 0 | grep "^Partida sin procesos"
+
+# El monitor necesita el mapa de un simulador en marcha; sin terminal dibuja
+# sobre /dev/null con las dimensiones por defecto de TERM
+setsid ./simulador -e -s -v 0 > salida_pgo 2>&1 &
+PID=$!
+for i in $(seq 1 50); do
+	grep -q "primer turno" salida_pgo && break
+	sleep 0.1
+done
+TERM=xterm ./monitor -r 500 > /dev/null < /dev/null
+kill -INT $PID
+wait $PID
+rm -f salida_pgo
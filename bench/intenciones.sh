@@ -0,0 +1,16 @@
+#!/bin/sh
+#
+# Prueba que el simulador no se queda esperando a una nave que muere a mitad
+# de publicar su intención (src/prueba_intencion.c). Se compila con pocas
+# naves en un directorio temporal; sale con 0 si la prueba pasa.
+#
+# Uso: bench/intenciones.sh
+#
+
+RAIZ=$(cd "$(dirname "$0")/.." && pwd)
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+make -s -C "$RAIZ/src" prueba_intencion TARGET="$DIR" \
+	CPPFLAGS="-DN_EQUIPOS=2 -DN_NAVES=4" || exit 1
+"$DIR/prueba_intencion"
@@ -0,0 +1,141 @@
+#!/bin/sh
+#
+# Suite de regresión: juega sin procesos cada escenario de
+# bench/regresion/escenarios.txt (tamaño de mapa, equipos, naves y semilla
+# fijos) y compara
+#   - el resultado (turnos, acciones, ganador y hash del estado final) con
+#     bench/regresion/esperado.txt, que debe coincidir exactamente, y
+#   - los turnos/s y el tiempo medio por turno de cada fase (decisión,
+#     aplicación y resolución) con bench/regresion/rendimiento.txt, con una
+#     tolerancia de TOLERANCIA por ciento.
+# Termina con error si algún escenario no coincide o es más lento.
+#
+# Uso: bench/regresion.sh [-a] [repeticiones] [escenario...]
+#      -a rehace esperado.txt y rendimiento.txt con lo medido en esta máquina;
+#      TOLERANCIA (25 por defecto) es el porcentaje de pérdida admitido y
+#      MARGEN_US (1 por defecto) los microsegundos que puede crecer una fase
+#      además de la tolerancia, para que las fases muy cortas no den ruido;
+#      DEFINES se añade a la compilación (p. ej. DEFINES=-DMAPA_ORDEN=2) para
+#      comprobar que una variante da los mismos resultados
+#
+
+ACTUALIZAR=0
+if [ "$1" = "-a" ]; then
+	ACTUALIZAR=1
+	shift
+fi
+REPETICIONES=${1:-5}
+[ $# -gt 0 ] && shift
+TOLERANCIA=${TOLERANCIA:-25}
+MARGEN_US=${MARGEN_US:-1}
+
+RAIZ=$(cd "$(dirname "$0")/.." && pwd)
+ESCENARIOS="$RAIZ/bench/regresion/escenarios.txt"
+ESPERADO="$RAIZ/bench/regresion/esperado.txt"
+RENDIMIENTO="$RAIZ/bench/regresion/rendimiento.txt"
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+: > "$DIR/esperado"
+: > "$DIR/rendimiento"
+
+echo "# repeticiones=$REPETICIONES tolerancia=$TOLERANCIA% margen=${MARGEN_US}us"
+echo "# escenario turnos acciones ganador hash turnos/s decision_us aplicacion_us resolucion_us resultado"
+grep -v '^#' "$ESCENARIOS" | while read -r NOMBRE EQUIPOS NAVES COLUMNAS FILAS SEMILLA TURNOS; do
+	[ -z "$NOMBRE" ] && continue
+	if [ $# -gt 0 ]; then
+		case " $* " in
+			*" $NOMBRE "*) ;;
+			*) continue ;;
+		esac
+	fi
+
+	OPCIONES="CPPFLAGS=-DN_EQUIPOS=$EQUIPOS -DN_NAVES=$NAVES -DMAPA_MAXX=$COLUMNAS -DMAPA_MAXY=$FILAS $DEFINES"
+	if ! make -s -C "$RAIZ/src" release TARGET="$DIR/$NOMBRE" "$OPCIONES" > "$DIR/$NOMBRE.log" 2>&1; then
+		cat "$DIR/$NOMBRE.log"
+		echo "$NOMBRE no compila"
+		echo 1 >> "$DIR/fallos"
+		continue
+	fi
+
+	# Una línea por repetición con el resultado, los turnos/s y las fases
+	for i in $(seq 1 "$REPETICIONES"); do
+		"$DIR/$NOMBRE/release/simulador" -H "$SEMILLA" -t "$TURNOS" -v 0 < /dev/null | tr -d '(,' | awk '
+			/^Partida sin procesos/ { turnos = $6; acciones = $8; tps = $13; ganador = $16 }
+			/^Estado final/ { hash = $3 }
+			/^Fases por turno/ { d = $5; a = $8; r = $11 }
+			END { print turnos, acciones, ganador, hash, tps, d, a, r }'
+	done > "$DIR/$NOMBRE.medidas"
+
+	# Resultado de la primera repetición (todas deben ser iguales) y mediana de cada medida
+	MEDIDA=$(awk -v n="$REPETICIONES" '
+		function mediana(c,    i, j, v, t) {
+			for(i = 1; i <= NR; i++) v[i] = m[i, c]
+			for(i = 2; i <= NR; i++) for(j = i; j > 1 && v[j - 1] > v[j]; j--) { t = v[j]; v[j] = v[j - 1]; v[j - 1] = t }
+			return v[int((NR + 1) / 2)]
+		}
+		{
+			r = $1 " " $2 " " $3 " " $4
+			if(NR == 1) primero = r
+			else if(r != primero) distinto = 1
+			for(c = 5; c <= 8; c++) m[NR, c] = $c
+		}
+		END {
+			if(NR != n || primero == "" || distinto) { print "?"; exit }
+			printf "%s %.1f %.2f %.2f %.2f\n", primero, mediana(5), mediana(6), mediana(7), mediana(8)
+		}' "$DIR/$NOMBRE.medidas")
+	if [ "$MEDIDA" = "?" ]; then
+		cat "$DIR/$NOMBRE.medidas"
+		echo "$NOMBRE FALLO (repeticiones distintas o sin resultado)"
+		echo 1 >> "$DIR/fallos"
+		continue
+	fi
+	RESULTADO=$(echo "$MEDIDA" | cut -d' ' -f1-4)
+	TIEMPOS=$(echo "$MEDIDA" | cut -d' ' -f5-8)
+	echo "$NOMBRE $RESULTADO" >> "$DIR/esperado"
+	echo "$NOMBRE $TIEMPOS" >> "$DIR/rendimiento"
+
+	if [ $ACTUALIZAR -eq 1 ]; then
+		echo "$NOMBRE $MEDIDA actualizado"
+		continue
+	fi
+
+	ESTADO="ok"
+	GOLDEN=$(grep "^$NOMBRE " "$ESPERADO" 2> /dev/null | cut -d' ' -f2-)
+	BASE=$(grep "^$NOMBRE " "$RENDIMIENTO" 2> /dev/null | cut -d' ' -f2-)
+	if [ -z "$GOLDEN" ] || [ -z "$BASE" ]; then
+		ESTADO="FALLO (sin resultado esperado; ejecutar con -a)"
+	elif [ "$GOLDEN" != "$RESULTADO" ]; then
+		ESTADO="FALLO (esperado $GOLDEN)"
+	else
+		LENTO=$(echo "$TIEMPOS $BASE" | awk -v tol="$TOLERANCIA" -v margen="$MARGEN_US" '{
+			f = tol / 100; s = ""
+			if($1 < $5 * (1 - f)) s = s sprintf(" turnos/s %.1f<%.1f", $1, $5)
+			split("decision aplicacion resolucion", fase, " ")
+			for(i = 2; i <= 4; i++)
+				if($i > $(i + 4) * (1 + f) + margen) s = s sprintf(" %s %.2f>%.2f", fase[i - 1], $i, $(i + 4))
+			print s
+		}')
+		[ -n "$LENTO" ] && ESTADO="LENTO ($(echo $LENTO))"
+	fi
+	echo "$NOMBRE $MEDIDA $ESTADO"
+	[ "$ESTADO" != "ok" ] && echo 1 >> "$DIR/fallos"
+done
+
+# Al actualizar solo algunos escenarios se conservan las líneas del resto
+if [ $ACTUALIZAR -eq 1 ]; then
+	{ echo "# escenario turnos acciones ganador hash"; cat "$DIR/esperado"; } > "$DIR/esperado.nuevo"
+	{ echo "# escenario turnos/s decision_us aplicacion_us resolucion_us"; cat "$DIR/rendimiento"; } > "$DIR/rendimiento.nuevo"
+	for FICHERO in esperado rendimiento; do
+		[ "$FICHERO" = esperado ] && DESTINO="$ESPERADO" || DESTINO="$RENDIMIENTO"
+		[ -f "$DESTINO" ] && awk 'NR == FNR { nuevo[$1] = 1; next } !/^#/ && !($1 in nuevo)' \
+			"$DIR/$FICHERO" "$DESTINO" >> "$DIR/$FICHERO.nuevo"
+		cp "$DIR/$FICHERO.nuevo" "$DESTINO"
+	done
+fi
+
+if [ -s "$DIR/fallos" ]; then
+	echo "# $(wc -l < "$DIR/fallos") escenarios con fallos"
+	exit 1
+fi
+echo "# todos los escenarios correctos"
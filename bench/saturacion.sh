@@ -0,0 +1,43 @@
+#!/bin/sh
+#
+# Curva rendimiento-latencia del simulador sin procesos equipo: arranca el
+# simulador en modo externo y sin pausas y lanza el generador de carga con
+# tasas crecientes. Cada línea de salida es un punto de la curva.
+#
+# Uso: bench/saturacion.sh [segundos_por_tasa] [productores] [prob_ataque] [radio_foco] [tasas...]
+#
+
+SEGUNDOS=${1:-3}
+PRODUCTORES=${2:-1}
+ATAQUE=${3:-0.2}
+FOCO=${4:-3} # -1 reparte los ataques por todo el mapa y acaba pronto con las naves
+shift 4 2>/dev/null
+TASAS=${*:-"1000 5000 10000 20000 50000 100000"}
+
+RAIZ=$(cd "$(dirname "$0")/.." && pwd)
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+make -s -C "$RAIZ/src" simulador generador TARGET="$DIR" \
+	CPPFLAGS="-DN_NAVES=${NAVES:-50} -DMAPA_MAXX=${LADO:-64} -DMAPA_MAXY=${LADO:-64}" || exit 1
+
+setsid "$DIR/simulador" -e -s -v 0 > "$DIR/salida" 2>&1 &
+PID=$!
+for i in $(seq 1 50); do
+	grep -q "primer turno" "$DIR/salida" && break
+	sleep 0.1
+done
+
+echo "# productores=$PRODUCTORES prob_ataque=$ATAQUE radio_foco=$FOCO"
+CABECERA=1
+for TASA in $TASAS; do
+	if [ $CABECERA = 1 ]; then
+		"$DIR/generador" -r "$TASA" -d "$SEGUNDOS" -p "$PRODUCTORES" -a "$ATAQUE" -f "$FOCO"
+		CABECERA=0
+	else
+		"$DIR/generador" -r "$TASA" -d "$SEGUNDOS" -p "$PRODUCTORES" -a "$ATAQUE" -f "$FOCO" | grep -v "^#"
+	fi
+done
+
+kill -INT "$PID" 2>/dev/null
+wait "$PID" 2>/dev/null
@@ -0,0 +1,57 @@
+#!/bin/sh
+#
+# Compara los turnos/s de la partida sin procesos normal y en tubería (-p),
+# en la que un hilo decide el turno siguiente mientras se aplica el actual.
+# Usa los escenarios de bench/regresion/escenarios.txt. Las dos partidas no
+# son la misma (en tubería las acciones llegan con un turno de retraso), así
+# que se comparan los turnos/s y no el resultado. Con una sola CPU los dos
+# hilos se turnan y no puede haber mejora.
+#
+# Uso: bench/tuberia.sh [repeticiones] [escenario...]
+#      OPT y MARCH se pasan a la compilación release (p. ej. MARCH=native)
+#
+
+REPETICIONES=${1:-5}
+[ $# -gt 0 ] && shift
+
+RAIZ=$(cd "$(dirname "$0")/.." && pwd)
+ESCENARIOS="$RAIZ/bench/regresion/escenarios.txt"
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+OPTIMIZACION="OPT=${OPT:--O2}"
+[ -n "$MARCH" ] && OPTIMIZACION="$OPTIMIZACION MARCH=$MARCH"
+
+echo "# repeticiones=$REPETICIONES cpus=$(nproc)"
+echo "# escenario turnos turnos/s turnos_tuberia turnos/s_tuberia espera_us mejora"
+grep -v '^#' "$ESCENARIOS" | while read -r NOMBRE EQUIPOS NAVES COLUMNAS FILAS SEMILLA TURNOS; do
+	[ -z "$NOMBRE" ] && continue
+	if [ $# -gt 0 ]; then
+		case " $* " in
+			*" $NOMBRE "*) ;;
+			*) continue ;;
+		esac
+	fi
+
+	OPCIONES="CPPFLAGS=-DN_EQUIPOS=$EQUIPOS -DN_NAVES=$NAVES -DMAPA_MAXX=$COLUMNAS -DMAPA_MAXY=$FILAS"
+	if ! make -s -C "$RAIZ/src" release TARGET="$DIR/$NOMBRE" "$OPCIONES" $OPTIMIZACION > "$DIR/$NOMBRE.log" 2>&1; then
+		cat "$DIR/$NOMBRE.log"
+		echo "$NOMBRE no compila"
+		continue
+	fi
+
+	# Mediana de los turnos/s de cada modo; en tubería también la espera del hilo principal
+	for MODO in normal tuberia; do
+		[ "$MODO" = tuberia ] && P="-p" || P=""
+		for i in $(seq 1 "$REPETICIONES"); do
+			"$DIR/$NOMBRE/release/simulador" -H "$SEMILLA" -t "$TURNOS" -v 0 $P < /dev/null | tr -d '(,' | awk '
+				/^Partida sin procesos/ { turnos = $6; tps = $13 }
+				/^Tubería/ { espera = $6 }
+				END { print turnos, tps, espera + 0 }'
+		done | sort -n -k 2 | awk '{ t[NR] = $0 } END { print t[int((NR + 1) / 2)] }' > "$DIR/$NOMBRE.$MODO"
+	done
+
+	read -r TURNOS_N TPS_N ESPERA_N < "$DIR/$NOMBRE.normal"
+	read -r TURNOS_T TPS_T ESPERA_T < "$DIR/$NOMBRE.tuberia"
+	echo "$NOMBRE $TURNOS_N $TPS_N $TURNOS_T $TPS_T $ESPERA_T" | awk '{ printf "%s %d %.1f %d %.1f %.2f %+.1f%%\n", $1, $2, $3, $4, $5, $6, ($5 / $3 - 1) * 100 }'
+done
@@ -0,0 +1,208 @@
+/**
+ *
+ * Descripcion: colocación de los procesos en las CPUs. El simulador (o el
+ *		monitor) puede fijarse en unas CPUs propias y pasar a SCHED_FIFO,
+ *		y los jefes y naves quedar confinados en otro conjunto, uno por
+ *		equipo si se quiere, para que no compitan con el bucle del
+ *		simulador. Si el sistema no lo permite se avisa y se continúa como
+ *		antes.
+ *
+ * Fichero: afinidad.c
+ * Autor: Miguel González Bustamante, miguel.gonzalezb@estudiante.uam.es
+ * Grupo: 2261
+ * Fecha: 08-05-2019
+ *
+ */
+
+#define _GNU_SOURCE
+#include <sched.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <afinidad.h>
+
+static bool hay_principal = false;
+static cpu_set_t cpus_principal;
+static int num_grupos = 0;
+static cpu_set_t cpus_grupos[AFINIDAD_MAX_GRUPOS];
+static int prioridad_fifo = 0;
+
+/****************************************************************************/
+/* Funcion: afinidad_leer                                                   */
+/*                                                                          */
+/* Descripcion: interpreta una lista de CPUs como "0,2-5".                  */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		const char *lista: lista de CPUs y rangos separados por comas       */
+/*		cpu_set_t *cpus: destino                                            */
+/* Parametros de salida: 0 si es válida y no está vacía o -1 si no.         */
+/****************************************************************************/
+static int afinidad_leer(const char *lista, cpu_set_t *cpus) {
+	const char *p = lista;
+	char *fin;
+	long desde, hasta;
+
+	CPU_ZERO(cpus);
+	while(*p != '\0') {
+		desde = strtol(p, &fin, 10);
+		if(fin == p || desde < 0)
+			return -1;
+		hasta = desde;
+		if(*fin == '-') {
+			p = fin + 1;
+			hasta = strtol(p, &fin, 10);
+			if(fin == p || hasta < desde)
+				return -1;
+		}
+		if(hasta >= CPU_SETSIZE)
+			return -1;
+		for(; desde <= hasta; desde++)
+			CPU_SET(desde, cpus);
+		if(*fin == ',')
+			fin++;
+		else if(*fin != '\0')
+			return -1;
+		p = fin;
+	}
+	return CPU_COUNT(cpus) > 0 ? 0 : -1;
+}
+
+/****************************************************************************/
+/* Funcion: afinidad_texto                                                  */
+/*                                                                          */
+/* Descripcion: escribe un conjunto de CPUs como lista con rangos.          */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		cpu_set_t *cpus: conjunto                                           */
+/*		char *texto: destino                                                */
+/*		size_t tam: tamaño del destino                                      */
+/* Parametros de salida: void                                               */
+/****************************************************************************/
+static void afinidad_texto(cpu_set_t *cpus, char *texto, size_t tam) {
+	size_t n = 0;
+	int i, j;
+
+	texto[0] = '\0';
+	for(i = 0; i < CPU_SETSIZE && n < tam; i++) {
+		if(!CPU_ISSET(i, cpus))
+			continue;
+		for(j = i; j + 1 < CPU_SETSIZE && CPU_ISSET(j + 1, cpus); j++);
+		if(j == i)
+			n += snprintf(texto + n, tam - n, "%s%d", n ? "," : "", i);
+		else
+			n += snprintf(texto + n, tam - n, "%s%d-%d", n ? "," : "", i, j);
+		i = j;
+	}
+}
+
+/****************************************************************************/
+/* Funcion: afinidad_config                                                 */
+/*                                                                          */
+/* Descripcion: interpreta las opciones de colocación en CPUs.              */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		char *principal: CPUs del simulador o del monitor, o NULL           */
+/*		char *trabajadores: CPUs de jefes y naves, con '/' entre los        */
+/*			conjuntos de cada equipo, o NULL                                */
+/*		int prioridad: prioridad SCHED_FIFO del proceso principal, 0 para   */
+/*			seguir en la política normal                                    */
+/* Parametros de salida: 0 si son válidas o -1 si no.                       */
+/****************************************************************************/
+int afinidad_config(char *principal, char *trabajadores, int prioridad) {
+	char *copia, *grupo, *resto;
+
+	if(principal != NULL) {
+		if(afinidad_leer(principal, &cpus_principal) < 0)
+			return -1;
+		hay_principal = true;
+	}
+
+	if(trabajadores != NULL) {
+		copia = strdup(trabajadores);
+		for(grupo = strtok_r(copia, "/", &resto); grupo != NULL; grupo = strtok_r(NULL, "/", &resto)) {
+			if(num_grupos == AFINIDAD_MAX_GRUPOS || afinidad_leer(grupo, &cpus_grupos[num_grupos]) < 0) {
+				free(copia);
+				return -1;
+			}
+			num_grupos++;
+		}
+		free(copia);
+		if(num_grupos == 0)
+			return -1;
+	}
+
+	if(prioridad < 0 || prioridad > sched_get_priority_max(SCHED_FIFO))
+		return -1;
+	prioridad_fifo = prioridad;
+	return 0;
+}
+
+/****************************************************************************/
+/* Funcion: afinidad_principal                                              */
+/*                                                                          */
+/* Descripcion: fija el hilo que llama en sus CPUs y en SCHED_FIFO, según   */
+/*		las opciones, y muestra lo que ha quedado aplicado. Los hilos que   */
+/*		ya existían (p. ej. el del registro) no cambian.                    */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		const char *nombre: nombre del proceso para el informe              */
+/* Parametros de salida: void                                               */
+/****************************************************************************/
+void afinidad_principal(const char *nombre) {
+	struct sched_param param = {0};
+	cpu_set_t actuales;
+	char texto[256], politica[64] = "normal";
+
+	if(!hay_principal && prioridad_fifo == 0)
+		return;
+
+	if(hay_principal && sched_setaffinity(0, sizeof(cpus_principal), &cpus_principal) < 0)
+		printf("AVISO: %s no se puede fijar en las CPUs pedidas (%s).\n", nombre, strerror(errno));
+
+	if(prioridad_fifo > 0) {
+		param.sched_priority = prioridad_fifo;
+		if(sched_setscheduler(0, SCHED_FIFO, &param) < 0)
+			printf("AVISO: %s no puede usar SCHED_FIFO (%s).\n", nombre, strerror(errno));
+	}
+
+	/* Se informa de lo que dice el sistema, no de lo pedido */
+	if(sched_getaffinity(0, sizeof(actuales), &actuales) == 0)
+		afinidad_texto(&actuales, texto, sizeof(texto));
+	else
+		strcpy(texto, "?");
+	if(sched_getscheduler(0) == SCHED_FIFO && sched_getparam(0, &param) == 0)
+		sprintf(politica, "SCHED_FIFO %d", param.sched_priority);
+	printf("%s: en las CPUs %s, planificación %s\n", nombre, texto, politica);
+}
+
+/****************************************************************************/
+/* Funcion: afinidad_equipo                                                 */
+/*                                                                          */
+/* Descripcion: fija el proceso jefe en el conjunto de CPUs de su equipo y  */
+/*		muestra dónde ha quedado. Las naves se crean después y lo heredan.  */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		int equipo: número de equipo                                        */
+/*		char simbolo: símbolo del equipo para el informe                    */
+/* Parametros de salida: void                                               */
+/****************************************************************************/
+void afinidad_equipo(int equipo, char simbolo) {
+	cpu_set_t *cpus, actuales;
+	char texto[256];
+
+	if(num_grupos == 0)
+		return;
+	cpus = &cpus_grupos[equipo % num_grupos];
+	if(sched_setaffinity(0, sizeof(*cpus), cpus) < 0)
+		printf("AVISO DE JEFE: el equipo %c no se puede fijar en sus CPUs (%s).\n", simbolo, strerror(errno));
+	if(sched_getaffinity(0, sizeof(actuales), &actuales) == 0)
+		afinidad_texto(&actuales, texto, sizeof(texto));
+	else
+		strcpy(texto, "?");
+	printf("Equipo %c: jefe y naves en las CPUs %s\n", simbolo, texto);
+
+	/* Las naves heredarían lo que quede en el buffer */
+	fflush(stdout);
+}
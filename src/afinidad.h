@@ -0,0 +1,21 @@
+#ifndef SRC_AFINIDAD_H_
+#define SRC_AFINIDAD_H_
+
+#define AFINIDAD_MAX_GRUPOS 64 // Conjuntos de CPUs distintos para los equipos
+
+/* Interpreta las listas de CPUs ("0", "2-5", "0,4-7") del proceso principal y de
+ * los trabajadores (jefes y naves). La de trabajadores puede dar un conjunto por
+ * equipo separado por '/': el equipo i usa el conjunto i módulo el número de
+ * conjuntos. 'prioridad' mayor que 0 pide SCHED_FIFO para el proceso principal.
+ * Cualquiera puede ser NULL (o 0). Retorna -1 si no son válidas */
+int afinidad_config(char *principal, char *trabajadores, int prioridad);
+
+/* Fija el hilo que llama en las CPUs del proceso principal y, si se pidió, en
+ * SCHED_FIFO. Muestra lo aplicado con el nombre del proceso */
+void afinidad_principal(const char *nombre);
+
+/* Fija el jefe del equipo (y las naves que cree después) en su conjunto de CPUs
+ * y muestra lo aplicado */
+void afinidad_equipo(int equipo, char simbolo);
+
+#endif /* SRC_AFINIDAD_H_ */
@@ -0,0 +1,171 @@
+/**
+ *
+ * Descripcion: microbenchmark de las consultas en un cuadrado alrededor de
+ *		una casilla con el orden de casillas con el que se compila
+ *		(MAPA_ORDEN y MAPA_TESELA). Llena el mapa de naves al azar y mide lo
+ *		que cuesta leer con mapa_get_casilla todas las casillas de cuadrados
+ *		de varios radios con centros al azar. bench/disposicion.sh lo compila
+ *		con cada orden para compararlos.
+ *
+ * Fichero: cajas.c
+ * Autor: Miguel González Bustamante, miguel.gonzalezb@estudiante.uam.es
+ * Grupo: 2261
+ * Fecha: 08-05-2019
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include <simulador.h>
+#include <mapa.h>
+
+#define CAJAS_RADIOS 4
+
+/* Radios medidos: movimiento, alcance de un ataque y dos cuadrados mayores */
+static const int radios[CAJAS_RADIOS] = {MOVER_ALCANCE, AMENAZA_RADIO, 8, 16};
+
+/* Parámetros de la medida */
+int consultas = 1 << 20; // Cuadrados consultados por radio
+int ocupacion = 10; // Porcentaje de casillas con nave (como mucho N_EQUIPOS * N_NAVES)
+unsigned int semilla = 1;
+
+/****************************************************************************/
+/* Funcion: cajas_ns                                                        */
+/*                                                                          */
+/* Descripcion: obtiene el reloj monotónico en nanosegundos.                */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/* Parametros de salida: instante actual en nanosegundos.                   */
+/****************************************************************************/
+static uint64_t cajas_ns() {
+	struct timespec ahora;
+
+	clock_gettime(CLOCK_MONOTONIC, &ahora);
+	return (uint64_t)ahora.tv_sec * 1000000000ULL + ahora.tv_nsec;
+}
+
+/****************************************************************************/
+/* Funcion: cajas_llenar                                                    */
+/*                                                                          */
+/* Descripcion: vacía el mapa y coloca naves en casillas libres al azar     */
+/*		hasta el porcentaje de ocupación pedido.                            */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		tipo_mapa *mapa: estructura del mapa                                */
+/* Parametros de salida: número de naves colocadas.                         */
+/****************************************************************************/
+static int cajas_llenar(tipo_mapa *mapa) {
+	tipo_nave nave;
+	long objetivo = (long)MAPA_MAXY * MAPA_MAXX * ocupacion / 100;
+	int k;
+
+	for(int y = 0; y < MAPA_MAXY; y++)
+		for(int x = 0; x < MAPA_MAXX; x++)
+			mapa_clean_casilla(mapa, y, x);
+
+	if(objetivo > N_EQUIPOS * N_NAVES)
+		objetivo = N_EQUIPOS * N_NAVES;
+	for(k = 0; k < objetivo; k++) {
+		nave.vida = 1;
+		nave.equipo = k % N_EQUIPOS;
+		nave.numNave = k / N_EQUIPOS;
+		nave.viva = true;
+		do {
+			nave.posy = rand() % MAPA_MAXY;
+			nave.posx = rand() % MAPA_MAXX;
+		} while(!mapa_is_casilla_vacia(mapa, nave.posy, nave.posx));
+		mapa_set_nave(mapa, nave);
+	}
+	return k;
+}
+
+/****************************************************************************/
+/* Funcion: cajas_medir                                                     */
+/*                                                                          */
+/* Descripcion: lee con mapa_get_casilla todas las casillas del cuadrado de */
+/*		radio 'radio' (recortado al mapa) alrededor de cada centro y cuenta */
+/*		las ocupadas.                                                       */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		tipo_mapa *mapa: estructura del mapa                                */
+/*		int *centros: fila y columna de cada centro, seguidas               */
+/*		int radio: radio de los cuadrados                                   */
+/*		long *casillas: casillas leídas en total                            */
+/* Parametros de salida: casillas ocupadas encontradas.                     */
+/****************************************************************************/
+static long cajas_medir(tipo_mapa *mapa, int *centros, int radio, long *casillas) {
+	long ocupadas = 0, leidas = 0;
+	int miny, maxy, minx, maxx;
+
+	for(int k = 0; k < consultas; k++) {
+		miny = (centros[2 * k] - radio < 0) ? 0 : centros[2 * k] - radio;
+		maxy = (centros[2 * k] + radio >= MAPA_MAXY) ? MAPA_MAXY - 1 : centros[2 * k] + radio;
+		minx = (centros[2 * k + 1] - radio < 0) ? 0 : centros[2 * k + 1] - radio;
+		maxx = (centros[2 * k + 1] + radio >= MAPA_MAXX) ? MAPA_MAXX - 1 : centros[2 * k + 1] + radio;
+		for(int y = miny; y <= maxy; y++) {
+			for(int x = minx; x <= maxx; x++)
+				ocupadas += mapa_get_casilla(mapa, y, x).equipo >= 0;
+			leidas += maxx - minx + 1;
+		}
+	}
+	*casillas = leidas;
+	return ocupadas;
+}
+
+int main(int argc, char *argv[]) {
+	tipo_mapa *mapa;
+	int *centros;
+	int opt, naves;
+	long ocupadas, casillas;
+	uint64_t inicio, fin;
+
+	while((opt = getopt(argc, argv, "c:o:s:")) != -1) {
+		switch(opt) {
+			case 'c': consultas = atoi(optarg); break;
+			case 'o': ocupacion = atoi(optarg); break;
+			case 's': semilla = atoi(optarg); break;
+			default:
+				printf("Uso: %s [-c consultas] [-o porcentaje_ocupado] [-s semilla]\n", argv[0]);
+				exit(EXIT_FAILURE);
+		}
+	}
+	if(consultas < 1 || ocupacion < 0 || ocupacion > 100) {
+		printf("ERROR DE CAJAS: parámetros fuera de rango.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	/* El mapa entero, como el del simulador, para que las casillas estén donde en una partida */
+	mapa = (tipo_mapa *)calloc(1, sizeof(*mapa));
+	centros = (int *)malloc(2 * consultas * sizeof(int));
+	if(mapa == NULL || centros == NULL) {
+		printf("ERROR DE CAJAS: reservando memoria.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	srand(semilla);
+	naves = cajas_llenar(mapa);
+	for(int k = 0; k < consultas; k++) {
+		centros[2 * k] = rand() % MAPA_MAXY;
+		centros[2 * k + 1] = rand() % MAPA_MAXX;
+	}
+
+	printf("# orden=%d tesela=%d mapa=%dx%d naves=%d consultas=%d\n", MAPA_ORDEN,
+		(MAPA_ORDEN == MAPA_ORDEN_FILAS) ? 0 : MAPA_TESELA, MAPA_MAXY, MAPA_MAXX, naves, consultas);
+	printf("# radio ns_consulta ns_casilla ocupadas\n");
+	for(int r = 0; r < CAJAS_RADIOS; r++) {
+		/* Una pasada sin medir para que todos los órdenes empiecen con la misma caché */
+		cajas_medir(mapa, centros, radios[r], &casillas);
+		inicio = cajas_ns();
+		ocupadas = cajas_medir(mapa, centros, radios[r], &casillas);
+		fin = cajas_ns();
+		printf("%d %.2f %.3f %ld\n", radios[r], (double)(fin - inicio) / consultas,
+			(double)(fin - inicio) / casillas, ocupadas);
+	}
+
+	free(centros);
+	free(mapa);
+	exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,190 @@
+/**
+ *
+ * Descripcion: canales de comunicación JEFE-NAVE. Todos los canales se crean de
+ *		una sola vez en una región de memoria compartida anónima antes de crear
+ *		los procesos, de forma que no consumen descriptores de fichero.
+ *
+ * Fichero: canal.c
+ * Autor: Miguel González Bustamante, miguel.gonzalezb@estudiante.uam.es
+ * Grupo: 2261
+ * Fecha: 08-05-2019
+ *
+ */
+
+#include <sys/mman.h>
+#include <errno.h>
+#include <string.h>
+#include <semaphore.h>
+#include <canal.h>
+
+static int canal_put(tipo_canal *canal, char *buffer);
+
+/****************************************************************************/
+/* Funcion: canal_create                                                    */
+/*                                                                          */
+/* Descripcion: reserva e inicializa 'num' canales en una región de memoria */
+/*		compartida anónima.                                                 */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		int num: número de canales                                          */
+/*                                                                          */
+/* Parametros de salida: retorna el array de canales o NULL si no ha sido   */
+/*		posible crearlos.                                                   */
+/****************************************************************************/
+tipo_canal *canal_create(int num) {
+	tipo_canal *canales;
+
+	canales = (tipo_canal *)mmap(NULL, num * sizeof(tipo_canal), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if(canales == MAP_FAILED)
+		return NULL;
+
+	for(int i = 0; i < num; i++) {
+		if(sem_init(&canales[i].llenos, 1, 0) < 0 || sem_init(&canales[i].huecos, 1, CANAL_MAXMSG) < 0) {
+			munmap(canales, num * sizeof(tipo_canal));
+			return NULL;
+		}
+		canales[i].lectura = 0;
+		canales[i].escritura = 0;
+		canales[i].cerrado = false;
+	}
+
+	return canales;
+}
+
+/****************************************************************************/
+/* Funcion: canal_destroy                                                   */
+/*                                                                          */
+/* Descripcion: destruye los semáforos de los canales que siguen abiertos  */
+/*		y libera la región de los canales.                                  */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		tipo_canal *canales: array de canales                               */
+/*		int num: número de canales                                          */
+/*                                                                          */
+/* Parametros de salida: void                                               */
+/****************************************************************************/
+void canal_destroy(tipo_canal *canales, int num) {
+	for(int i = 0; i < num; i++) {
+		if(canales[i].cerrado)
+			continue;
+		sem_destroy(&canales[i].llenos);
+		sem_destroy(&canales[i].huecos);
+	}
+	munmap(canales, num * sizeof(tipo_canal));
+}
+
+/****************************************************************************/
+/* Funcion: canal_cerrar                                                    */
+/*                                                                          */
+/* Descripcion: cierra el canal de un lector que ya ha terminado. Los       */
+/*		canales comparten una sola región, así que no se puede desmapear    */
+/*		uno suelto: se destruyen sus semáforos, se descartan los mensajes   */
+/*		pendientes y las escrituras siguientes fallan.                      */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		tipo_canal *canal: canal                                            */
+/*                                                                          */
+/* Parametros de salida: void                                               */
+/****************************************************************************/
+void canal_cerrar(tipo_canal *canal) {
+	if(canal->cerrado)
+		return;
+	canal->cerrado = true;
+	sem_destroy(&canal->llenos);
+	sem_destroy(&canal->huecos);
+	canal->lectura = 0;
+	canal->escritura = 0;
+}
+
+/****************************************************************************/
+/* Funcion: canal_write                                                     */
+/*                                                                          */
+/* Descripcion: escribe en el canal recibido el mensaje pasado.             */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		tipo_canal *canal: canal                                            */
+/*		char *buffer: mensaje a transmitir                                  */
+/* Parametros de salida: retorna positivo si no se produce ningún error o   */
+/*		negativo en caso contrario.                                         */
+/****************************************************************************/
+int canal_write(tipo_canal *canal, char *buffer) {
+	if(canal->cerrado)
+		return -1;
+	while(sem_wait(&canal->huecos) < 0) {
+		if(errno != EINTR)
+			return -1;
+	}
+
+	return canal_put(canal, buffer);
+}
+
+/****************************************************************************/
+/* Funcion: canal_try_write                                                 */
+/*                                                                          */
+/* Descripcion: escribe en el canal recibido el mensaje pasado solo si hay  */
+/*		hueco, sin bloquearse nunca.                                        */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		tipo_canal *canal: canal                                            */
+/*		char *buffer: mensaje a transmitir                                  */
+/* Parametros de salida: retorna positivo si se ha escrito, 0 si el canal   */
+/*		está lleno o negativo en caso de error.                             */
+/****************************************************************************/
+int canal_try_write(tipo_canal *canal, char *buffer) {
+	if(canal->cerrado)
+		return -1;
+	while(sem_trywait(&canal->huecos) < 0) {
+		if(errno == EAGAIN)
+			return 0;
+		if(errno != EINTR)
+			return -1;
+	}
+
+	return canal_put(canal, buffer);
+}
+
+/****************************************************************************/
+/* Funcion: canal_put                                                       */
+/*                                                                          */
+/* Descripcion: copia el mensaje en el hueco ya reservado y lo publica.     */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		tipo_canal *canal: canal                                            */
+/*		char *buffer: mensaje a transmitir                                  */
+/* Parametros de salida: retorna positivo si no se produce ningún error o   */
+/*		negativo en caso contrario.                                         */
+/****************************************************************************/
+static int canal_put(tipo_canal *canal, char *buffer) {
+	strncpy(canal->msg[canal->escritura], buffer, CANAL_MSGSIZE - 1);
+	canal->msg[canal->escritura][CANAL_MSGSIZE - 1] = '\0';
+	canal->escritura = (canal->escritura + 1) % CANAL_MAXMSG;
+
+	if(sem_post(&canal->llenos) < 0)
+		return -1;
+	return 1;
+}
+
+/****************************************************************************/
+/* Funcion: canal_read                                                      */
+/*                                                                          */
+/* Descripcion: lee del canal recibido y lo vuelca en el buffer.            */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		tipo_canal *canal: canal                                            */
+/*		char *buffer: destino del mensaje, de al menos CANAL_MSGSIZE        */
+/* Parametros de salida: retorna positivo si no se produce ningún error o   */
+/*		negativo en caso contrario.                                         */
+/****************************************************************************/
+int canal_read(tipo_canal *canal, char *buffer) {
+	while(sem_wait(&canal->llenos) < 0) {
+		if(errno != EINTR)
+			return -1;
+	}
+
+	strcpy(buffer, canal->msg[canal->lectura]);
+	canal->lectura = (canal->lectura + 1) % CANAL_MAXMSG;
+
+	if(sem_post(&canal->huecos) < 0)
+		return -1;
+	return 1;
+}
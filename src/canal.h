@@ -0,0 +1,38 @@
+#ifndef SRC_CANAL_H_
+#define SRC_CANAL_H_
+
+#include <semaphore.h>
+#include <stdbool.h>
+
+#define CANAL_MAXMSG 4 // Número de mensajes que caben en un canal
+#define CANAL_MSGSIZE 32 // Longitud máxima de un mensaje de un canal
+
+/* Canal JEFE-NAVE: cola circular en memoria compartida con un único escritor y un único lector */
+typedef struct {
+	sem_t llenos; // Mensajes pendientes de leer
+	sem_t huecos; // Huecos libres en la cola
+	int lectura; // Posición del siguiente mensaje a leer
+	int escritura; // Posición del siguiente mensaje a escribir
+	bool cerrado; // Su lector ha terminado: ya no se usa
+	char msg[CANAL_MAXMSG][CANAL_MSGSIZE];
+} tipo_canal;
+
+/* Crea de una sola vez 'num' canales en una región compartida que heredan los procesos hijos */
+tipo_canal *canal_create(int num);
+
+/* Libera los canales creados con canal_create */
+void canal_destroy(tipo_canal *canales, int num);
+
+/* Cierra un canal cuyo lector ha terminado: destruye sus semáforos y descarta lo pendiente */
+void canal_cerrar(tipo_canal *canal);
+
+/* Escribe el mensaje en el canal, esperando si está lleno */
+int canal_write(tipo_canal *canal, char *buffer);
+
+/* Escribe el mensaje en el canal sin esperar. Retorna 0 si el canal está lleno */
+int canal_try_write(tipo_canal *canal, char *buffer);
+
+/* Lee el siguiente mensaje del canal, esperando si está vacío */
+int canal_read(tipo_canal *canal, char *buffer);
+
+#endif /* SRC_CANAL_H_ */
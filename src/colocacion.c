@@ -0,0 +1,176 @@
+/**
+ *
+ * Descripcion: colocación inicial de las naves. Reparte el mapa en una
+ *		zona por equipo y coloca cada equipo en un bloque dentro de su zona,
+ *		de modo que sirve para cualquier número de equipos y de naves sin
+ *		que dos naves caigan en la misma casilla ni fuera del mapa. Se hace
+ *		una vez, en el simulador, antes de crear ningún proceso.
+ *
+ * Fichero: colocacion.c
+ * Autor: Miguel González Bustamante, miguel.gonzalezb@estudiante.uam.es
+ * Grupo: 2261
+ * Fecha: 08-05-2019
+ *
+ */
+
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <colocacion.h>
+#include <mapa.h>
+#include <nave.h>
+
+// Zona del mapa de un equipo y la esquina desde la que se llena
+typedef struct {
+	int y0, x0; // Primera fila y columna
+	int alto, ancho;
+	int anclay, anclax; // Esquina más alejada del centro del mapa
+	int diry, dirx; // Sentido hacia el interior de la zona desde la esquina
+} tipo_zona;
+
+/****************************************************************************/
+/* Funcion: colocacion_zona                                                 */
+/*                                                                          */
+/* Descripcion: calcula la zona de un equipo. El mapa se divide en una      */
+/*		rejilla de filas x columnas zonas con la proporción del mapa; la    */
+/*		última fila de la rejilla reparte su ancho entre los equipos que    */
+/*		quedan. Con 2, 3 o 4 equipos salen las esquinas de siempre.         */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		int equipo: número del equipo                                       */
+/*		tipo_zona *zona: destino                                            */
+/* Parametros de salida: void                                               */
+/****************************************************************************/
+static void colocacion_zona(int equipo, tipo_zona *zona) {
+	int columnas, filas, fila, columna, en_fila;
+	double centroy = (MAPA_MAXY - 1) / 2.0, centrox = (MAPA_MAXX - 1) / 2.0;
+
+	columnas = (int)ceil(sqrt((double)N_EQUIPOS * MAPA_MAXX / MAPA_MAXY));
+	if(columnas > N_EQUIPOS) columnas = N_EQUIPOS;
+	if(columnas > MAPA_MAXX) columnas = MAPA_MAXX;
+	if(columnas < 1) columnas = 1;
+	filas = (N_EQUIPOS + columnas - 1) / columnas;
+
+	fila = equipo / columnas;
+	columna = equipo % columnas;
+	en_fila = (fila == filas - 1) ? N_EQUIPOS - fila * columnas : columnas;
+
+	zona->y0 = fila * MAPA_MAXY / filas;
+	zona->alto = (fila + 1) * MAPA_MAXY / filas - zona->y0;
+	zona->x0 = columna * MAPA_MAXX / en_fila;
+	zona->ancho = (columna + 1) * MAPA_MAXX / en_fila - zona->x0;
+
+	/* En caso de empate (zonas que ocupan todo el alto o el ancho) arriba y a la izquierda */
+	if(fabs(zona->y0 - centroy) >= fabs(zona->y0 + zona->alto - 1 - centroy)) {
+		zona->anclay = zona->y0;
+		zona->diry = 1;
+	} else {
+		zona->anclay = zona->y0 + zona->alto - 1;
+		zona->diry = -1;
+	}
+	if(fabs(zona->x0 - centrox) >= fabs(zona->x0 + zona->ancho - 1 - centrox)) {
+		zona->anclax = zona->x0;
+		zona->dirx = 1;
+	} else {
+		zona->anclax = zona->x0 + zona->ancho - 1;
+		zona->dirx = -1;
+	}
+
+	/* Con más filas de zonas que filas del mapa alguna queda vacía: se ancla en su primera casilla */
+	if(zona->alto < 1) zona->anclay = zona->y0;
+	if(zona->ancho < 1) zona->anclax = zona->x0;
+}
+
+/****************************************************************************/
+/* Funcion: colocacion_bloque                                               */
+/*                                                                          */
+/* Descripcion: elige la separación y el ancho (en naves) del bloque de un  */
+/*		equipo para que quepa en su zona. Empieza con la separación pedida  */
+/*		y el bloque casi cuadrado de siempre, lo ensancha si es demasiado   */
+/*		alto y, si aun así no cabe, junta más las naves.                    */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		tipo_zona *zona: zona del equipo                                    */
+/*		int *separacion: separación elegida                                 */
+/*		int *ancho: naves por fila del bloque                               */
+/* Parametros de salida: 0 si cabe o -1 si el equipo no cabe en su zona.    */
+/****************************************************************************/
+static int colocacion_bloque(tipo_zona *zona, int *separacion, int *ancho) {
+	int s, w, caben_x, caben_y;
+	int cuadrado = (N_NAVES > 3) ? (int)floor(sqrt(N_NAVES)) : 2;
+
+	if(zona->alto < 1 || zona->ancho < 1)
+		return -1;
+
+	for(s = (COLOCACION_SEPARACION > 1) ? COLOCACION_SEPARACION : 1; s >= 1; s--) {
+		caben_x = (zona->ancho - 1) / s + 1;
+		caben_y = (zona->alto - 1) / s + 1;
+		w = (cuadrado < caben_x) ? cuadrado : caben_x;
+		if((N_NAVES + w - 1) / w > caben_y)
+			w = (N_NAVES + caben_y - 1) / caben_y;
+		if(w <= caben_x) {
+			*separacion = s;
+			*ancho = w;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+/****************************************************************************/
+/* Funcion: colocacion_repartir                                             */
+/*                                                                          */
+/* Descripcion: coloca todas las naves en el mapa. Cada equipo llena su     */
+/*		zona por filas desde la esquina de anclaje; si un equipo no cabe en */
+/*		su zona, o la casilla ya está ocupada, la nave va a la casilla      */
+/*		libre más cercana a la esquina usando el plano de ocupación.        */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		tipo_mapa *mapa: mapa con todas las casillas vacías                 */
+/* Parametros de salida: 0 si ha colocado todas o -1 si no caben.           */
+/****************************************************************************/
+int colocacion_repartir(tipo_mapa *mapa) {
+	tipo_zona zona;
+	int separacion = 1, ancho = 1, posy, posx, radio;
+	int radio_max = (MAPA_MAXY > MAPA_MAXX) ? MAPA_MAXY : MAPA_MAXX;
+	bool cabe;
+
+	if((long)N_EQUIPOS * N_NAVES > (long)MAPA_MAXY * MAPA_MAXX) {
+		printf("ERROR DE SIMULADOR: %d naves no caben en un mapa de %dx%d.\n",
+			N_EQUIPOS * N_NAVES, MAPA_MAXY, MAPA_MAXX);
+		return -1;
+	}
+
+	for(int i = 0; i < N_EQUIPOS; i++) {
+		colocacion_zona(i, &zona);
+		radio = 0;
+		cabe = (colocacion_bloque(&zona, &separacion, &ancho) == 0);
+		if(!cabe)
+			printf("AVISO DE SIMULADOR: el equipo %c no cabe en su zona del mapa, sus naves irán a las casillas libres más cercanas.\n",
+				symbol_equipos[i]);
+		else if(separacion < COLOCACION_SEPARACION)
+			printf("AVISO DE SIMULADOR: las naves del equipo %c empiezan a %d casillas en lugar de %d.\n",
+				symbol_equipos[i], separacion, COLOCACION_SEPARACION);
+
+		for(int j = 0; j < N_NAVES; j++) {
+			posy = zona.anclay;
+			posx = zona.anclax;
+			if(cabe) {
+				posy += zona.diry * separacion * (j / ancho);
+				posx += zona.dirx * separacion * (j % ancho);
+			}
+			if(!cabe || !mapa_is_casilla_vacia(mapa, posy, posx)) {
+				/* Las casillas solo se llenan, así que el anillo libre más cercano nunca se acerca */
+				while(radio <= radio_max && !mapa_buscar_libre(mapa, zona.anclay, zona.anclax, radio, &posy, &posx))
+					radio++;
+				if(radio > radio_max) {
+					printf("ERROR DE SIMULADOR: no queda sitio para la nave %c%d.\n", symbol_equipos[i], j);
+					return -1;
+				}
+			}
+			mapa_set_nave(mapa, nave_create(i, j, posy, posx));
+		}
+	}
+	return 0;
+}
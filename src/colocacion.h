@@ -0,0 +1,19 @@
+#ifndef SRC_COLOCACION_H_
+#define SRC_COLOCACION_H_
+
+#include <simulador.h>
+
+#ifndef COLOCACION_SEPARACION
+#define COLOCACION_SEPARACION 1 // Separación (en casillas, como mapa_get_distancia) entre naves de un mismo equipo al empezar
+#endif
+
+/* Reparte las naves de todos los equipos por el mapa y las coloca. El mapa se
+ * divide en tantas zonas como equipos (una rejilla con la forma del mapa) y
+ * cada equipo forma un bloque en la esquina de su zona más alejada del
+ * centro, con las naves a COLOCACION_SEPARACION casillas si caben (si no, más
+ * juntas). Con hasta 4 equipos son las esquinas de siempre. Dos naves nunca
+ * comparten casilla y las de equipos distintos nunca comparten zona salvo que
+ * un equipo no quepa en la suya. Retorna -1 si no caben todas en el mapa */
+int colocacion_repartir(tipo_mapa *mapa);
+
+#endif /* SRC_COLOCACION_H_ */
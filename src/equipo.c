@@ -0,0 +1,178 @@
+/**
+ *
+ * Descripcion: cliente de un equipo para el simulador en modo servidor (-S).
+ *		Se conecta por un socket Unix o TCP, mantiene su propia vista del
+ *		mapa con las naves que le envía el servidor en cada turno y
+ *		responde con las acciones de todas sus naves en un solo mensaje.
+ *		Como decide con nave_decidir, juega igual que los procesos nave,
+ *		pero puede ejecutarse en otro núcleo o en otra máquina.
+ *
+ * Fichero: equipo.c
+ * Autor: Miguel González Bustamante, miguel.gonzalezb@estudiante.uam.es
+ * Grupo: 2261
+ * Fecha: 08-05-2019
+ *
+ */
+
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <time.h>
+#include <mapa.h>
+#include <nave.h>
+#include <protocolo.h>
+
+#define EQUIPO_ENTRADA (sizeof(tipo_msg_turno) + N_EQUIPOS * N_NAVES * sizeof(tipo_msg_nave))
+
+/****************************************************************************/
+/* Funcion: equipo_actualizar                                               */
+/*                                                                          */
+/* Descripcion: aplica a la vista las naves de un mensaje de turno y rehace */
+/*		sus planos de ocupación.                                            */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		tipo_vista *vista: vista del equipo                                 */
+/*		char *datos, size_t longitud: contenido del mensaje                 */
+/* Parametros de salida: turno del mensaje, o -1 si no es válido.           */
+/****************************************************************************/
+int equipo_actualizar(tipo_vista *vista, char *datos, size_t longitud) {
+	tipo_msg_turno *msg = (tipo_msg_turno *)datos;
+	tipo_msg_nave *naves = (tipo_msg_nave *)(msg + 1);
+	tipo_nave *nave;
+	int k, num, indice;
+
+	if(longitud < sizeof(*msg))
+		return -1;
+	num = ntohl(msg->num_naves);
+	if(num < 0 || longitud != sizeof(*msg) + num * sizeof(tipo_msg_nave))
+		return -1;
+
+	for(k = 0; k < num; k++) {
+		indice = ntohs(naves[k].indice);
+		if(indice >= N_EQUIPOS * N_NAVES)
+			return -1;
+		nave = &vista->naves[indice / N_NAVES][indice % N_NAVES];
+		nave->posy = (int16_t)ntohs(naves[k].posy);
+		nave->posx = (int16_t)ntohs(naves[k].posx);
+		nave->vida = (int16_t)ntohs(naves[k].vida);
+		nave->viva = nave->vida > 0;
+		if(nave->posy < 0 || nave->posy >= MAPA_MAXY || nave->posx < 0 || nave->posx >= MAPA_MAXX)
+			return -1;
+	}
+	vista->turno = ntohl(msg->turno);
+	mapa_vista_rehacer(vista);
+	return vista->turno;
+}
+
+int main(int argc, char *argv[]) {
+	tipo_msg_hola hola;
+	tipo_msg_fin fin;
+	tipo_msg_acciones *respuesta;
+	tipo_msg_accion *lote;
+	tipo_accion acciones[NAVE_MAX_ACCIONES];
+	tipo_vista *vista;
+	char *entrada;
+	size_t longitud;
+	unsigned long enviadas = 0;
+	int fd, opt, tipo, equipo, turno, num, retardo_ms = 0;
+
+	while((opt = getopt(argc, argv, "r:")) != -1) {
+		switch(opt) {
+			case 'r':
+				retardo_ms = atoi(optarg);
+				break;
+			default:
+				printf("Uso: %s [-r ms] direccion\n", argv[0]);
+				printf("  -r ms  espera antes de responder a cada turno, como una estrategia lenta\n");
+				exit(EXIT_FAILURE);
+		}
+	}
+	if(optind >= argc) {
+		printf("Uso: %s [-r ms] direccion\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	fd = proto_conectar(argv[optind]);
+	if(fd == -1) {
+		printf("ERROR DE EQUIPO: conectando con %s.\n", argv[optind]);
+		exit(EXIT_FAILURE);
+	}
+
+	if(proto_recibir(fd, &hola, sizeof(hola), &longitud) != PROTO_HOLA || longitud != sizeof(hola)) {
+		printf("ERROR DE EQUIPO: saludo del servidor no válido.\n");
+		exit(EXIT_FAILURE);
+	}
+	/* La vista se decodifica con los tamaños de esta compilación */
+	if((int)ntohl(hola.num_equipos) != N_EQUIPOS || (int)ntohl(hola.num_naves) != N_NAVES
+		|| (int)ntohl(hola.maxy) != MAPA_MAXY || (int)ntohl(hola.maxx) != MAPA_MAXX) {
+		printf("ERROR DE EQUIPO: el servidor juega con otros tamaños de mapa o de equipos.\n");
+		exit(EXIT_FAILURE);
+	}
+	equipo = ntohl(hola.equipo);
+	fprintf(stdout, "Equipo %c conectado a %s, plazo de %d ms por turno\n", symbol_equipos[equipo],
+		argv[optind], (int)ntohl(hola.limite_ms));
+
+	vista = calloc(1, sizeof(*vista));
+	entrada = malloc(EQUIPO_ENTRADA);
+	respuesta = malloc(sizeof(*respuesta) + N_NAVES * NAVE_MAX_ACCIONES * sizeof(tipo_msg_accion));
+	if(vista == NULL || entrada == NULL || respuesta == NULL) {
+		printf("ERROR DE EQUIPO: sin memoria.\n");
+		exit(EXIT_FAILURE);
+	}
+	for(int k = 0; k < N_EQUIPOS * N_NAVES; k++) {
+		vista->naves[k / N_NAVES][k % N_NAVES].equipo = k / N_NAVES;
+		vista->naves[k / N_NAVES][k % N_NAVES].numNave = k % N_NAVES;
+	}
+	lote = (tipo_msg_accion *)(respuesta + 1);
+	srand(time(NULL) ^ getpid());
+
+	while(1) {
+		tipo = proto_recibir(fd, entrada, EQUIPO_ENTRADA, &longitud);
+
+		if(tipo == PROTO_TURNO) {
+			turno = equipo_actualizar(vista, entrada, longitud);
+			if(turno < 0) {
+				printf("ERROR DE EQUIPO: mensaje de turno no válido.\n");
+				exit(EXIT_FAILURE);
+			}
+			if(retardo_ms > 0)
+				usleep(retardo_ms * 1000);
+
+			/* Todas las naves vivas del equipo deciden sobre la misma vista */
+			num = 0;
+			for(int v = 0; v < mapa_vista_num_vivas(vista, equipo); v++) {
+				int j = vista->vivas[equipo][v];
+				int n = nave_decidir(vista, equipo, j, acciones);
+				for(int k = 0; k < n; k++, num++) {
+					lote[num].nave = htons(j);
+					lote[num].ataque = htons(strcmp(acciones[k].tipo, "ACCION ATAQUE") == 0);
+					lote[num].desY = htons(acciones[k].desY);
+					lote[num].desX = htons(acciones[k].desX);
+				}
+			}
+			respuesta->turno = htonl(turno);
+			respuesta->num_acciones = htonl(num);
+			/* Si el servidor ya ha cerrado, el fin de partida puede estar pendiente de leer */
+			if(proto_enviar(fd, PROTO_ACCIONES, respuesta, sizeof(*respuesta) + num * sizeof(tipo_msg_accion)) == 0)
+				enviadas += num;
+		} else if(tipo == PROTO_FIN && longitud == sizeof(fin)) {
+			memcpy(&fin, entrada, sizeof(fin));
+			if((char)ntohl(fin.ganador) == '*')
+				fprintf(stdout, "Equipo %c: fin de la partida en el turno %d, sin ganador, %lu acciones enviadas\n",
+					symbol_equipos[equipo], (int)ntohl(fin.turnos), enviadas);
+			else
+				fprintf(stdout, "Equipo %c: fin de la partida en el turno %d, ganador %c, %lu acciones enviadas\n",
+					symbol_equipos[equipo], (int)ntohl(fin.turnos), (char)ntohl(fin.ganador), enviadas);
+			close(fd);
+			exit(EXIT_SUCCESS);
+		} else {
+			break;
+		}
+	}
+
+	printf("ERROR DE EQUIPO: el servidor ha cerrado la conexión.\n");
+	exit(EXIT_FAILURE);
+}
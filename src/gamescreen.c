@@ -22,7 +22,8 @@ void screen_init() {
 	clear();
 	noecho();
 	cbreak();
-	keypad(stdscr, FALSE);
+	keypad(stdscr, TRUE);
+	nodelay(stdscr, TRUE);
 	curs_set(0);
 	/* initialize colors */
 
@@ -83,6 +84,32 @@ void screen_refresh()
 }
 
 
+void screen_clear()
+{
+	erase();
+}
+
+void screen_size(int *filas, int *columnas)
+{
+	getmaxyx(stdscr, *filas, *columnas);
+}
+
+int screen_getch()
+{
+	int c = getch();
+
+	switch(c) {
+		case KEY_LEFT: return 'h';
+		case KEY_DOWN: return 'j';
+		case KEY_UP: return 'k';
+		case KEY_RIGHT: return 'l';
+		case KEY_NPAGE: return 'n';
+		case KEY_PPAGE: return 'p';
+		case ERR: return -1;
+		default: return c;
+	}
+}
+
 void screen_end() {
 	endwin();
 }
@@ -12,6 +12,16 @@ void screen_addch(int row, int col, char symbol);
  * símbolo con screen_addch()*/
 void screen_refresh();
 
+/* Borra la pantalla. No se verá hasta el próximo screen_refresh() */
+void screen_clear();
+
+/* Obtiene el número de filas y columnas del terminal */
+void screen_size(int *filas, int *columnas);
+
+/* Lee una tecla sin esperar. Las flechas se devuelven como 'h', 'j', 'k', 'l' y
+ * las teclas de avance y retroceso de página como 'n' y 'p'. Retorna -1 si no hay tecla */
+int screen_getch();
+
 /* Finaliza el modo pantalla. Hay que hacerlo antes de finalizar el programa */
 void screen_end();
 
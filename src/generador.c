@@ -0,0 +1,299 @@
+/**
+ *
+ * Descripcion: generador de carga sintética para el simulador. Se conecta a la
+ *		cola de mensajes y a la memoria compartida de un simulador arrancado en
+ *		modo externo (simulador -e) e inyecta acciones válidas a un ritmo fijo
+ *		desde varios hilos productores. La latencia extremo a extremo se mide
+ *		observando el contador de acciones procesadas del mapa: como la cola es
+ *		FIFO, la acción k-ésima enviada es la k-ésima procesada.
+ *
+ * Fichero: generador.c
+ * Autor: Miguel González Bustamante, miguel.gonzalezb@estudiante.uam.es
+ * Grupo: 2261
+ * Fecha: 08-05-2019
+ *
+ */
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <mqueue.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+#include <simulador.h>
+#include <observador.h>
+
+#define GEN_MAX_PRODUCTORES 64
+#define GEN_MAX_MUESTRAS (1 << 22) // Máximo de acciones medidas por ejecución
+#define GEN_SONDEO_NS 50000L // Periodo de sondeo del contador de acciones procesadas
+#define GEN_ESPERA_MAX 2 // Segundos máximos bloqueado en la cola antes de abortar
+
+/* Parámetros de la carga */
+double tasa = 1000; // Acciones por segundo entre todos los productores
+double duracion = 5; // Segundos de inyección
+int productores = 1; // Hilos productores
+double prob_ataque = 0.2; // Proporción de ataques frente a movimientos
+int radio_foco = -1; // Radio del foco de ataques alrededor del centro (-1 = uniforme)
+
+tipo_mapa *mapa;
+tipo_observador *obs_mapa = NULL; // Conexión al mapa del simulador
+mqd_t queue;
+unsigned long base; // Acciones procesadas antes de empezar
+unsigned long enviadas = 0; // Secuencia global de envíos
+uint64_t *t_envio; // Instante de envío de cada acción (ns)
+double *latencias; // Latencia de cada acción procesada (ms)
+unsigned long medidas = 0;
+volatile bool inyectando = true;
+
+/****************************************************************************/
+/* Funcion: gen_ns                                                          */
+/*                                                                          */
+/* Descripcion: lee CLOCK_MONOTONIC en nanosegundos.                        */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/* Parametros de salida: nanosegundos.                                      */
+/****************************************************************************/
+uint64_t gen_ns() {
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t)t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+/****************************************************************************/
+/* Funcion: gen_accion                                                      */
+/*                                                                          */
+/* Descripcion: genera una acción válida de una nave viva elegida al azar.  */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		tipo_accion *accion: destino de la acción                           */
+/*		unsigned int *semilla: estado aleatorio del productor               */
+/* Parametros de salida: retorna positivo si ha generado la acción o        */
+/*		negativo si no queda ninguna nave viva.                             */
+/****************************************************************************/
+int gen_accion(tipo_accion *accion, unsigned int *semilla) {
+	tipo_nave nave;
+	int intentos;
+
+	for(intentos = 0; intentos < 4 * N_EQUIPOS * N_NAVES; intentos++) {
+		nave = mapa->info_naves[rand_r(semilla) % N_EQUIPOS][rand_r(semilla) % N_NAVES];
+		if(nave.viva)
+			break;
+	}
+	if(!nave.viva)
+		return -1;
+
+	memset(accion, 0, sizeof(*accion));
+	accion->equipo = nave.equipo;
+	accion->nave = nave.numNave;
+	accion->oriY = nave.posy;
+	accion->oriX = nave.posx;
+
+	if(rand_r(semilla) < prob_ataque * RAND_MAX) {
+		strcpy(accion->tipo, "ACCION ATAQUE");
+		if(radio_foco < 0) {
+			accion->desY = rand_r(semilla) % MAPA_MAXY;
+			accion->desX = rand_r(semilla) % MAPA_MAXX;
+		} else {
+			accion->desY = MAPA_MAXY / 2 + rand_r(semilla) % (2 * radio_foco + 1) - radio_foco;
+			accion->desX = MAPA_MAXX / 2 + rand_r(semilla) % (2 * radio_foco + 1) - radio_foco;
+		}
+	} else {
+		strcpy(accion->tipo, "ACCION MOVER");
+		accion->desY = nave.posy + rand_r(semilla) % 3 - 1;
+		accion->desX = nave.posx + rand_r(semilla) % 3 - 1;
+	}
+
+	/* Siempre dentro del mapa */
+	accion->desY = (accion->desY < 0) ? 0 : (accion->desY >= MAPA_MAXY) ? MAPA_MAXY - 1 : accion->desY;
+	accion->desX = (accion->desX < 0) ? 0 : (accion->desX >= MAPA_MAXX) ? MAPA_MAXX - 1 : accion->desX;
+	return 1;
+}
+
+/****************************************************************************/
+/* Funcion: gen_productor                                                   */
+/*                                                                          */
+/* Descripcion: hilo productor. Envía acciones con un calendario absoluto   */
+/*		(carga abierta): si la cola se llena, mq_send se bloquea y el       */
+/*		retraso se refleja en la latencia.                                  */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		void *arg: número de productor                                      */
+/* Parametros de salida: NULL.                                              */
+/****************************************************************************/
+void *gen_productor(void *arg) {
+	unsigned int semilla = 1 + (unsigned long)arg;
+	uint64_t periodo = (uint64_t)(1e9 * productores / tasa);
+	uint64_t siguiente = gen_ns(), fin = siguiente + (uint64_t)(duracion * 1e9);
+	tipo_accion accion;
+	struct timespec t;
+
+	while(siguiente < fin) {
+		t.tv_sec = siguiente / 1000000000ULL;
+		t.tv_nsec = siguiente % 1000000000ULL;
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL);
+
+		if(gen_accion(&accion, &semilla) < 0) {
+			fprintf(stderr, "AVISO DE GENERADOR: no quedan naves vivas.\n");
+			break;
+		}
+
+		/* La latencia se cuenta desde el instante previsto de envío, de modo que
+		 * el tiempo bloqueado en mq_send con la cola llena también se mide */
+		unsigned long k = __atomic_fetch_add(&enviadas, 1, __ATOMIC_SEQ_CST);
+		if(k < GEN_MAX_MUESTRAS)
+			__atomic_store_n(&t_envio[k], siguiente, __ATOMIC_RELEASE);
+		accion.t_envio = siguiente;
+		/* Si el simulador deja de consumir no se espera indefinidamente */
+		clock_gettime(CLOCK_REALTIME, &t);
+		t.tv_sec += GEN_ESPERA_MAX;
+		if(mq_timedsend(queue, (char*)&accion, sizeof(accion), 1, &t) == -1) {
+			printf("ERROR DE GENERADOR: enviando mensaje por la cola de mensajes\n");
+			exit(EXIT_FAILURE);
+		}
+		siguiente += periodo;
+	}
+	return NULL;
+}
+
+/****************************************************************************/
+/* Funcion: gen_observador                                                  */
+/*                                                                          */
+/* Descripcion: hilo que sondea el contador de acciones procesadas y anota  */
+/*		la latencia de cada acción nueva.                                   */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		void *arg: no se usa                                                */
+/* Parametros de salida: NULL.                                              */
+/****************************************************************************/
+void *gen_observador(void *arg) {
+	struct timespec espera = {0, GEN_SONDEO_NS};
+	uint64_t ultimo_cambio = gen_ns();
+
+	while(1) {
+		unsigned long procesadas = __atomic_load_n(&mapa->acciones_procesadas, __ATOMIC_ACQUIRE) - base;
+		uint64_t ahora = gen_ns();
+		unsigned long total = __atomic_load_n(&enviadas, __ATOMIC_SEQ_CST);
+
+		if(procesadas > medidas)
+			ultimo_cambio = ahora;
+		for(; medidas < procesadas && medidas < total && medidas < GEN_MAX_MUESTRAS; medidas++) {
+			/* Otro productor puede haber reservado la secuencia sin anotar aún el instante */
+			uint64_t t = __atomic_load_n(&t_envio[medidas], __ATOMIC_ACQUIRE);
+			if(t == 0)
+				break;
+			latencias[medidas] = (ahora - t) / 1e6;
+		}
+
+		/* Termina cuando se ha procesado todo o el simulador deja de avanzar */
+		if(!inyectando && (medidas >= total || ahora - ultimo_cambio > 2000000000ULL))
+			break;
+		nanosleep(&espera, NULL);
+	}
+	return NULL;
+}
+
+/****************************************************************************/
+/* Funcion: gen_comparar                                                    */
+/*                                                                          */
+/* Descripcion: compara dos latencias para qsort.                           */
+/****************************************************************************/
+int gen_comparar(const void *a, const void *b) {
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+int main(int argc, char *argv[]) {
+	pthread_t hilos[GEN_MAX_PRODUCTORES], observador;
+	int opt;
+	uint64_t inicio, fin;
+	tipo_planificacion plan_inicio[N_EQUIPOS];
+	unsigned long despachadas = 0;
+
+	while((opt = getopt(argc, argv, "r:d:p:a:f:")) != -1) {
+		switch(opt) {
+			case 'r': tasa = atof(optarg); break;
+			case 'd': duracion = atof(optarg); break;
+			case 'p': productores = atoi(optarg); break;
+			case 'a': prob_ataque = atof(optarg); break;
+			case 'f': radio_foco = atoi(optarg); break;
+			default:
+				printf("Uso: %s [-r acciones/s] [-d segundos] [-p productores] [-a prob_ataque] [-f radio_foco]\n", argv[0]);
+				exit(EXIT_FAILURE);
+		}
+	}
+	if(productores < 1 || productores > GEN_MAX_PRODUCTORES || tasa <= 0) {
+		printf("ERROR DE GENERADOR: parámetros fuera de rango.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	obs_mapa = observador_abrir(SHM_MAP_NAME);
+	if(obs_mapa == NULL) {
+		printf("ERROR DE GENERADOR: abriendo el segmento de memoria compartida.\n");
+		exit(EXIT_FAILURE);
+	}
+	mapa = (tipo_mapa *)observador_segmento(obs_mapa, sizeof(*mapa));
+	if(mapa == NULL) {
+		printf("ERROR DE GENERADOR: el simulador se ha compilado con otro tamaño de mapa o de equipos.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	queue = mq_open(MQ_NAME, O_WRONLY);
+	if(queue == (mqd_t)-1) {
+		printf("ERROR DE GENERADOR: abriendo la cola de mensajes.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	t_envio = calloc(GEN_MAX_MUESTRAS, sizeof(uint64_t));
+	latencias = malloc(GEN_MAX_MUESTRAS * sizeof(double));
+	if(t_envio == NULL || latencias == NULL) {
+		printf("ERROR DE GENERADOR: reservando memoria.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	base = __atomic_load_n(&mapa->acciones_procesadas, __ATOMIC_ACQUIRE);
+	memcpy(plan_inicio, mapa->planificacion, sizeof(plan_inicio));
+	inicio = gen_ns();
+	pthread_create(&observador, NULL, gen_observador, NULL);
+	for(long i = 0; i < productores; i++)
+		pthread_create(&hilos[i], NULL, gen_productor, (void *)i);
+	for(int i = 0; i < productores; i++)
+		pthread_join(hilos[i], NULL);
+	inyectando = false;
+	pthread_join(observador, NULL);
+	fin = gen_ns();
+
+	qsort(latencias, medidas, sizeof(double), gen_comparar);
+
+	/* Una línea por ejecución para poder dibujar curvas rendimiento-latencia */
+	printf("# tasa_objetivo enviadas procesadas acciones/s p50_ms p90_ms p99_ms max_ms\n");
+	printf("%.0f %lu %lu %.1f %.3f %.3f %.3f %.3f\n", tasa, enviadas, medidas,
+		medidas / ((fin - inicio) / 1e9),
+		medidas ? latencias[medidas / 2] : 0, medidas ? latencias[medidas * 9 / 10] : 0,
+		medidas ? latencias[medidas * 99 / 100] : 0, medidas ? latencias[medidas - 1] : 0);
+
+	/* Reparto del planificador entre equipos durante la ejecución. Al reordenar
+	 * acciones, las latencias de arriba emparejan envíos y despachos solo por orden */
+	for(int i = 0; i < N_EQUIPOS; i++)
+		despachadas += mapa->planificacion[i].despachadas - plan_inicio[i].despachadas;
+	printf("# equipo encoladas descartadas despachadas cuota espera_media_ms espera_max_ms\n");
+	for(int i = 0; i < N_EQUIPOS; i++) {
+		tipo_planificacion *p = &mapa->planificacion[i];
+		unsigned long n = p->despachadas - plan_inicio[i].despachadas;
+
+		printf("# %c %lu %lu %lu %.3f %.3f %.3f\n", 'A' + i,
+			p->encoladas - plan_inicio[i].encoladas, p->descartadas - plan_inicio[i].descartadas, n,
+			despachadas ? (double)n / despachadas : 0,
+			n ? (p->espera_total_us - plan_inicio[i].espera_total_us) / 1e3 / n : 0, p->espera_max_us / 1e3);
+	}
+
+	mq_close(queue);
+	observador_cerrar(obs_mapa);
+	exit(EXIT_SUCCESS);
+}
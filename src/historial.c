@@ -0,0 +1,514 @@
+/**
+ *
+ * Descripcion: historial de la partida para poder volver a cualquier turno
+ *		reciente desde el monitor. Al terminar cada turno el simulador
+ *		guarda en un anillo de memoria compartida (o en un fichero mapeado)
+ *		las casillas y naves que han cambiado; cada HIST_CLAVE turnos guarda
+ *		el mapa completo. Un índice por turno da la posición de cada
+ *		registro, así que reconstruir un turno cuesta como mucho un registro
+ *		clave y HIST_CLAVE - 1 diferencias, sin tocar el mapa en vivo.
+ *
+ * Fichero: historial.c
+ * Autor: Miguel González Bustamante, miguel.gonzalezb@estudiante.uam.es
+ * Grupo: 2261
+ * Fecha: 08-05-2019
+ *
+ */
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <mapa.h>
+#include <historial.h>
+
+#define HIST_VERSION 1
+#define HIST_CELDAS (MAPA_MAXY * MAPA_MAXX)
+#define HIST_NAVES (N_EQUIPOS * N_NAVES)
+#define HIST_ALINEAR(n) (((n) + 7) & ~(size_t)7)
+#define HIST_TAM_CLAVE (sizeof(tipo_historial_registro) + HIST_ALINEAR(HIST_CELDAS) + HIST_NAVES * sizeof(tipo_nave))
+
+/* Segmento del historial */
+static char *segmento = NULL;
+static size_t tam_segmento = 0;
+static tipo_historial_cabecera *cab = NULL;
+static tipo_historial_indice *indice = NULL;
+static char *datos = NULL;
+static bool compartido = false; // Si el segmento es HIST_SHM_NAME y hay que borrarlo al terminar
+
+/* Estado del último turno guardado, solo en el simulador */
+static char *previo_simbolos = NULL;
+static tipo_nave *previo_naves = NULL;
+static int *previo_marcas = NULL; // Casillas marcadas en ese turno, que mapa_restore ha devuelto a su símbolo
+static int previo_num_marcas = 0;
+static int *cambiadas = NULL; // Naves que han cambiado en el turno que se prepara
+static char *registro = NULL; // Donde se prepara cada registro antes de copiarlo al anillo
+
+/****************************************************************************/
+/* Funcion: historial_crear                                                 */
+/*                                                                          */
+/* Descripcion: crea el segmento del historial con la cabecera, el índice   */
+/*		vacío y un anillo de datos en el que caben al menos cuatro          */
+/*		registros clave.                                                    */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		const char *fichero: fichero donde guardarlo, o NULL para usar el   */
+/*			segmento compartido HIST_SHM_NAME                               */
+/* Parametros de salida: 0 si se ha creado o -1 si no.                      */
+/****************************************************************************/
+int historial_crear(const char *fichero) {
+	uint64_t capacidad = HIST_ALINEAR(HIST_MEMORIA);
+	int fd;
+
+	if(capacidad < 4 * HIST_TAM_CLAVE)
+		capacidad = 4 * HIST_TAM_CLAVE;
+	tam_segmento = sizeof(tipo_historial_cabecera) + HIST_TURNOS * sizeof(tipo_historial_indice) + capacidad;
+
+	compartido = (fichero == NULL);
+	if(compartido)
+		fd = shm_open(HIST_SHM_NAME, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+	else
+		fd = open(fichero, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	if(fd == -1)
+		return -1;
+
+	if(ftruncate(fd, tam_segmento) == -1) {
+		close(fd);
+		historial_destruir();
+		return -1;
+	}
+	segmento = mmap(NULL, tam_segmento, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	previo_simbolos = malloc(HIST_CELDAS);
+	previo_naves = malloc(HIST_NAVES * sizeof(tipo_nave));
+	previo_marcas = malloc(HIST_CELDAS * sizeof(int));
+	cambiadas = malloc(HIST_NAVES * sizeof(int));
+	registro = malloc(sizeof(tipo_historial_registro) + HIST_CELDAS * sizeof(tipo_historial_casilla) + HIST_NAVES * sizeof(tipo_nave));
+	if(segmento == MAP_FAILED || previo_simbolos == NULL || previo_naves == NULL || previo_marcas == NULL
+			|| cambiadas == NULL || registro == NULL) {
+		if(segmento == MAP_FAILED)
+			segmento = NULL;
+		historial_destruir();
+		return -1;
+	}
+
+	cab = (tipo_historial_cabecera *)segmento;
+	indice = (tipo_historial_indice *)(cab + 1);
+	datos = (char *)(indice + HIST_TURNOS);
+
+	for(int k = 0; k < HIST_TURNOS; k++)
+		indice[k].turno = -1;
+	cab->version = HIST_VERSION;
+	cab->num_equipos = N_EQUIPOS;
+	cab->num_naves = N_NAVES;
+	cab->maxy = MAPA_MAXY;
+	cab->maxx = MAPA_MAXX;
+	cab->intervalo_clave = HIST_CLAVE;
+	cab->capacidad = capacidad;
+	cab->ultimo_turno = -1;
+	/* La magia va la última: quien abra el historial antes lo verá incompleto */
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	memcpy(cab->magia, HIST_MAGIA, sizeof(cab->magia));
+	return 0;
+}
+
+/****************************************************************************/
+/* Funcion: historial_marcas                                                */
+/*                                                                          */
+/* Descripcion: guarda las casillas marcadas en el turno, que mapa_restore  */
+/*		va a devolver a su símbolo antes del turno siguiente.               */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		tipo_mapa *mapa: mapa al terminar el turno                          */
+/* Parametros de salida: void                                               */
+/****************************************************************************/
+static void historial_marcas(tipo_mapa *mapa) {
+	memcpy(previo_marcas, mapa->marcas, mapa->num_marcas * sizeof(int));
+	previo_num_marcas = mapa->num_marcas;
+}
+
+/****************************************************************************/
+/* Funcion: historial_casilla                                               */
+/*                                                                          */
+/* Descripcion: si el símbolo de la casilla ha cambiado desde el último     */
+/*		turno guardado, la añade al registro. Una casilla repetida solo se  */
+/*		añade la primera vez.                                               */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		tipo_mapa *mapa: mapa al terminar el turno                          */
+/*		int c: casilla (y * MAPA_MAXX + x)                                  */
+/*		tipo_historial_registro *reg: registro que se prepara               */
+/* Parametros de salida: void                                               */
+/****************************************************************************/
+static void historial_casilla(tipo_mapa *mapa, int c, tipo_historial_registro *reg) {
+	tipo_historial_casilla *casillas = (tipo_historial_casilla *)(reg + 1);
+	char simbolo;
+
+	if(c < 0 || c >= HIST_CELDAS)
+		return;
+	simbolo = mapa->casillas[mapa_casilla(c / MAPA_MAXX, c % MAPA_MAXX)].simbolo;
+	if(simbolo != previo_simbolos[c]) {
+		casillas[reg->num_casillas].casilla = c;
+		casillas[reg->num_casillas++].simbolo = simbolo;
+		previo_simbolos[c] = simbolo;
+	}
+}
+
+/****************************************************************************/
+/* Funcion: historial_preparar                                              */
+/*                                                                          */
+/* Descripcion: prepara en 'registro' el registro de un turno con lo que ha */
+/*		cambiado desde el último turno guardado; si es turno clave, si      */
+/*		falta el turno anterior o si las diferencias ocuparían más que el   */
+/*		mapa completo, prepara un registro clave. Un símbolo solo cambia en */
+/*		una casilla marcada (este turno o el anterior, que mapa_restore ha  */
+/*		limpiado) o donde estaba o está una nave que ha cambiado, así que   */
+/*		solo se miran esas y no el mapa entero.                             */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		tipo_mapa *mapa: mapa al terminar el turno                          */
+/*		int turno: turno que termina                                        */
+/* Parametros de salida: tamaño del registro en bytes.                      */
+/****************************************************************************/
+static size_t historial_preparar(tipo_mapa *mapa, int turno) {
+	tipo_historial_registro *reg = (tipo_historial_registro *)registro;
+	tipo_historial_casilla *casillas = (tipo_historial_casilla *)(reg + 1);
+	tipo_nave *naves = previo_naves, *nave;
+	size_t tam;
+	int c, k, num_cambiadas = 0;
+
+	reg->turno = turno;
+	reg->equipos_vivos = mapa->equipos_vivos;
+	memcpy(reg->estadisticas, mapa->estadisticas, sizeof(reg->estadisticas));
+	reg->num_casillas = 0;
+	reg->num_naves = 0;
+	reg->clave = (turno % HIST_CLAVE == 0 || turno != cab->ultimo_turno + 1);
+
+	if(!reg->clave) {
+		for(k = 0; k < HIST_NAVES; k++) {
+			nave = &mapa->info_naves[k / N_NAVES][k % N_NAVES];
+			if(nave->vida != previo_naves[k].vida || nave->posy != previo_naves[k].posy
+				|| nave->posx != previo_naves[k].posx || nave->viva != previo_naves[k].viva) {
+				historial_casilla(mapa, previo_naves[k].posy * MAPA_MAXX + previo_naves[k].posx, reg);
+				historial_casilla(mapa, nave->posy * MAPA_MAXX + nave->posx, reg);
+				cambiadas[num_cambiadas++] = k;
+			}
+		}
+		for(k = 0; k < previo_num_marcas; k++)
+			historial_casilla(mapa, previo_marcas[k], reg);
+		for(k = 0; k < mapa->num_marcas; k++)
+			historial_casilla(mapa, mapa->marcas[k], reg);
+
+		/* Las naves cambiadas van detrás de las casillas */
+		naves = (tipo_nave *)(casillas + reg->num_casillas);
+		for(k = 0; k < num_cambiadas; k++) {
+			naves[reg->num_naves++] = mapa->info_naves[cambiadas[k] / N_NAVES][cambiadas[k] % N_NAVES];
+			previo_naves[cambiadas[k]] = naves[reg->num_naves - 1];
+		}
+		historial_marcas(mapa);
+
+		tam = (char *)(naves + reg->num_naves) - registro;
+		if(tam <= HIST_TAM_CLAVE)
+			return tam;
+		reg->clave = true;
+	}
+
+	/* Registro clave: todos los símbolos y todas las naves */
+	for(c = 0; c < HIST_CELDAS; c++)
+		previo_simbolos[c] = mapa->casillas[mapa_casilla(c / MAPA_MAXX, c % MAPA_MAXX)].simbolo;
+	memcpy(previo_naves, mapa->info_naves, HIST_NAVES * sizeof(tipo_nave));
+	memcpy(reg + 1, previo_simbolos, HIST_CELDAS);
+	memcpy((char *)(reg + 1) + HIST_ALINEAR(HIST_CELDAS), previo_naves, HIST_NAVES * sizeof(tipo_nave));
+	reg->num_casillas = HIST_CELDAS;
+	reg->num_naves = HIST_NAVES;
+	historial_marcas(mapa);
+	return HIST_TAM_CLAVE;
+}
+
+/****************************************************************************/
+/* Funcion: historial_guardar                                               */
+/*                                                                          */
+/* Descripcion: añade al anillo el registro del turno y lo apunta en el     */
+/*		índice. Antes de escribir anuncia hasta dónde va a escribir, para   */
+/*		que un lector que copie a la vez un registro antiguo sepa que lo ha */
+/*		perdido. Un registro nunca se parte al final del anillo.            */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		tipo_mapa *mapa: mapa al terminar el turno                          */
+/*		int turno: turno que termina                                        */
+/* Parametros de salida: void                                               */
+/****************************************************************************/
+void historial_guardar(tipo_mapa *mapa, int turno) {
+	tipo_historial_indice *entrada;
+	uint64_t posicion;
+	size_t tam;
+
+	if(registro == NULL)
+		return;
+
+	tam = HIST_ALINEAR(historial_preparar(mapa, turno));
+	posicion = cab->escrito;
+	if(posicion % cab->capacidad + tam > cab->capacidad)
+		posicion += cab->capacidad - posicion % cab->capacidad;
+
+	__atomic_store_n(&cab->reservado, posicion + tam, __ATOMIC_SEQ_CST);
+	memcpy(datos + posicion % cab->capacidad, registro, tam);
+
+	entrada = &indice[turno % HIST_TURNOS];
+	__atomic_store_n(&entrada->turno, -1, __ATOMIC_SEQ_CST);
+	entrada->posicion = posicion;
+	entrada->tamano = tam;
+	__atomic_store_n(&entrada->turno, turno, __ATOMIC_RELEASE);
+
+	__atomic_store_n(&cab->escrito, posicion + tam, __ATOMIC_RELEASE);
+	__atomic_store_n(&cab->ultimo_turno, turno, __ATOMIC_RELEASE);
+}
+
+/****************************************************************************/
+/* Funcion: historial_destruir                                              */
+/*                                                                          */
+/* Descripcion: libera el historial del simulador y borra el segmento       */
+/*		compartido. Si estaba en un fichero, el fichero se conserva.        */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/* Parametros de salida: void                                               */
+/****************************************************************************/
+void historial_destruir() {
+	if(segmento != NULL)
+		munmap(segmento, tam_segmento);
+	if(compartido)
+		shm_unlink(HIST_SHM_NAME);
+	free(previo_simbolos);
+	free(previo_naves);
+	free(previo_marcas);
+	free(cambiadas);
+	free(registro);
+	segmento = NULL;
+	previo_simbolos = NULL;
+	previo_naves = NULL;
+	previo_marcas = NULL;
+	cambiadas = NULL;
+	previo_num_marcas = 0;
+	registro = NULL;
+	compartido = false;
+}
+
+/****************************************************************************/
+/* Funcion: historial_abrir                                                 */
+/*                                                                          */
+/* Descripcion: mapea en solo lectura el historial y comprueba que se ha    */
+/*		creado con los mismos tamaños de mapa y de equipos.                 */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		const char *fichero: fichero del historial, o NULL para el segmento */
+/*			compartido HIST_SHM_NAME                                        */
+/* Parametros de salida: 0 si se ha abierto o -1 si no.                     */
+/****************************************************************************/
+int historial_abrir(const char *fichero) {
+	struct stat st;
+	int fd;
+
+	fd = (fichero == NULL) ? shm_open(HIST_SHM_NAME, O_RDONLY, 0) : open(fichero, O_RDONLY);
+	if(fd == -1)
+		return -1;
+	if(fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(tipo_historial_cabecera)) {
+		close(fd);
+		return -1;
+	}
+
+	tam_segmento = st.st_size;
+	segmento = mmap(NULL, tam_segmento, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(segmento == MAP_FAILED) {
+		segmento = NULL;
+		return -1;
+	}
+
+	cab = (tipo_historial_cabecera *)segmento;
+	indice = (tipo_historial_indice *)(cab + 1);
+	datos = (char *)(indice + HIST_TURNOS);
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	if(memcmp(cab->magia, HIST_MAGIA, sizeof(cab->magia)) != 0 || cab->version != HIST_VERSION
+		|| cab->num_equipos != N_EQUIPOS || cab->num_naves != N_NAVES || cab->maxy != MAPA_MAXY
+		|| cab->maxx != MAPA_MAXX || cab->intervalo_clave != HIST_CLAVE
+		|| tam_segmento != sizeof(tipo_historial_cabecera) + HIST_TURNOS * sizeof(tipo_historial_indice) + cab->capacidad) {
+		historial_cerrar();
+		return -1;
+	}
+	return 0;
+}
+
+/****************************************************************************/
+/* Funcion: historial_registro                                              */
+/*                                                                          */
+/* Descripcion: localiza el registro de un turno en el anillo.              */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		int turno: turno buscado                                            */
+/*		uint64_t *posicion: donde se deja la posición del registro          */
+/* Parametros de salida: registro, o NULL si el turno no está o el          */
+/*		simulador ya ha empezado a sobrescribirlo.                          */
+/****************************************************************************/
+static tipo_historial_registro *historial_registro(int turno, uint64_t *posicion) {
+	tipo_historial_indice *entrada = &indice[turno % HIST_TURNOS];
+	uint32_t tam;
+
+	if(turno < 0 || __atomic_load_n(&entrada->turno, __ATOMIC_ACQUIRE) != turno)
+		return NULL;
+	*posicion = entrada->posicion;
+	tam = entrada->tamano;
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	if(__atomic_load_n(&entrada->turno, __ATOMIC_ACQUIRE) != turno)
+		return NULL;
+	if(*posicion + cab->capacidad < __atomic_load_n(&cab->reservado, __ATOMIC_ACQUIRE)
+		|| tam < sizeof(tipo_historial_registro) || *posicion % cab->capacidad + tam > cab->capacidad)
+		return NULL;
+	return (tipo_historial_registro *)(datos + *posicion % cab->capacidad);
+}
+
+/****************************************************************************/
+/* Funcion: historial_turnos                                                */
+/*                                                                          */
+/* Descripcion: calcula qué turnos se pueden reconstruir. Los registros que */
+/*		siguen en el anillo son los más recientes, así que el primero se    */
+/*		busca por bisección y después se avanza hasta un registro clave.    */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		int *primero, *ultimo: donde se dejan los turnos                    */
+/* Parametros de salida: false si no hay ningún turno disponible.           */
+/****************************************************************************/
+bool historial_turnos(int *primero, int *ultimo) {
+	tipo_historial_registro *reg;
+	uint64_t posicion;
+	int bajo, alto, medio;
+
+	if(segmento == NULL)
+		return false;
+	*ultimo = __atomic_load_n(&cab->ultimo_turno, __ATOMIC_ACQUIRE);
+	if(*ultimo < 0)
+		return false;
+
+	bajo = (*ultimo - HIST_TURNOS + 1 > 0) ? *ultimo - HIST_TURNOS + 1 : 0;
+	alto = *ultimo;
+	while(bajo < alto) {
+		medio = bajo + (alto - bajo) / 2;
+		if(historial_registro(medio, &posicion) != NULL)
+			alto = medio;
+		else
+			bajo = medio + 1;
+	}
+
+	for(*primero = bajo; *primero <= *ultimo; (*primero)++) {
+		reg = historial_registro(*primero, &posicion);
+		if(reg != NULL && reg->clave)
+			return true;
+	}
+	return false;
+}
+
+/****************************************************************************/
+/* Funcion: historial_aplicar                                               */
+/*                                                                          */
+/* Descripcion: aplica un registro sobre el mapa reconstruido. Los índices  */
+/*		se comprueban porque el registro puede estar siendo sobrescrito;    */
+/*		en ese caso el resultado se descarta después.                       */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		tipo_historial_registro *reg: registro del turno                    */
+/*		tipo_mapa *destino: mapa reconstruido                               */
+/* Parametros de salida: void                                               */
+/****************************************************************************/
+static void historial_aplicar(tipo_historial_registro *reg, tipo_mapa *destino) {
+	tipo_historial_casilla *casillas = (tipo_historial_casilla *)(reg + 1);
+	tipo_nave *naves, nave;
+	char *simbolos = (char *)(reg + 1);
+	int c, k, num_casillas = reg->num_casillas, num_naves = reg->num_naves;
+
+	destino->equipos_vivos = reg->equipos_vivos;
+	memcpy(destino->estadisticas, reg->estadisticas, sizeof(destino->estadisticas));
+
+	if(reg->clave) {
+		for(c = 0; c < HIST_CELDAS; c++)
+			destino->casillas[mapa_casilla(c / MAPA_MAXX, c % MAPA_MAXX)].simbolo = simbolos[c];
+		memcpy(destino->info_naves, simbolos + HIST_ALINEAR(HIST_CELDAS), HIST_NAVES * sizeof(tipo_nave));
+		return;
+	}
+
+	if(num_casillas < 0 || num_casillas > HIST_CELDAS || num_naves < 0 || num_naves > HIST_NAVES)
+		return;
+	for(k = 0; k < num_casillas; k++) {
+		c = casillas[k].casilla;
+		if(c >= 0 && c < HIST_CELDAS)
+			destino->casillas[mapa_casilla(c / MAPA_MAXX, c % MAPA_MAXX)].simbolo = casillas[k].simbolo;
+	}
+	naves = (tipo_nave *)(casillas + num_casillas);
+	for(k = 0; k < num_naves; k++) {
+		nave = naves[k];
+		if(nave.equipo >= 0 && nave.equipo < N_EQUIPOS && nave.numNave >= 0 && nave.numNave < N_NAVES)
+			destino->info_naves[nave.equipo][nave.numNave] = nave;
+	}
+}
+
+/****************************************************************************/
+/* Funcion: historial_reconstruir                                           */
+/*                                                                          */
+/* Descripcion: busca hacia atrás el registro clave del turno (como mucho   */
+/*		HIST_CLAVE registros), aplica desde él las diferencias hasta el     */
+/*		turno pedido y rehace la pirámide de zoom. Al final comprueba que   */
+/*		el simulador no ha sobrescrito el registro clave mientras tanto.    */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		int turno: turno a reconstruir                                      */
+/*		tipo_mapa *destino: mapa privado donde se reconstruye               */
+/* Parametros de salida: 0 si se ha reconstruido o -1 si no está.           */
+/****************************************************************************/
+int historial_reconstruir(int turno, tipo_mapa *destino) {
+	tipo_historial_registro *reg = NULL;
+	uint64_t posicion, posicion_clave = 0;
+	int clave, t;
+
+	if(segmento == NULL)
+		return -1;
+
+	for(clave = turno; clave >= 0 && clave > turno - HIST_CLAVE; clave--) {
+		reg = historial_registro(clave, &posicion_clave);
+		if(reg == NULL || reg->clave)
+			break;
+	}
+	if(reg == NULL || !reg->clave)
+		return -1;
+
+	for(t = clave; t <= turno; t++) {
+		reg = historial_registro(t, &posicion);
+		if(reg == NULL)
+			return -1;
+		historial_aplicar(reg, destino);
+	}
+
+	/* El registro clave es el más antiguo de los leídos */
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	if(posicion_clave + cab->capacidad < __atomic_load_n(&cab->reservado, __ATOMIC_ACQUIRE))
+		return -1;
+
+	mapa_recalcular_mip(destino);
+	mapa_recalcular_vivas(destino);
+	destino->turno = turno;
+	return 0;
+}
+
+/****************************************************************************/
+/* Funcion: historial_cerrar                                                */
+/*                                                                          */
+/* Descripcion: deshace el mapeo de historial_abrir.                        */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/* Parametros de salida: void                                               */
+/****************************************************************************/
+void historial_cerrar() {
+	if(segmento != NULL)
+		munmap(segmento, tam_segmento);
+	segmento = NULL;
+}
@@ -0,0 +1,77 @@
+#ifndef SRC_HISTORIAL_H_
+#define SRC_HISTORIAL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <simulador.h>
+
+#define HIST_SHM_NAME "/shm_historial" // Segmento del historial si no se guarda en un fichero
+#define HIST_MAGIA "HISTNAV1"
+#define HIST_CLAVE 32 // Cada cuántos turnos se guarda el mapa completo; el resto son diferencias
+#define HIST_TURNOS 4096 // Entradas del índice de turnos
+#ifndef HIST_MEMORIA
+#define HIST_MEMORIA (8 << 20) // Bytes para los turnos guardados; al llenarse se pierden los más antiguos
+#endif
+
+/* Cabecera del segmento, seguida del índice y de los datos. Los tamaños de la
+ * compilación permiten al monitor rechazar un historial que no sabe leer */
+typedef struct {
+	char magia[8];
+	int32_t version;
+	int32_t num_equipos, num_naves, maxy, maxx;
+	int32_t intervalo_clave;
+	uint64_t capacidad; // Bytes del anillo de datos
+	uint64_t reservado; // Posición hasta la que el simulador puede estar escribiendo
+	uint64_t escrito; // Posición hasta la que los datos están completos
+	int32_t ultimo_turno; // Último turno guardado, -1 si todavía ninguno
+	int32_t relleno;
+} tipo_historial_cabecera;
+
+/* Entrada del índice: dónde está el registro de un turno */
+typedef struct {
+	uint64_t posicion; // Posición absoluta (sin dar la vuelta) en el anillo de datos
+	uint32_t tamano;
+	int32_t turno; // -1 mientras se actualiza la entrada
+} tipo_historial_indice;
+
+/* Registro de un turno en el anillo de datos. Si es clave le siguen todos los
+ * símbolos y todas las naves; si no, las casillas y naves que han cambiado */
+typedef struct {
+	int32_t turno;
+	int32_t clave;
+	int32_t num_casillas;
+	int32_t num_naves;
+	int32_t equipos_vivos;
+	int32_t relleno;
+	tipo_estadisticas estadisticas[N_EQUIPOS];
+} tipo_historial_registro;
+
+/* Casilla que cambia en un registro de diferencias */
+typedef struct {
+	int32_t casilla; // y * MAPA_MAXX + x
+	int32_t simbolo;
+} tipo_historial_casilla;
+
+/* Crea el historial en un segmento compartido o, si se da, en un fichero. Retorna -1 si no es posible */
+int historial_crear(const char *fichero);
+
+/* Guarda el estado del mapa al terminar un turno */
+void historial_guardar(tipo_mapa *mapa, int turno);
+
+/* Libera el historial del simulador (el fichero, si lo hay, se conserva) */
+void historial_destruir();
+
+/* Abre en solo lectura el historial del simulador. Retorna -1 si no existe o no es compatible */
+int historial_abrir(const char *fichero);
+
+/* Obtiene el primer y el último turno que se pueden reconstruir. Retorna false si no hay ninguno */
+bool historial_turnos(int *primero, int *ultimo);
+
+/* Reconstruye en 'destino' el mapa tal como acabó el turno, partiendo del último registro
+ * clave anterior. Retorna -1 si el turno ya no está en el historial */
+int historial_reconstruir(int turno, tipo_mapa *destino);
+
+/* Cierra el historial abierto con historial_abrir */
+void historial_cerrar();
+
+#endif /* SRC_HISTORIAL_H_ */
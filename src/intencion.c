@@ -0,0 +1,218 @@
+/**
+ *
+ * Descripcion: intenciones de las naves. Cada nave deja las acciones que ha
+ *		decidido en su propia casilla de memoria compartida, sin llamadas
+ *		al sistema que puedan bloquearla, y el simulador recoge solo la
+ *		última de cada nave. Si el simulador va retrasado las acciones
+ *		viejas se sustituyen en lugar de acumularse en una cola.
+ *
+ * Fichero: intencion.c
+ * Autor: Miguel González Bustamante, miguel.gonzalezb@estudiante.uam.es
+ * Grupo: 2261
+ * Fecha: 08-05-2019
+ *
+ */
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <limits.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <intencion.h>
+
+#define INTENCION_REINTENTOS 64 // Lecturas de una intención antes de saltarla
+
+/* Secuencia de la última intención recogida de cada nave (solo la usa el simulador) */
+static uint32_t recogida[N_EQUIPOS][N_NAVES];
+
+/****************************************************************************/
+/* Funcion: intencion_create                                                */
+/*                                                                          */
+/* Descripcion: reserva las intenciones de todas las naves en una región de */
+/*		memoria compartida anónima.                                         */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/* Parametros de salida: retorna las intenciones o NULL si no ha sido       */
+/*		posible crearlas.                                                   */
+/****************************************************************************/
+tipo_intenciones *intencion_create() {
+	tipo_intenciones *intenciones;
+
+	intenciones = (tipo_intenciones *)mmap(NULL, sizeof(tipo_intenciones), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if(intenciones == MAP_FAILED)
+		return NULL;
+
+	/* La región anónima empieza a cero: sin intenciones ni avisos */
+	for(int i = 0; i < N_EQUIPOS; i++) {
+		for(int j = 0; j < N_NAVES; j++) {
+			intenciones->naves[i][j].equipo = i;
+			intenciones->naves[i][j].nave = j;
+			intenciones->naves[i][j].turno = -1;
+		}
+	}
+	memset(recogida, 0, sizeof(recogida));
+
+	return intenciones;
+}
+
+/****************************************************************************/
+/* Funcion: intencion_destroy                                               */
+/*                                                                          */
+/* Descripcion: libera la región de las intenciones.                        */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		tipo_intenciones *intenciones: intenciones de las naves             */
+/* Parametros de salida: void                                               */
+/****************************************************************************/
+void intencion_destroy(tipo_intenciones *intenciones) {
+	if(intenciones != NULL)
+		munmap(intenciones, sizeof(tipo_intenciones));
+}
+
+/****************************************************************************/
+/* Funcion: intencion_publicar                                              */
+/*                                                                          */
+/* Descripcion: la nave escribe su intención como un seqlock (secuencia     */
+/*		impar mientras escribe), marca su bit de pendientes y avisa al      */
+/*		simulador. Solo despierta con una llamada al sistema si el          */
+/*		simulador está esperando.                                           */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		tipo_intenciones *intenciones: intenciones de las naves             */
+/*		int equipo: equipo de la nave                                       */
+/*		int nave: número de la nave                                         */
+/*		int turno: turno para el que se han decidido las acciones          */
+/*		tipo_accion *acciones: acciones decididas                           */
+/*		int num: número de acciones (0 si no hace nada este turno)          */
+/* Parametros de salida: void                                               */
+/****************************************************************************/
+void intencion_publicar(tipo_intenciones *intenciones, int equipo, int nave, int turno, tipo_accion *acciones, int num) {
+	tipo_intencion *in = &intenciones->naves[equipo][nave];
+	int k = equipo * N_NAVES + nave;
+
+	if(num > NAVE_MAX_ACCIONES)
+		num = NAVE_MAX_ACCIONES;
+
+	__atomic_store_n(&in->secuencia, in->secuencia + 1, __ATOMIC_SEQ_CST);
+	in->turno = turno;
+	in->num_acciones = num;
+	memcpy(in->acciones, acciones, num * sizeof(tipo_accion));
+	in->publicadas += num;
+	__atomic_store_n(&in->secuencia, in->secuencia + 1, __ATOMIC_RELEASE);
+
+	__atomic_or_fetch(&intenciones->pendientes[k / 64], 1ULL << (k % 64), __ATOMIC_SEQ_CST);
+	__atomic_add_fetch(&intenciones->avisos, 1, __ATOMIC_SEQ_CST);
+	if(__atomic_load_n(&intenciones->esperando, __ATOMIC_SEQ_CST))
+		syscall(SYS_futex, &intenciones->avisos, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+/****************************************************************************/
+/* Funcion: intencion_avisos                                                */
+/*                                                                          */
+/* Descripcion: lee el contador de intenciones publicadas.                  */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		tipo_intenciones *intenciones: intenciones de las naves             */
+/* Parametros de salida: valor del contador.                                */
+/****************************************************************************/
+uint32_t intencion_avisos(tipo_intenciones *intenciones) {
+	return __atomic_load_n(&intenciones->avisos, __ATOMIC_ACQUIRE);
+}
+
+/****************************************************************************/
+/* Funcion: intencion_esperar                                               */
+/*                                                                          */
+/* Descripcion: el simulador espera a que alguna nave publique. El futex    */
+/*		solo duerme si el contador sigue siendo 'avisos', así que una       */
+/*		intención publicada entre la lectura y la espera no se pierde. Una  */
+/*		señal (la alarma del turno) corta la espera.                        */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		tipo_intenciones *intenciones: intenciones de las naves             */
+/*		uint32_t avisos: contador leído antes de recoger                    */
+/*		long espera_us: espera máxima en microsegundos                      */
+/* Parametros de salida: true si se ha publicado alguna intención.          */
+/****************************************************************************/
+bool intencion_esperar(tipo_intenciones *intenciones, uint32_t avisos, long espera_us) {
+	struct timespec espera = {espera_us / 1000000, (espera_us % 1000000) * 1000L};
+
+	__atomic_store_n(&intenciones->esperando, 1, __ATOMIC_SEQ_CST);
+	if(intencion_avisos(intenciones) == avisos)
+		syscall(SYS_futex, &intenciones->avisos, FUTEX_WAIT, avisos, &espera, NULL, 0);
+	__atomic_store_n(&intenciones->esperando, 0, __ATOMIC_SEQ_CST);
+	return intencion_avisos(intenciones) != avisos;
+}
+
+/****************************************************************************/
+/* Funcion: intencion_copiar                                                */
+/*                                                                          */
+/* Descripcion: copia la intención de una nave con la secuencia par y sin   */
+/*		cambios durante la copia. Lo intenta como mucho                     */
+/*		INTENCION_REINTENTOS veces: una nave que muere a mitad de publicar  */
+/*		deja la secuencia impar para siempre.                               */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		tipo_intencion *in: intención de la nave                            */
+/*		tipo_intencion *copia: destino                                      */
+/*		uint32_t *secuencia: secuencia de la intención copiada              */
+/* Parametros de salida: true si se ha copiado o false si no.               */
+/****************************************************************************/
+static bool intencion_copiar(tipo_intencion *in, tipo_intencion *copia, uint32_t *secuencia) {
+	/* La nave escribe como mucho una vez por orden del jefe, así que casi nunca se repite */
+	for(int i = 0; i < INTENCION_REINTENTOS; i++) {
+		*secuencia = __atomic_load_n(&in->secuencia, __ATOMIC_ACQUIRE);
+		if(*secuencia & 1)
+			continue;
+		memcpy(copia, in, sizeof(*copia));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if(__atomic_load_n(&in->secuencia, __ATOMIC_RELAXED) == *secuencia)
+			return true;
+	}
+	return false;
+}
+
+/****************************************************************************/
+/* Funcion: intencion_recoger                                               */
+/*                                                                          */
+/* Descripcion: recorre los bits de pendientes y copia la última intención  */
+/*		de cada nave marcada. Una nave que ha vuelto a publicar después de  */
+/*		que se borrara su bit puede quedar marcada con una intención ya     */
+/*		recogida; la secuencia lo detecta y no se copia dos veces. Una      */
+/*		nave a mitad de publicar se salta: al terminar vuelve a marcar su   */
+/*		bit, y si ha muerto no lo hace y no se vuelve a mirar.              */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		tipo_intenciones *intenciones: intenciones de las naves             */
+/*		tipo_intencion *copias: destino                                     */
+/*		int max: intenciones que caben en 'copias'                          */
+/* Parametros de salida: número de intenciones copiadas.                    */
+/****************************************************************************/
+int intencion_recoger(tipo_intenciones *intenciones, tipo_intencion *copias, int max) {
+	uint64_t bits;
+	uint32_t secuencia;
+	int n = 0, k;
+
+	for(int w = 0; w < INTENCION_PALABRAS; w++) {
+		if(__atomic_load_n(&intenciones->pendientes[w], __ATOMIC_RELAXED) == 0)
+			continue;
+		bits = __atomic_exchange_n(&intenciones->pendientes[w], 0, __ATOMIC_ACQUIRE);
+		while(bits) {
+			/* Sin sitio se dejan marcadas para la próxima vez */
+			if(n == max) {
+				__atomic_or_fetch(&intenciones->pendientes[w], bits, __ATOMIC_RELEASE);
+				return n;
+			}
+			k = w * 64 + __builtin_ctzll(bits);
+			bits &= bits - 1;
+			if(!intencion_copiar(&intenciones->naves[k / N_NAVES][k % N_NAVES], &copias[n], &secuencia))
+				continue;
+			if(secuencia == recogida[k / N_NAVES][k % N_NAVES])
+				continue;
+			recogida[k / N_NAVES][k % N_NAVES] = secuencia;
+			n++;
+		}
+	}
+	return n;
+}
@@ -0,0 +1,54 @@
+#ifndef SRC_INTENCION_H_
+#define SRC_INTENCION_H_
+
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <simulador.h>
+#include <nave.h>
+
+#define INTENCION_PALABRAS ((N_EQUIPOS * N_NAVES + 63) / 64) // Palabras de 64 bits del mapa de avisos
+
+/* Última intención de una nave: las acciones que ha decidido para un turno. La
+ * nave la escribe sin esperar nunca y una intención nueva sustituye a la
+ * anterior si el simulador todavía no la ha recogido */
+typedef struct {
+	uint32_t secuencia; // Impar mientras la nave la escribe; crece con cada intención
+	int equipo;
+	int nave;
+	int turno; // Turno para el que se decidió
+	int num_acciones;
+	tipo_accion acciones[NAVE_MAX_ACCIONES];
+	unsigned long publicadas; // Acciones publicadas por la nave en total, esta incluida
+} tipo_intencion;
+
+/* Intenciones de todas las naves en una región compartida que heredan los procesos hijos */
+typedef struct {
+	uint32_t avisos; // Crece con cada intención publicada (palabra futex)
+	uint32_t esperando; // 1 si el simulador está bloqueado esperando avisos
+	uint64_t pendientes[INTENCION_PALABRAS]; // Bit equipo * N_NAVES + nave: intención sin recoger
+	tipo_intencion naves[N_EQUIPOS][N_NAVES];
+} tipo_intenciones;
+
+/* Crea las intenciones de todas las naves, vacías */
+tipo_intenciones *intencion_create();
+
+/* Libera las intenciones creadas con intencion_create */
+void intencion_destroy(tipo_intenciones *intenciones);
+
+/* Publica las acciones de una nave para un turno sustituyendo a las que tuviera.
+ * Nunca espera, esté como esté el simulador */
+void intencion_publicar(tipo_intenciones *intenciones, int equipo, int nave, int turno, tipo_accion *acciones, int num);
+
+/* Obtiene el contador de avisos para esperar con intencion_esperar */
+uint32_t intencion_avisos(tipo_intenciones *intenciones);
+
+/* Espera hasta espera_us a que se publique alguna intención después de leer 'avisos'.
+ * Retorna true si se ha publicado */
+bool intencion_esperar(tipo_intenciones *intenciones, uint32_t avisos, long espera_us);
+
+/* Copia en 'copias' la última intención de cada nave que haya publicado desde la
+ * última vez, como mucho 'max'. Retorna el número de intenciones copiadas */
+int intencion_recoger(tipo_intenciones *intenciones, tipo_intencion *copias, int max);
+
+#endif /* SRC_INTENCION_H_ */
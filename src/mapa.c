@@ -2,21 +2,52 @@
 #include <stdbool.h>
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
 #include <unistd.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
-char symbol_equipos[N_EQUIPOS] ={'A', 'B', 'C', 'D'/*, 'E'*/};
+/* Un símbolo por equipo, sin los que ya significan otra cosa en el mapa (X, w) */
+const char symbol_equipos[] = "ABCDEFGHIJKLMNOPQRSTUVWYZabcdefghijklmnopqrstuvxyz0123456789";
+_Static_assert(N_EQUIPOS <= (int)sizeof(symbol_equipos) - 1, "no hay símbolos para tantos equipos");
+
+static bool animar_misiles = true;
+static uint32_t *esperando_cambio = NULL; // En el segmento SHM_AVISOS_NAME, NULL si no hay
+
+_Static_assert((MAPA_TESELA & (MAPA_TESELA - 1)) == 0 && MAPA_TESELA <= 256, "MAPA_TESELA tiene que ser una potencia de dos no mayor que 256");
+
+// Pone o quita la casilla y,x en el plano de ocupación del equipo y en el de todas las naves
+static void mapa_set_ocupacion(tipo_mapa *mapa, int equipo, int posy, int posx, bool ocupada)
+{
+	uint64_t bit = 1ULL << (posx % 64);
+
+	if (ocupada) {
+		mapa->ocupacion[equipo][posy][posx / 64] |= bit;
+		mapa->ocupacion[OCUPACION_TODAS][posy][posx / 64] |= bit;
+	} else {
+		mapa->ocupacion[equipo][posy][posx / 64] &= ~bit;
+		mapa->ocupacion[OCUPACION_TODAS][posy][posx / 64] &= ~bit;
+	}
+}
 
 int mapa_clean_casilla(tipo_mapa *mapa, int posy, int posx)
 {
-	mapa->casillas[posy][posx].equipo=-1;
-	mapa->casillas[posy][posx].numNave=-1;
-	mapa->casillas[posy][posx].simbolo=SYMB_VACIO;
+	tipo_casilla *cas = &mapa->casillas[mapa_casilla(posy, posx)];
+
+	if (cas->equipo >= 0)
+		mapa_set_ocupacion(mapa, cas->equipo, posy, posx, false);
+	cas->equipo=-1;
+	cas->numNave=-1;
+	cas->simbolo=SYMB_VACIO;
 	return 0;
 }
 
 tipo_casilla mapa_get_casilla(tipo_mapa *mapa, int posy, int posx)
 {
-	return mapa->casillas[posy][posx];
+	return mapa->casillas[mapa_casilla(posy, posx)];
 }
 
 int mapa_get_distancia(tipo_mapa *mapa, int oriy,int orix,int targety,int targetx)
@@ -35,61 +66,449 @@ tipo_nave mapa_get_nave(tipo_mapa *mapa, int equipo, int num_nave)
 
 int mapa_get_num_naves(tipo_mapa *mapa, int equipo)
 {
-	return mapa->num_naves[equipo];
+	return mapa->estadisticas[equipo].naves_vivas;
 }
 
 char mapa_get_symbol(tipo_mapa *mapa, int posy, int posx)
 {
-	return mapa->casillas[posy][posx].simbolo;
+	return mapa->casillas[mapa_casilla(posy, posx)].simbolo;
 }
 
 bool mapa_is_casilla_vacia(tipo_mapa *mapa, int posy, int posx)
 {
-	return (mapa->casillas[posy][posx].equipo < 0);
+	return !(mapa->ocupacion[OCUPACION_TODAS][posy][posx / 64] & (1ULL << (posx % 64)));
 }
 
-void mapa_restore(tipo_mapa *mapa)
+/* Palabra w de la fila y de (a xor invertir) and not b, limitada a las columnas minx..maxx.
+ * Con invertir = ~0 se obtienen las casillas libres de a; b puede ser NULL */
+static inline uint64_t mapa_bits_palabra(const uint64_t *a, const uint64_t *b, uint64_t invertir, int y, int w, int minx, int maxx)
 {
-	int i,j;
+	uint64_t bits = a[y * BITS_PALABRAS + w] ^ invertir;
+	int desde = minx - w * 64, hasta = maxx - w * 64;
+
+	if (b) bits &= ~b[y * BITS_PALABRAS + w];
+	if (desde > 0) bits &= ~0ULL << desde;
+	if (hasta < 63) bits &= (2ULL << hasta) - 1;
+	return bits;
+}
 
-	for(j=0;j<MAPA_MAXY;j++) {
-		for(i=0;i<MAPA_MAXX;i++) {
-			tipo_casilla cas = mapa_get_casilla(mapa,j, i);
-			if (cas.equipo < 0) {
-				mapa_set_symbol(mapa,j, i, SYMB_VACIO);
+/* Cuenta los bits de (a xor invertir) and not b en el rectángulo miny..maxy, minx..maxx */
+static int mapa_bits_contar(const uint64_t *a, const uint64_t *b, uint64_t invertir, int miny, int minx, int maxy, int maxx)
+{
+	int y, w, n = 0;
+
+	for (y = miny; y <= maxy; y++)
+		for (w = minx / 64; w <= maxx / 64; w++)
+			n += __builtin_popcountll(mapa_bits_palabra(a, b, invertir, y, w, minx, maxx));
+	return n;
+}
+
+/* Busca el primer bit de (a xor invertir) and not b en el anillo a distancia r de y,x:
+ * fila superior, columnas laterales de arriba abajo y fila inferior */
+static bool mapa_bits_anillo(const uint64_t *a, const uint64_t *b, uint64_t invertir, int posy, int posx, int r, int *y, int *x)
+{
+	int minx = (posx - r < 0) ? 0 : posx - r;
+	int maxx = (posx + r >= MAPA_MAXX) ? MAPA_MAXX - 1 : posx + r;
+	int f, w, lado;
+	uint64_t bits;
+
+	for (f = posy - r; f <= posy + r; f++) {
+		if (f < 0 || f >= MAPA_MAXY) continue;
+		if (f == posy - r || f == posy + r) {
+			/* Fila completa del anillo */
+			for (w = minx / 64; w <= maxx / 64; w++) {
+				bits = mapa_bits_palabra(a, b, invertir, f, w, minx, maxx);
+				if (bits) {
+					*y = f;
+					*x = w * 64 + __builtin_ctzll(bits);
+					return true;
+				}
 			}
-			else {
-				mapa_set_symbol(mapa, j, i,symbol_equipos[cas.equipo]);
+		} else {
+			/* Solo las dos casillas laterales */
+			for (lado = posx - r; lado <= posx + r; lado += 2 * r) {
+				if (lado < 0 || lado >= MAPA_MAXX) continue;
+				if (mapa_bits_palabra(a, b, invertir, f, lado / 64, lado, lado)) {
+					*y = f;
+					*x = lado;
+					return true;
+				}
 			}
 		}
 	}
+	return false;
+}
+
+bool mapa_hay_enemigo(tipo_mapa *mapa, int equipo, int posy, int posx, int radio)
+{
+	int miny = (posy - radio < 0) ? 0 : posy - radio;
+	int maxy = (posy + radio >= MAPA_MAXY) ? MAPA_MAXY - 1 : posy + radio;
+	int minx = (posx - radio < 0) ? 0 : posx - radio;
+	int maxx = (posx + radio >= MAPA_MAXX) ? MAPA_MAXX - 1 : posx + radio;
+
+	return mapa_bits_contar(&mapa->ocupacion[OCUPACION_TODAS][0][0], &mapa->ocupacion[equipo][0][0], 0,
+		miny, minx, maxy, maxx) > 0;
+}
+
+bool mapa_buscar_enemigo(tipo_mapa *mapa, int equipo, int posy, int posx, int radio, int *y, int *x)
+{
+	int r;
+
+	for (r = 1; r <= radio; r++) {
+		if (mapa_bits_anillo(&mapa->ocupacion[OCUPACION_TODAS][0][0], &mapa->ocupacion[equipo][0][0], 0,
+			posy, posx, r, y, x))
+			return true;
+	}
+	return false;
+}
+
+int mapa_contar_libres(tipo_mapa *mapa, int posy, int posx)
+{
+	int miny = (posy == 0) ? 0 : posy - 1;
+	int maxy = (posy == MAPA_MAXY - 1) ? posy : posy + 1;
+	int minx = (posx == 0) ? 0 : posx - 1;
+	int maxx = (posx == MAPA_MAXX - 1) ? posx : posx + 1;
+	int libres;
+
+	libres = mapa_bits_contar(&mapa->ocupacion[OCUPACION_TODAS][0][0], NULL, ~0ULL, miny, minx, maxy, maxx);
+	return mapa_is_casilla_vacia(mapa, posy, posx) ? libres - 1 : libres;
+}
+
+bool mapa_buscar_libre(tipo_mapa *mapa, int posy, int posx, int radio, int *y, int *x)
+{
+	return mapa_bits_anillo(&mapa->ocupacion[OCUPACION_TODAS][0][0], NULL, ~0ULL, posy, posx, radio, y, x);
+}
+
+void mapa_iniciar_cabecera(tipo_mapa *mapa, bool paginas_grandes)
+{
+	tipo_mapa_cabecera *cab = &mapa->cabecera;
+
+	memset(cab, 0, sizeof(*cab));
+	cab->version = MAPA_VERSION;
+	cab->disposicion = MAPA_DISPOSICION;
+	cab->paginas_grandes = paginas_grandes;
+	cab->tamano = sizeof(tipo_mapa);
+	cab->num_equipos = N_EQUIPOS;
+	cab->num_naves = N_NAVES;
+	cab->maxy = MAPA_MAXY;
+	cab->maxx = MAPA_MAXX;
+	cab->tam_nave = sizeof(tipo_nave);
+	cab->tam_estadisticas = sizeof(tipo_estadisticas);
+	cab->tam_vista = sizeof(tipo_vista);
+	cab->off_generacion = offsetof(tipo_mapa, generacion);
+	cab->off_turno = offsetof(tipo_mapa, turno);
+	cab->off_vistas = offsetof(tipo_mapa, vistas);
+	cab->off_vista_actual = offsetof(tipo_mapa, vista_actual);
+	cab->off_vista_secuencia = offsetof(tipo_vista, secuencia);
+	cab->off_vista_turno = offsetof(tipo_vista, turno);
+	cab->off_vista_equipos_vivos = offsetof(tipo_vista, equipos_vivos);
+	cab->off_vista_estadisticas = offsetof(tipo_vista, estadisticas);
+	cab->off_vista_naves = offsetof(tipo_vista, naves);
+	cab->off_vista_indices = offsetof(tipo_vista, indices);
+	for(int i=0;i<N_EQUIPOS && i<MAPA_SIMBOLOS_MAX;i++)
+		cab->simbolos[i] = symbol_equipos[i];
+
+	/* La magia va la última: quien la ve puede leer el resto */
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	memcpy(cab->magia, MAPA_MAGIA, sizeof(cab->magia));
+}
+
+/* Planos de ocupación e índices de la vista recorriendo solo sus listas de naves vivas */
+static void mapa_vista_indexar(tipo_vista *vista)
+{
+	const tipo_nave *nave;
+	int e, k;
+
+	memset(vista->ocupacion, 0, sizeof(vista->ocupacion));
+	memset(vista->indices, -1, sizeof(vista->indices));
+	for(e=0;e<N_EQUIPOS;e++) {
+		for(k=0;k<vista->estadisticas[e].naves_vivas;k++) {
+			nave = &vista->naves[e][vista->vivas[e][k]];
+			vista->ocupacion[e][nave->posy][nave->posx / 64] |= 1ULL << (nave->posx % 64);
+			vista->ocupacion[OCUPACION_TODAS][nave->posy][nave->posx / 64] |= 1ULL << (nave->posx % 64);
+			vista->indices[nave->posy][nave->posx] = e * N_NAVES + vista->vivas[e][k];
+		}
+	}
+}
+
+void mapa_vista_publicar(tipo_mapa *mapa, int turno)
+{
+	uint32_t siguiente = 1 - mapa->vista_actual;
+	tipo_vista *vista = &mapa->vistas[siguiente];
+
+	/* Secuencia impar mientras se escribe, como un seqlock */
+	__atomic_store_n(&vista->secuencia, vista->secuencia + 1, __ATOMIC_SEQ_CST);
+	vista->turno = turno;
+	vista->t_limite = 0;
+	if (mapa->plazo_ns > 0) {
+		struct timespec ahora;
+		clock_gettime(CLOCK_MONOTONIC, &ahora);
+		vista->t_limite = (uint64_t)ahora.tv_sec * 1000000000ULL + ahora.tv_nsec + mapa->plazo_ns;
+	}
+	vista->equipos_vivos = mapa->equipos_vivos;
+	memcpy(vista->estadisticas, mapa->estadisticas, sizeof(vista->estadisticas));
+	memcpy(vista->naves, mapa->info_naves, sizeof(vista->naves));
+	for(int i=0;i<N_EQUIPOS;i++)
+		memcpy(vista->vivas[i], mapa->vivas[i], mapa->estadisticas[i].naves_vivas * sizeof(int));
+	mapa_vista_indexar(vista);
+	__atomic_store_n(&vista->secuencia, vista->secuencia + 1, __ATOMIC_RELEASE);
+	__atomic_store_n(&mapa->vista_actual, siguiente, __ATOMIC_RELEASE);
+}
+
+void mapa_vista_rehacer(tipo_vista *vista)
+{
+	int e, j, n;
+
+	for(e=0;e<N_EQUIPOS;e++) {
+		for(j=0,n=0;j<N_NAVES;j++) {
+			if (vista->naves[e][j].viva)
+				vista->vivas[e][n++] = j;
+		}
+		vista->estadisticas[e].naves_vivas = n;
+	}
+	mapa_vista_indexar(vista);
+}
+
+const tipo_vista *mapa_vista_obtener(tipo_mapa *mapa, uint32_t *secuencia)
+{
+	const tipo_vista *vista;
+
+	/* Solo puede estar a medio escribir si ya se está publicando otra */
+	do {
+		vista = &mapa->vistas[__atomic_load_n(&mapa->vista_actual, __ATOMIC_ACQUIRE)];
+		*secuencia = __atomic_load_n(&vista->secuencia, __ATOMIC_ACQUIRE);
+	} while (*secuencia & 1);
+	return vista;
+}
+
+bool mapa_vista_vigente(const tipo_vista *vista, uint32_t secuencia)
+{
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	return __atomic_load_n(&vista->secuencia, __ATOMIC_RELAXED) == secuencia;
+}
+
+const tipo_nave *mapa_vista_nave(const tipo_vista *vista, int equipo, int num_nave)
+{
+	return &vista->naves[equipo][num_nave];
+}
+
+int mapa_vista_num_vivas(const tipo_vista *vista, int equipo)
+{
+	return vista->estadisticas[equipo].naves_vivas;
+}
+
+const tipo_nave *mapa_vista_viva(const tipo_vista *vista, int equipo, int k)
+{
+	return &vista->naves[equipo][vista->vivas[equipo][k]];
+}
+
+int mapa_vista_indice(const tipo_vista *vista, int posy, int posx)
+{
+	return vista->indices[posy][posx];
+}
+
+const tipo_nave *mapa_vista_nave_indice(const tipo_vista *vista, int indice)
+{
+	return (indice < 0) ? NULL : &vista->naves[indice / N_NAVES][indice % N_NAVES];
+}
+
+bool mapa_vista_vacia(const tipo_vista *vista, int posy, int posx)
+{
+	return !(vista->ocupacion[OCUPACION_TODAS][posy][posx / 64] & (1ULL << (posx % 64)));
+}
+
+const tipo_nave *mapa_vista_buscar_enemigo(const tipo_vista *vista, int equipo, int posy, int posx, int radio)
+{
+	int r, y, x;
+
+	for (r = 1; r <= radio; r++) {
+		if (mapa_bits_anillo(&vista->ocupacion[OCUPACION_TODAS][0][0], &vista->ocupacion[equipo][0][0], 0,
+			posy, posx, r, &y, &x))
+			return mapa_vista_nave_indice(vista, vista->indices[y][x]);
+	}
+	return NULL;
+}
+
+void mapa_restore(tipo_mapa *mapa)
+{
+	int k;
+
+	/* Solo se recorren las casillas marcadas este turno */
+	for(k=0;k<mapa->num_marcas;k++) {
+		tipo_casilla *cas = &mapa->casillas[mapa_casilla(mapa->marcas[k] / MAPA_MAXX, mapa->marcas[k] % MAPA_MAXX)];
+		if (cas->equipo < 0) {
+			cas->simbolo = SYMB_VACIO;
+		}
+		else {
+			cas->simbolo = symbol_equipos[cas->equipo];
+		}
+		cas->marcada = false;
+	}
+	mapa->num_marcas = 0;
+	mapa_notificar_cambio(mapa);
 }
 
 void mapa_set_symbol(tipo_mapa *mapa, int posy, int posx, char symbol)
 {
-	mapa->casillas[posy][posx].simbolo=symbol;
+	tipo_casilla *cas = &mapa->casillas[mapa_casilla(posy, posx)];
+
+	if (!cas->marcada) {
+		cas->marcada = true;
+		mapa->marcas[mapa->num_marcas++] = posy * MAPA_MAXX + posx;
+	}
+	cas->simbolo=symbol;
+	mapa_notificar_cambio(mapa);
+}
+
+// Posición del bloque que contiene y,x dentro del nivel de la pirámide
+static int mapa_mip_bloque(int nivel, int posy, int posx)
+{
+	int l, base = 0;
+
+	for(l=1;l<nivel;l++) base += MIP_BLOQUES(l);
+	return base + (posy >> nivel) * MIP_LADO(MAPA_MAXX, nivel) + (posx >> nivel);
+}
+
+// Suma 'delta' al recuento del equipo en los bloques que contienen y,x en todos los niveles
+static void mapa_sumar_mip(tipo_mapa *mapa, int equipo, int posy, int posx, int delta)
+{
+	int l;
+
+	for(l=1;l<=MIP_NIVELES;l++) {
+		mapa->mip[mapa_mip_bloque(l, posy, posx)][equipo]+=delta;
+	}
+}
+
+void mapa_notificar_cambio(tipo_mapa *mapa)
+{
+	__atomic_add_fetch(&mapa->generacion, 1, __ATOMIC_SEQ_CST);
+	/* Sin nadie esperando no hace falta la llamada al sistema */
+	if (esperando_cambio != NULL && __atomic_load_n(esperando_cambio, __ATOMIC_SEQ_CST) > 0)
+		syscall(SYS_futex, &mapa->generacion, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
 }
 
+uint32_t mapa_get_generacion(tipo_mapa *mapa)
+{
+	return __atomic_load_n(&mapa->generacion, __ATOMIC_ACQUIRE);
+}
+
+void mapa_set_avisos(uint32_t *esperando)
+{
+	esperando_cambio = esperando;
+}
+
+void mapa_recalcular_mip(tipo_mapa *mapa)
+{
+	int i, j;
+
+	memset(mapa->mip, 0, sizeof(mapa->mip));
+	for(i=0;i<N_EQUIPOS;i++) {
+		for(j=0;j<N_NAVES;j++) {
+			if (mapa->info_naves[i][j].viva)
+				mapa_sumar_mip(mapa, i, mapa->info_naves[i][j].posy, mapa->info_naves[i][j].posx, 1);
+		}
+	}
+}
+
+int mapa_get_viva(tipo_mapa *mapa, int equipo, int k)
+{
+	return mapa->vivas[equipo][k];
+}
+
+void mapa_recalcular_vivas(tipo_mapa *mapa)
+{
+	int i, j, n;
+
+	for(i=0;i<N_EQUIPOS;i++) {
+		for(j=0,n=0;j<N_NAVES;j++) {
+			if (mapa->info_naves[i][j].viva) {
+				mapa->vivas[i][n] = j;
+				mapa->indice_viva[i][j] = n++;
+			}
+		}
+	}
+}
+
+int mapa_get_mip(tipo_mapa *mapa, int nivel, int by, int bx, int equipo)
+{
+	return mapa->mip[mapa_mip_bloque(nivel, by << nivel, bx << nivel)][equipo];
+}
 
 int mapa_set_nave(tipo_mapa *mapa, tipo_nave nave)
 {
 	if (nave.equipo >= N_EQUIPOS) return -1;
 	if (nave.numNave >= N_NAVES) return -1;
+
+	/* Actualiza la pirámide solo si la nave cambia de casilla, aparece o es destruida */
+	tipo_nave anterior = mapa->info_naves[nave.equipo][nave.numNave];
+	bool mueve = (anterior.posy != nave.posy) || (anterior.posx != nave.posx);
+	if (anterior.viva && (!nave.viva || mueve)) {
+		mapa_sumar_mip(mapa, nave.equipo, anterior.posy, anterior.posx, -1);
+	}
+	if (nave.viva && (!anterior.viva || mueve)) {
+		mapa_sumar_mip(mapa, nave.equipo, nave.posy, nave.posx, 1);
+	}
+
+	/* Estadísticas del equipo */
+	tipo_estadisticas *est = &mapa->estadisticas[nave.equipo];
+	if (anterior.viva) {
+		est->naves_vivas--;
+		est->vida_total -= anterior.vida;
+	}
+	if (nave.viva) {
+		est->naves_vivas++;
+		est->vida_total += nave.vida;
+	}
+	if (anterior.viva && !nave.viva && est->naves_vivas == 0) mapa->equipos_vivos--;
+	if (!anterior.viva && nave.viva && est->naves_vivas == 1) mapa->equipos_vivos++;
+
+	/* Lista de naves vivas: una baja ocupa su hueco con la última, un alta va al final */
+	int *vivas = mapa->vivas[nave.equipo], *indice = mapa->indice_viva[nave.equipo];
+	if (anterior.viva && !nave.viva) {
+		vivas[indice[nave.numNave]] = vivas[est->naves_vivas];
+		indice[vivas[est->naves_vivas]] = indice[nave.numNave];
+	} else if (!anterior.viva && nave.viva) {
+		vivas[est->naves_vivas - 1] = nave.numNave;
+		indice[nave.numNave] = est->naves_vivas - 1;
+	}
+
 	mapa->info_naves[nave.equipo][nave.numNave]=nave;
 	if (nave.viva) {
-		mapa->casillas[nave.posy][nave.posx].equipo=nave.equipo;
-		mapa->casillas[nave.posy][nave.posx].numNave=nave.numNave;
-		mapa->casillas[nave.posy][nave.posx].simbolo=symbol_equipos[nave.equipo];
+		tipo_casilla *cas = &mapa->casillas[mapa_casilla(nave.posy, nave.posx)];
+		if (cas->equipo >= 0)
+			mapa_set_ocupacion(mapa, cas->equipo, nave.posy, nave.posx, false);
+		mapa_set_ocupacion(mapa, nave.equipo, nave.posy, nave.posx, true);
+		cas->equipo=nave.equipo;
+		cas->numNave=nave.numNave;
+		cas->simbolo=symbol_equipos[nave.equipo];
 	}
 	else {
 		mapa_clean_casilla(mapa,nave.posy, nave.posx);
 	}
+	mapa_notificar_cambio(mapa);
 	return 0;
 }
 
-void mapa_set_num_naves(tipo_mapa *mapa, int equipo, int numNaves)
+tipo_estadisticas mapa_get_estadisticas(tipo_mapa *mapa, int equipo)
 {
-	mapa->num_naves[equipo]=numNaves;
+	return mapa->estadisticas[equipo];
+}
+
+int mapa_get_equipos_vivos(tipo_mapa *mapa)
+{
+	return mapa->equipos_vivos;
+}
+
+void mapa_registrar_ataque(tipo_mapa *mapa, int equipo, int dano, bool destruida)
+{
+	mapa->estadisticas[equipo].dano_causado += dano;
+	if (destruida) mapa->estadisticas[equipo].bajas++;
+	mapa_notificar_cambio(mapa);
+}
+
+void mapa_set_animacion(bool animacion)
+{
+	animar_misiles = animacion;
 }
 
 void mapa_send_misil(tipo_mapa *mapa, int origeny, int origenx, int targety, int targetx)
@@ -122,7 +541,7 @@ void mapa_send_misil(tipo_mapa *mapa, int origeny, int origenx, int targety, int
 		nexts = mapa_get_symbol(mapa,nexty, nextx);
 		mapa_set_symbol(mapa,nexty,nextx,'*');
 		mapa_set_symbol(mapa,py,px,ps);
-		usleep(50000);
+		if (animar_misiles) usleep(50000);
 		px = nextx;
 		py= nexty;
 		ps = nexts;
@@ -131,23 +550,52 @@ void mapa_send_misil(tipo_mapa *mapa, int origeny, int origenx, int targety, int
 	mapa_set_symbol(mapa,py, px,ps);
 }
 
+// Mezcla un valor en un hash FNV-1a de 64 bits
+static uint64_t mapa_hash_mezclar(uint64_t hash, int valor)
+{
+	for(int b=0;b<4;b++) {
+		hash ^= (valor >> (8 * b)) & 0xff;
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+uint64_t mapa_hash(tipo_mapa *mapa)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	int i, j, y, x;
+
+	/* Campo a campo, para no depender del relleno de las estructuras */
+	for(i=0;i<N_EQUIPOS;i++) {
+		for(j=0;j<N_NAVES;j++) {
+			tipo_nave *nave = &mapa->info_naves[i][j];
+			hash = mapa_hash_mezclar(hash, nave->viva ? nave->vida : 0);
+			hash = mapa_hash_mezclar(hash, nave->viva ? nave->posy * MAPA_MAXX + nave->posx : -1);
+		}
+		hash = mapa_hash_mezclar(hash, mapa->estadisticas[i].bajas);
+		hash = mapa_hash_mezclar(hash, mapa->estadisticas[i].dano_causado);
+	}
+	for(y=0;y<MAPA_MAXY;y++) {
+		for(x=0;x<MAPA_MAXX;x++) {
+			hash = mapa_hash_mezclar(hash, mapa->casillas[mapa_casilla(y, x)].simbolo);
+		}
+	}
+	return hash;
+}
+
 char mapa_get_ganador(tipo_mapa *mapa)
 {
-	int j, flag = 0;
-	int winner;
+	int j;
+
+	if(mapa_get_equipos_vivos(mapa) != 1) {
+		return '*';
+	}
 
 	for(j=0;j<N_EQUIPOS;j++) {
 		if(mapa_get_num_naves(mapa, j) > 0) {
-			flag++;
-			/* Guarda el número del equipo */
-			winner = j;
+			return symbol_equipos[j];
 		}
 	}
 
-	if(flag == 1) {
-		tipo_nave nave = mapa_get_nave(mapa, winner, 0);
-		return mapa_get_symbol(mapa, nave.posy, nave.posx);
-	}
-
 	return '*';
 }
@@ -4,6 +4,43 @@
 #include <simulador.h>
 #include <stdbool.h>
 
+#if MAPA_ORDEN == MAPA_ORDEN_MORTON
+// Separa los bits de v (hasta 8) dejando un cero entre cada dos: abc -> a0b0c
+static inline unsigned mapa_morton_separar(unsigned v)
+{
+	v = (v | (v << 4)) & 0x0F0F;
+	v = (v | (v << 2)) & 0x3333;
+	v = (v | (v << 1)) & 0x5555;
+	return v;
+}
+#endif
+
+// Obtiene la posición de la casilla y,x en mapa->casillas según MAPA_ORDEN. Va aquí
+// para que se expanda en cada acceso con las constantes del mapa
+static inline int mapa_casilla(int posy, int posx)
+{
+#if MAPA_ORDEN == MAPA_ORDEN_FILAS
+	return posy * MAPA_MAXX + posx;
+#else
+	/* Sin signo y con lados potencia de dos las divisiones y los restos son desplazamientos y máscaras */
+	unsigned y = posy, x = posx, tesela, dentro;
+
+#if MAPA_TESELA >= MAPA_MAXX && MAPA_TESELA >= MAPA_MAXY
+	tesela = 0; // Una sola tesela: orden Z (o por filas) de todo el mapa
+#else
+	tesela = (y / MAPA_TESELA) * MAPA_TESELAS_X + x / MAPA_TESELA;
+	y %= MAPA_TESELA;
+	x %= MAPA_TESELA;
+#endif
+#if MAPA_ORDEN == MAPA_ORDEN_MORTON
+	dentro = mapa_morton_separar(y) << 1 | mapa_morton_separar(x);
+#else
+	dentro = y * MAPA_TESELA + x;
+#endif
+	return tesela * (MAPA_TESELA * MAPA_TESELA) + dentro;
+#endif
+}
+
 // Pone una casilla del mapa a vacío
 int mapa_clean_casilla(tipo_mapa *mapa, int posy, int posx);
 
@@ -25,22 +62,104 @@ char mapa_get_symbol(tipo_mapa *mapa, int posy, int posx);
 // Chequea si la casilla y,x está vacía en el mapa
 bool mapa_is_casilla_vacia(tipo_mapa *mapa, int posy, int posx);
 
-// Restaura los símbolos del mapa dejando sólo las naves vivas
+// Restaura los símbolos cambiados durante el turno dejando sólo las naves vivas
 void mapa_restore(tipo_mapa *mapa);
 
+// Activa o desactiva las pausas de la animación de los misiles
+void mapa_set_animacion(bool animacion);
+
 // Genera la animación de un misil en el mapa
 void mapa_send_misil(tipo_mapa *mapa, int origeny, int origenx, int targety, int targetx);
 
 // Fija el contenido de "nave" en el mapa, en la posición nave.posy, nave.posx
 int mapa_set_nave(tipo_mapa *mapa, tipo_nave nave);
 
-// Fija el número de naves 'numNaves' para el equipo
-void mapa_set_num_naves(tipo_mapa *mapa, int equipo, int numNaves);
-
 // Fija el símbolo 'symbol' en la posición posy, posx del mapa
 void mapa_set_symbol(tipo_mapa *mapa, int posy, int posx, char symbol);
 
-// Devuelve el símbolo de la nave ganadora
+// Obtiene las estadísticas del equipo
+tipo_estadisticas mapa_get_estadisticas(tipo_mapa *mapa, int equipo);
+
+// Obtiene el número de equipos con alguna nave viva
+int mapa_get_equipos_vivos(tipo_mapa *mapa);
+
+// Suma a las estadísticas del equipo atacante el daño causado y si ha destruido la nave
+void mapa_registrar_ataque(tipo_mapa *mapa, int equipo, int dano, bool destruida);
+
+// Obtiene el número de naves del equipo en el bloque by,bx del nivel de zoom (1 a MIP_NIVELES)
+int mapa_get_mip(tipo_mapa *mapa, int nivel, int by, int bx, int equipo);
+
+// Rehace la pirámide de zoom a partir de las posiciones de las naves
+void mapa_recalcular_mip(tipo_mapa *mapa);
+
+// Obtiene el número de la k-ésima nave viva del equipo (k menor que mapa_get_num_naves)
+int mapa_get_viva(tipo_mapa *mapa, int equipo, int k);
+
+// Rehace las listas de naves vivas a partir de las naves (p. ej. en un mapa reconstruido)
+void mapa_recalcular_vivas(tipo_mapa *mapa);
+
+// Anuncia un cambio en el mapa y despierta a quien espera en el futex de la generación
+void mapa_notificar_cambio(tipo_mapa *mapa);
+
+// Fija el contador de procesos en espera (segmento SHM_AVISOS_NAME) que mira mapa_notificar_cambio
+void mapa_set_avisos(uint32_t *esperando);
+
+// Obtiene la generación actual del mapa
+uint32_t mapa_get_generacion(tipo_mapa *mapa);
+
+// Chequea si hay alguna nave enemiga del equipo a distancia 'radio' o menor de y,x
+bool mapa_hay_enemigo(tipo_mapa *mapa, int equipo, int posy, int posx, int radio);
+
+// Busca la nave enemiga más cercana a y,x sin pasar de 'radio'. Retorna false si no hay ninguna
+bool mapa_buscar_enemigo(tipo_mapa *mapa, int equipo, int posy, int posx, int radio, int *y, int *x);
+
+// Cuenta las casillas vacías alrededor de y,x
+int mapa_contar_libres(tipo_mapa *mapa, int posy, int posx);
+
+// Busca la primera casilla vacía a distancia exacta 'radio' de y,x. Retorna false si no hay ninguna
+bool mapa_buscar_libre(tipo_mapa *mapa, int posy, int posx, int radio, int *y, int *x);
+
+// Rellena la cabecera del segmento que describe su formato a los observadores
+void mapa_iniciar_cabecera(tipo_mapa *mapa, bool paginas_grandes);
+
+// Publica la vista del turno para las naves, copiando el mapa en el buffer que no está publicado
+void mapa_vista_publicar(tipo_mapa *mapa, int turno);
+
+// Rehace las listas de naves vivas, los planos de ocupación y los índices de la vista a partir de sus naves
+void mapa_vista_rehacer(tipo_vista *vista);
+
+// Obtiene la última vista publicada y su secuencia, para comprobar después con mapa_vista_vigente
+const tipo_vista *mapa_vista_obtener(tipo_mapa *mapa, uint32_t *secuencia);
+
+// Chequea que la vista no se ha reescrito desde que se obtuvo, es decir, que lo leído es coherente
+bool mapa_vista_vigente(const tipo_vista *vista, uint32_t secuencia);
+
+// Obtiene una nave de la vista sin copiarla
+const tipo_nave *mapa_vista_nave(const tipo_vista *vista, int equipo, int num_nave);
+
+// Obtiene el número de naves vivas del equipo en la vista
+int mapa_vista_num_vivas(const tipo_vista *vista, int equipo);
+
+// Obtiene la k-ésima nave viva del equipo en la vista sin copiarla
+const tipo_nave *mapa_vista_viva(const tipo_vista *vista, int equipo, int k);
+
+// Obtiene el índice (equipo * N_NAVES + nave) de la nave en y,x, o -1 si la casilla está vacía
+int mapa_vista_indice(const tipo_vista *vista, int posy, int posx);
+
+// Obtiene la nave con un índice de mapa_vista_indice, o NULL si es -1
+const tipo_nave *mapa_vista_nave_indice(const tipo_vista *vista, int indice);
+
+// Chequea si la casilla y,x está vacía en la vista
+bool mapa_vista_vacia(const tipo_vista *vista, int posy, int posx);
+
+// Busca en la vista la nave enemiga más cercana a y,x sin pasar de 'radio'. Retorna NULL si no hay ninguna
+const tipo_nave *mapa_vista_buscar_enemigo(const tipo_vista *vista, int equipo, int posy, int posx, int radio);
+
+// Obtiene un hash del estado del mapa (naves, estadísticas y símbolos) para comparar partidas
+uint64_t mapa_hash(tipo_mapa *mapa);
+
+// Devuelve el símbolo del equipo ganador, o '*' si no hay: quedan varios equipos (la partida
+// sigue o se acabaron los turnos) o no queda ninguno
 char mapa_get_ganador(tipo_mapa *mapa);
 
 
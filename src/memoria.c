@@ -0,0 +1,248 @@
+/**
+ *
+ * Descripcion: colocación del segmento compartido del mapa. Puede pedir páginas
+ *		grandes transparentes (MADV_HUGEPAGE sobre el objeto de shm_open, que
+ *		sigue siendo accesible por nombre para el monitor) y fijar una política
+ *		NUMA con mbind. Si el sistema no lo permite se avisa y se continúa con
+ *		páginas normales.
+ *
+ * Fichero: memoria.c
+ * Autor: Miguel González Bustamante, miguel.gonzalezb@estudiante.uam.es
+ * Grupo: 2261
+ * Fecha: 08-05-2019
+ *
+ */
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <memoria.h>
+
+#define MEMORIA_MAX_NODOS 64 // Nodos NUMA que se tienen en cuenta
+#define MEMORIA_PAGINA_GRANDE (2UL * 1024 * 1024) // Tamaño de página grande en x86-64
+
+static bool paginas_grandes = false;
+static int modo_numa = MEMORIA_NUMA_NINGUNA;
+static int nodo_numa = 0;
+
+/* Resultado de memoria_preparar para el informe */
+static char estado_paginas[128] = "normales";
+static char estado_numa[128] = "primer acceso";
+
+/****************************************************************************/
+/* Funcion: memoria_config                                                  */
+/*                                                                          */
+/* Descripcion: interpreta las opciones de colocación del segmento.         */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		char *paginas: "normales", "grandes" o NULL                         */
+/*		char *numa: "intercalar", "trozos", número de nodo o NULL           */
+/* Parametros de salida: 0 si son válidas o -1 si no.                       */
+/****************************************************************************/
+int memoria_config(char *paginas, char *numa) {
+	char *fin;
+
+	if(paginas != NULL) {
+		if(strcmp(paginas, "grandes") == 0)
+			paginas_grandes = true;
+		else if(strcmp(paginas, "normales") != 0)
+			return -1;
+	}
+
+	if(numa != NULL) {
+		if(strcmp(numa, "intercalar") == 0) {
+			modo_numa = MEMORIA_NUMA_INTERCALAR;
+		} else if(strcmp(numa, "trozos") == 0) {
+			modo_numa = MEMORIA_NUMA_TROZOS;
+		} else {
+			nodo_numa = strtol(numa, &fin, 10);
+			if(*numa == '\0' || *fin != '\0' || nodo_numa < 0 || nodo_numa >= MEMORIA_MAX_NODOS)
+				return -1;
+			modo_numa = MEMORIA_NUMA_NODO;
+		}
+	}
+	return 0;
+}
+
+/****************************************************************************/
+/* Funcion: memoria_leer_linea                                              */
+/*                                                                          */
+/* Descripcion: lee la primera línea de un fichero de sysfs.                */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		char *fichero: ruta del fichero                                     */
+/*		char *linea: destino                                                */
+/*		int tam: tamaño del destino                                         */
+/* Parametros de salida: 0 si se ha leído o -1 si no.                       */
+/****************************************************************************/
+static int memoria_leer_linea(char *fichero, char *linea, int tam) {
+	FILE *f = fopen(fichero, "r");
+
+	if(f == NULL)
+		return -1;
+	if(fgets(linea, tam, f) == NULL) {
+		fclose(f);
+		return -1;
+	}
+	fclose(f);
+	linea[strcspn(linea, "\n")] = '\0';
+	return 0;
+}
+
+/****************************************************************************/
+/* Funcion: memoria_nodos                                                   */
+/*                                                                          */
+/* Descripcion: obtiene los nodos NUMA en línea ("0", "0-1", "0,2-3"...).   */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		int *nodos: destino de los números de nodo                          */
+/* Parametros de salida: número de nodos.                                   */
+/****************************************************************************/
+static int memoria_nodos(int *nodos) {
+	char linea[256], *p;
+	int n = 0, desde, hasta;
+
+	if(memoria_leer_linea("/sys/devices/system/node/online", linea, sizeof(linea)) < 0) {
+		nodos[0] = 0;
+		return 1;
+	}
+
+	for(p = strtok(linea, ","); p != NULL; p = strtok(NULL, ",")) {
+		if(sscanf(p, "%d-%d", &desde, &hasta) != 2)
+			hasta = desde = atoi(p);
+		for(; desde <= hasta && n < MEMORIA_MAX_NODOS; desde++)
+			nodos[n++] = desde;
+	}
+	return n;
+}
+
+/****************************************************************************/
+/* Funcion: memoria_mbind                                                   */
+/*                                                                          */
+/* Descripcion: fija la política NUMA de un tramo del segmento.             */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		void *dir: inicio del tramo (alineado a página)                     */
+/*		size_t tam: longitud del tramo                                      */
+/*		int modo: MPOL_INTERLEAVE o MPOL_BIND                               */
+/*		unsigned long mascara: nodos permitidos                             */
+/* Parametros de salida: 0 si se ha aplicado o -1 si no.                    */
+/****************************************************************************/
+static int memoria_mbind(void *dir, size_t tam, int modo, unsigned long mascara) {
+	return syscall(SYS_mbind, dir, tam, modo, &mascara, MEMORIA_MAX_NODOS, 0) == 0 ? 0 : -1;
+}
+
+/****************************************************************************/
+/* Funcion: memoria_preparar                                                */
+/*                                                                          */
+/* Descripcion: aplica páginas grandes y política NUMA al segmento. Debe    */
+/*		llamarse antes de tocarlo, porque ambas cosas se deciden al asignar */
+/*		cada página.                                                        */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		void *segmento: dirección del segmento mapeado                      */
+/*		size_t tam: tamaño del segmento                                     */
+/* Parametros de salida: retorna true si se han pedido páginas grandes     */
+/*		para el segmento.                                                   */
+/****************************************************************************/
+bool memoria_preparar(void *segmento, size_t tam) {
+	int nodos[MEMORIA_MAX_NODOS], num_nodos, i;
+	unsigned long mascara = 0;
+	size_t pagina = sysconf(_SC_PAGESIZE), trozo;
+	char linea[128];
+	bool grandes = false;
+
+	if(paginas_grandes) {
+		/* Con shm_open el objeto vive en tmpfs: solo admite páginas grandes si
+		 * shmem_enabled no es "never" ni "deny" */
+		if(memoria_leer_linea("/sys/kernel/mm/transparent_hugepage/shmem_enabled", linea, sizeof(linea)) < 0) {
+			sprintf(estado_paginas, "normales (el sistema no tiene páginas grandes transparentes)");
+		} else if(strstr(linea, "[never]") != NULL || strstr(linea, "[deny]") != NULL) {
+			sprintf(estado_paginas, "normales (shmem_enabled=%s)", strstr(linea, "[never]") ? "never" : "deny");
+		} else if(madvise(segmento, tam, MADV_HUGEPAGE) < 0) {
+			sprintf(estado_paginas, "normales (madvise rechazado)");
+		} else {
+			sprintf(estado_paginas, "grandes solicitadas");
+			grandes = true;
+		}
+	}
+
+	if(modo_numa == MEMORIA_NUMA_NINGUNA)
+		return grandes;
+
+	num_nodos = memoria_nodos(nodos);
+	for(i = 0; i < num_nodos; i++)
+		mascara |= 1UL << nodos[i];
+
+	switch(modo_numa) {
+		case MEMORIA_NUMA_INTERCALAR:
+			if(memoria_mbind(segmento, tam, MPOL_INTERLEAVE, mascara) == 0)
+				sprintf(estado_numa, "intercalado entre %d nodos", num_nodos);
+			else
+				sprintf(estado_numa, "primer acceso (mbind rechazado)");
+			break;
+
+		case MEMORIA_NUMA_NODO:
+			if(memoria_mbind(segmento, tam, MPOL_BIND, 1UL << nodo_numa) == 0)
+				sprintf(estado_numa, "fijo en el nodo %d", nodo_numa);
+			else
+				sprintf(estado_numa, "primer acceso (no se puede usar el nodo %d)", nodo_numa);
+			break;
+
+		case MEMORIA_NUMA_TROZOS:
+			/* Cada trozo es un rango seguido de índices de casillas: con
+			 * MAPA_ORDEN_FILAS una franja de filas del mapa; con teselas (o Morton
+			 * dentro de cada tesela) una franja de filas de teselas, porque las
+			 * teselas van seguidas por filas. Los trozos se alinean a página grande
+			 * para no partirlas */
+			trozo = (tam / num_nodos + MEMORIA_PAGINA_GRANDE - 1) & ~(MEMORIA_PAGINA_GRANDE - 1);
+			trozo = (trozo < pagina) ? pagina : trozo;
+			for(i = 0; i < num_nodos && i * trozo < tam; i++) {
+				size_t longitud = (tam - i * trozo < trozo) ? tam - i * trozo : trozo;
+				if(memoria_mbind((char *)segmento + i * trozo, longitud, MPOL_BIND, 1UL << nodos[i]) < 0)
+					break;
+			}
+			if(i == num_nodos || i * trozo >= tam)
+				sprintf(estado_numa, "%d trozos de %zu KB, uno por nodo", i, trozo / 1024);
+			else
+				sprintf(estado_numa, "primer acceso (mbind rechazado en el trozo %d)", i);
+			break;
+	}
+	return grandes;
+}
+
+/****************************************************************************/
+/* Funcion: memoria_informe                                                 */
+/*                                                                          */
+/* Descripcion: muestra el modo de colocación y, leyendo /proc/self/smaps,  */
+/*		cuántos KB del segmento están ya en páginas grandes.                */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		void *segmento: dirección del segmento mapeado                      */
+/*		size_t tam: tamaño del segmento                                     */
+/* Parametros de salida: void                                               */
+/****************************************************************************/
+void memoria_informe(void *segmento, size_t tam) {
+	FILE *f;
+	char linea[256];
+	unsigned long inicio, fin, kb, grandes = 0;
+	bool dentro = false;
+
+	f = fopen("/proc/self/smaps", "r");
+	if(f != NULL) {
+		while(fgets(linea, sizeof(linea), f) != NULL) {
+			if(sscanf(linea, "%lx-%lx ", &inicio, &fin) == 2)
+				dentro = (inicio <= (unsigned long)segmento && (unsigned long)segmento < fin);
+			else if(dentro && sscanf(linea, "ShmemPmdMapped: %lu kB", &kb) == 1)
+				grandes = kb;
+		}
+		fclose(f);
+	}
+
+	fprintf(stdout, "Simulador: segmento del mapa de %zu KB, páginas %s (%lu KB en páginas grandes), NUMA %s\n",
+		tam / 1024, estado_paginas, grandes, estado_numa);
+}
@@ -0,0 +1,25 @@
+#ifndef SRC_MEMORIA_H_
+#define SRC_MEMORIA_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/* Política NUMA del segmento del mapa */
+#define MEMORIA_NUMA_NINGUNA 0 // Cada página en el nodo del primer proceso que la toca
+#define MEMORIA_NUMA_INTERCALAR 1 // Páginas repartidas por turnos entre todos los nodos
+#define MEMORIA_NUMA_NODO 2 // Todo el segmento en un nodo
+#define MEMORIA_NUMA_TROZOS 3 // El segmento en trozos consecutivos, cada uno fijo en un nodo
+
+/* Interpreta las opciones de páginas ("normales" o "grandes") y de NUMA
+ * ("intercalar", "trozos" o el número de un nodo). Retorna -1 si no son válidas */
+int memoria_config(char *paginas, char *numa);
+
+/* Aplica las opciones a un segmento recién mapeado, antes de que nadie lo toque.
+ * Si algo no está disponible se sigue con páginas normales y sin política NUMA.
+ * Retorna true si se han pedido páginas grandes */
+bool memoria_preparar(void *segmento, size_t tam);
+
+/* Muestra el modo activo y cuánto del segmento está en páginas grandes */
+void memoria_informe(void *segmento, size_t tam);
+
+#endif /* SRC_MEMORIA_H_ */
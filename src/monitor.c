@@ -11,71 +11,309 @@
 #include <stdbool.h>
 #include <unistd.h>
 #include <semaphore.h>
+#include <time.h>
 
 #include <simulador.h>
 #include <gamescreen.h>
 #include <mapa.h>
+#include <historial.h>
+#include <observador.h>
+#include <afinidad.h>
 
 #define SEM_CTRL "/sem_ctrl"
+#define PANEL_ANCHO 44 // Columnas reservadas a la derecha para el resumen y la lista de naves
 
 /* Variables globales */
 tipo_mapa *mapa;
-int fd_shm;
+tipo_observador *observador = NULL;
 sem_t *sem_ctrl = NULL;
+volatile sig_atomic_t fin = false;
 
-/* manejador: rutina de tratamiento de la señal SIGINT. */
+/* manejador: rutina de tratamiento de la señal SIGINT. El monitor termina
+ * al acabar el fotograma en curso */
 void manejador_SIGINT(int sig) {
-	screen_end();
-	munmap(mapa, sizeof(*mapa));
-	exit(EXIT_SUCCESS);
+	fin = true;
 }
 
-void mapa_print(tipo_mapa *mapa)
-{
-	int i,j,k,m;
-	char winner;
-	char msg_winner[100], msg[32];
-
-	/* Muestra las casillas del mapa */
-	for(j=0;j<MAPA_MAXY;j++) {
-		for(i=0,k=0;i<MAPA_MAXX;i++, k++) {
-			tipo_casilla cas=mapa_get_casilla(mapa,j, i);
-			//printf("%c",cas.simbolo);
-			screen_addch(j, i+k, cas.simbolo);
-			screen_addch(j, i+k+1, ' ');
+/* manejador: rutina de tratamiento de la señal SIGIO. Solo interrumpe la espera
+ * de cambios para atender una tecla */
+void manejador_SIGIO(int sig) {
+}
+
+/* Opciones de la entrada estándar antes de pedir SIGIO, para dejar el terminal como estaba */
+int flags_entrada = -1;
+
+/* Quita O_ASYNC de la entrada estándar al salir del monitor, por donde salga */
+void monitor_restaurar_entrada() {
+	if(flags_entrada != -1)
+		fcntl(STDIN_FILENO, F_SETFL, flags_entrada);
+}
+
+/* Estado de la vista */
+int zoom = 0; // 0: una casilla por posición; n: bloques de 2^n x 2^n casillas
+int origeny = 0, origenx = 0; // Casilla de la esquina superior izquierda de la vista
+int pagina = 0; // Página de la lista de naves
+
+/* Historial */
+tipo_mapa *pasado = NULL; // Mapa reconstruido del turno que se está viendo
+int viendo = -1; // Turno del historial que se muestra, -1 para ver la partida en directo
+int reconstruido = -1; // Turno que hay ahora en 'pasado'
+int numero = -1; // Turno que se está tecleando para ir a él
+
+/* Escribe un texto en pantalla sin pasar de la última columna */
+void monitor_texto(int fila, int columna, int columnas, char *msg) {
+	for(int l = 0; msg[l] != '\0' && columna + l < columnas; l++) {
+		screen_addch(fila, columna + l, msg[l]);
+	}
+}
+
+/* Símbolo de densidad según la fracción de casillas ocupadas en un bloque */
+char monitor_densidad(int naves, int casillas) {
+	if(naves * 8 < casillas) return '.';
+	if(naves * 4 < casillas) return ':';
+	if(naves * 2 < casillas) return '+';
+	return '#';
+}
+
+/* Calcula las posiciones visibles según el terminal y mantiene la vista dentro del mapa */
+void monitor_vista(int filas, int columnas, int *alto, int *ancho) {
+	int max;
+
+	*alto = (filas > 1) ? filas - 1 : 1;
+	*ancho = (columnas - PANEL_ANCHO) / 2;
+	if(*ancho < 1) *ancho = 1;
+
+	max = (MIP_LADO(MAPA_MAXY, zoom) - *alto) << zoom;
+	origeny = (origeny > max) ? max : origeny;
+	origeny = (origeny < 0) ? 0 : origeny & ~((1 << zoom) - 1);
+	max = (MIP_LADO(MAPA_MAXX, zoom) - *ancho) << zoom;
+	origenx = (origenx > max) ? max : origenx;
+	origenx = (origenx < 0) ? 0 : origenx & ~((1 << zoom) - 1);
+}
+
+/* Cambia el zoom manteniendo el centro de la vista */
+void monitor_zoom(int nuevo, int alto, int ancho) {
+	int centroy = origeny + (alto << zoom) / 2;
+	int centrox = origenx + (ancho << zoom) / 2;
+
+	if(nuevo < 0 || nuevo > MIP_NIVELES) return;
+	zoom = nuevo;
+	origeny = centroy - (alto << zoom) / 2;
+	origenx = centrox - (ancho << zoom) / 2;
+}
+
+/* Pasa a ver un turno del historial, ajustado a los turnos disponibles */
+void monitor_ir(int turno) {
+	int primero, ultimo;
+
+	if(!historial_turnos(&primero, &ultimo)) return;
+	viendo = (turno < primero) ? primero : (turno > ultimo) ? ultimo : turno;
+}
+
+/* Mapa que se dibuja: el compartido en directo o el turno reconstruido del
+ * historial. La partida sigue mientras tanto; si el turno que se ve sale del
+ * historial se pasa al más antiguo que queda */
+tipo_mapa *monitor_fuente(tipo_mapa *mapa) {
+	if(viendo < 0 || pasado == NULL) return mapa;
+	if(viendo == reconstruido) return pasado;
+
+	if(historial_reconstruir(viendo, pasado) < 0) {
+		monitor_ir(viendo);
+		if(historial_reconstruir(viendo, pasado) < 0) {
+			viendo = reconstruido = -1;
+			return mapa;
 		}
-		//printf("\n");
 	}
+	reconstruido = viendo;
+	return pasado;
+}
+
+/* Atiende las teclas pendientes: flechas o hjkl desplazan la vista, +/- cambian
+ * el zoom, n/p pasan de página la lista de naves, espacio pausa o vuelve al
+ * directo, ',' y '.' van al turno anterior o siguiente, un número seguido de
+ * 'g' va a ese turno y q termina */
+void monitor_teclas(int alto, int ancho) {
+	int c;
 
-	/* Muestra la vida de las naves */
-	for(j=0,m=0;j<N_EQUIPOS;j++,m++) {
-		for(i=0,k=0;i<N_NAVES;i++) {
-			tipo_nave nave=mapa_get_nave(mapa,j, i);
-			sprintf(msg, "%c%d life: %d ", nave.equipo+65, nave.numNave, nave.vida);
-			for(int l = 0; l < strlen(msg); l++) {
-				screen_addch(j+m, MAPA_MAXX*2 + 2 + k + l, msg[l]);
+	while((c = screen_getch()) != -1) {
+		switch(c) {
+			case 'h': origenx -= ((ancho + 3) / 4) << zoom; break;
+			case 'l': origenx += ((ancho + 3) / 4) << zoom; break;
+			case 'k': origeny -= ((alto + 3) / 4) << zoom; break;
+			case 'j': origeny += ((alto + 3) / 4) << zoom; break;
+			case '+': monitor_zoom(zoom - 1, alto, ancho); break;
+			case '-': monitor_zoom(zoom + 1, alto, ancho); break;
+			case 'n': pagina++; break;
+			case 'p': if(pagina > 0) pagina--; break;
+			case ' ': if(viendo >= 0) viendo = -1; else monitor_ir(mapa->turno); break;
+			case ',': monitor_ir(((viendo >= 0) ? viendo : mapa->turno) - 1); break;
+			case '.': if(viendo >= 0) monitor_ir(viendo + 1); break;
+			case 'g': if(numero >= 0) monitor_ir(numero); numero = -1; break;
+			case 27: numero = -1; break;
+			case 'q': fin = true; break;
+			default:
+				if(c >= '0' && c <= '9' && numero < 100000000)
+					numero = ((numero < 0) ? 0 : numero * 10) + c - '0';
+		}
+	}
+}
+
+/* Muestra la parte visible del mapa. Con zoom cada posición resume un bloque
+ * con el equipo dominante y la densidad de naves, leídos de la pirámide */
+void monitor_print_mapa(tipo_mapa *mapa, int alto, int ancho) {
+	int r, c, e, by, bx;
+	int lado = 1 << zoom;
+
+	for(r = 0, by = origeny >> zoom; r < alto && by < MIP_LADO(MAPA_MAXY, zoom); r++, by++) {
+		for(c = 0, bx = origenx >> zoom; c < ancho && bx < MIP_LADO(MAPA_MAXX, zoom); c++, bx++) {
+			if(zoom == 0) {
+				screen_addch(r, 2*c, mapa_get_symbol(mapa, by, bx));
+				screen_addch(r, 2*c+1, ' ');
+				continue;
+			}
+
+			int total = 0, dominante = 0, naves;
+			for(e = 0; e < N_EQUIPOS; e++) {
+				naves = mapa_get_mip(mapa, zoom, by, bx, e);
+				total += naves;
+				if(naves > mapa_get_mip(mapa, zoom, by, bx, dominante)) dominante = e;
+			}
+			if(total == 0) {
+				screen_addch(r, 2*c, SYMB_VACIO);
+				screen_addch(r, 2*c+1, ' ');
+			} else {
+				int casillas = ((MAPA_MAXY - by*lado < lado) ? MAPA_MAXY - by*lado : lado) *
+					((MAPA_MAXX - bx*lado < lado) ? MAPA_MAXX - bx*lado : lado);
+				screen_addch(r, 2*c, symbol_equipos[dominante]);
+				screen_addch(r, 2*c+1, monitor_densidad(total, casillas));
 			}
-			k+=strlen(msg);
 		}
-		//printf("\n");
+	}
+}
+
+/* Muestra el resumen de cada equipo, el ganador y una página de la lista de naves vivas */
+void monitor_print_panel(tipo_mapa *mapa, int alto, int columna, int columnas) {
+	int j, k, fila, por_pagina, paginas, total = 0;
+	int vivas[N_EQUIPOS];
+	char winner;
+	char msg[64];
+
+	for(j=0;j<N_EQUIPOS;j++) {
+		tipo_estadisticas est=mapa_get_estadisticas(mapa, j);
+		sprintf(msg, "%c naves: %d life: %d kills: %d dmg: %d", symbol_equipos[j], est.naves_vivas,
+			est.vida_total, est.bajas, est.dano_causado);
+		monitor_texto(j, columna, columnas, msg);
+		/* El simulador puede estar cambiándolas: se usa la misma cuenta en toda la página */
+		vivas[j] = (est.naves_vivas < 0) ? 0 : (est.naves_vivas > N_NAVES) ? N_NAVES : est.naves_vivas;
+		total += vivas[j];
 	}
 
 	winner = mapa_get_ganador(mapa);
 
 	/* Imprime un mensaje con el equipo ganador */
-	if(winner == 'A' || winner == 'B' || winner == 'C' || winner == 'D') {
-		sprintf(msg_winner, "%c WINS!", winner);
-		for(int i = 0; i < strlen(msg_winner); i++) {
-			screen_addch(j+m, MAPA_MAXX*2 + 2 + i, msg_winner[i]);
+	if(winner != '*') {
+		sprintf(msg, "%c WINS!", winner);
+		monitor_texto(j, columna, columnas, msg);
+	} else if(mapa_get_equipos_vivos(mapa) == 0) {
+		/* Los últimos equipos se han destruido a la vez */
+		monitor_texto(j, columna, columnas, "NO WINNER");
+	}
+
+	/* Solo se recorren las naves vivas de la página visible */
+	fila = N_EQUIPOS + 2;
+	por_pagina = alto - fila;
+	if(por_pagina < 1) return;
+	paginas = (total > 0) ? (total + por_pagina - 1) / por_pagina : 1;
+	if(pagina >= paginas) pagina = paginas - 1;
+
+	sprintf(msg, "Naves vivas (%d/%d):", pagina + 1, paginas);
+	monitor_texto(fila - 1, columna, columnas, msg);
+	k = pagina * por_pagina;
+	for(j = 0; j < N_EQUIPOS && k >= vivas[j]; j++)
+		k -= vivas[j];
+	for(; j < N_EQUIPOS && fila < alto; j++, k = 0) {
+		for(; k < vivas[j] && fila < alto; k++, fila++) {
+			tipo_nave nave = mapa_get_nave(mapa, j, mapa_get_viva(mapa, j, k));
+			sprintf(msg, "%c%-5d life: %d", symbol_equipos[j], nave.numNave, nave.vida);
+			monitor_texto(fila, columna, columnas, msg);
 		}
-	} 
+	}
+}
+
+/* Dibuja un fotograma. El coste depende del tamaño del terminal y no del mapa */
+void mapa_print(tipo_mapa *mapa)
+{
+	int filas, columnas, alto, ancho;
+	tipo_mapa *fuente;
+	char msg[192], turno[48];
+
+	screen_size(&filas, &columnas);
+	monitor_teclas((filas > 1) ? filas - 1 : 1, (columnas - PANEL_ANCHO) / 2);
+	monitor_vista(filas, columnas, &alto, &ancho);
+	fuente = monitor_fuente(mapa);
+
+	screen_clear();
+	monitor_print_mapa(fuente, alto, ancho);
+	monitor_print_panel(fuente, alto, 2*ancho + 2, columnas);
+
+	if(numero >= 0)
+		sprintf(turno, "ir al turno %d", numero);
+	else if(viendo >= 0)
+		sprintf(turno, "turno %d/%d PAUSA", viendo, mapa->turno);
+	else
+		sprintf(turno, "turno %d", mapa->turno);
+	sprintf(msg, "zoom 1:%d  %d,%d  %s  flechas: mover  +/-: zoom  n/p: naves  espacio: pausa  ,/.: turno  <n>g: ir  q: salir",
+		1 << zoom, origeny, origenx, turno);
+	monitor_texto(filas - 1, 0, columnas, msg);
 
 	screen_refresh();
 }
 
+/* Elige el menor zoom con el que el mapa entero cabe en el terminal */
+void monitor_zoom_inicial() {
+	int filas, columnas, alto, ancho;
+
+	screen_size(&filas, &columnas);
+	monitor_vista(filas, columnas, &alto, &ancho);
+	while(zoom < MIP_NIVELES && (MIP_LADO(MAPA_MAXY, zoom) > alto || MIP_LADO(MAPA_MAXX, zoom) > ancho))
+		zoom++;
+}
+
+
+int main(int argc, char *argv[]) {
+	int sval, opt;
+	int fps = SCREEN_FPS, fotogramas = 0;
+	char *fichero_historial = NULL;
+	struct timespec fotograma;
+	uint32_t vista;
 
-int main() {
-	int sval;
+	while((opt = getopt(argc, argv, "f:r:R:c:")) != -1) {
+		switch(opt) {
+			case 'f':
+				fps = atoi(optarg);
+				break;
+			case 'r':
+				fotogramas = atoi(optarg);
+				break;
+			case 'R':
+				fichero_historial = optarg;
+				break;
+			case 'c':
+				if(afinidad_config(optarg, NULL, 0) == 0)
+					break;
+				/* fall through */
+			default:
+				printf("Uso: %s [-f fotogramas/s] [-r fotogramas] [-R fichero] [-c cpus]\n", argv[0]);
+				printf("  -r fotogramas  dibuja sin esperar ese número de fotogramas, pasando por todos los zooms, y termina\n");
+				printf("  -R fichero     historial de turnos del simulador lanzado con -R\n");
+				printf("  -c cpus        CPUs del monitor (p. ej. 1 o 1,3)\n");
+				exit(EXIT_FAILURE);
+		}
+	}
+	if(fps < 1) {
+		printf("ERROR DE MONITOR: fotogramas por segundo fuera de rango.\n");
+		exit(EXIT_FAILURE);
+	}
 
 	if ((sem_ctrl = sem_open(SEM_CTRL, O_CREAT, S_IRUSR | S_IWUSR, 0)) == SEM_FAILED) {
         printf ("ERROR DE SIMULADOR: creando el semaforo de cola de mensajes.\n");
@@ -93,43 +331,87 @@ int main() {
     sigemptyset(&(act_SIGINT.sa_mask));
     act_SIGINT.sa_flags = 0;
     act_SIGINT.sa_handler = manejador_SIGINT;
-    if(sigaction(SIGUSR2, &act_SIGINT, NULL) < 0) {
+    if(sigaction(SIGUSR2, &act_SIGINT, NULL) < 0 || sigaction(SIGINT, &act_SIGINT, NULL) < 0) {
         printf("ERROR DE MONITOR: creando el manejador_SIGINT.\n");
         exit(EXIT_FAILURE);
     }
 
+	/* Una tecla en el terminal genera SIGIO y despierta al monitor */
+	struct sigaction act_SIGIO;
+    sigemptyset(&(act_SIGIO.sa_mask));
+    act_SIGIO.sa_flags = 0;
+    act_SIGIO.sa_handler = manejador_SIGIO;
+    if(sigaction(SIGIO, &act_SIGIO, NULL) < 0) {
+        printf("ERROR DE MONITOR: creando el manejador_SIGIO.\n");
+        exit(EXIT_FAILURE);
+    }
+    fcntl(STDIN_FILENO, F_SETOWN, getpid());
+    flags_entrada = fcntl(STDIN_FILENO, F_GETFL);
+    if(flags_entrada != -1) {
+        atexit(monitor_restaurar_entrada);
+        fcntl(STDIN_FILENO, F_SETFL, flags_entrada | O_ASYNC);
+    }
+
 	/* Apertura de la memoria compartida para el mapa */
-	fd_shm = shm_open(SHM_MAP_NAME, O_RDONLY, 0); 
-	if(fd_shm == -1) {
-		printf("ERROR DE MONITOR: abriendo el segmento de memoria compartida.\n"); 
+	observador = observador_abrir(SHM_MAP_NAME);
+	if(observador == NULL) {
+		printf("ERROR DE MONITOR: abriendo el segmento de memoria compartida.\n");
+		exit(EXIT_FAILURE);
+	}
+	/* El monitor dibuja con las funciones de mapa.c: necesita las mismas constantes */
+	mapa = (tipo_mapa *)observador_segmento(observador, sizeof(*mapa));
+	if(mapa == NULL) {
+		printf("ERROR DE MONITOR: el simulador se ha compilado con otro tamaño de mapa o de equipos.\n");
 		exit(EXIT_FAILURE);
 	}
-	mapa = (tipo_mapa *)mmap(NULL, sizeof(*mapa), PROT_READ, MAP_SHARED, fd_shm, 0);
-	if(mapa == MAP_FAILED) {
-		printf("ERROR DE MONITOR: mapeando el segmento de memoria compartida.\n");
+	if(mapa->cabecera.disposicion != MAPA_DISPOSICION) {
+		printf("ERROR DE MONITOR: el simulador se ha compilado con otro orden de casillas (MAPA_ORDEN, MAPA_TESELA).\n");
 		exit(EXIT_FAILURE);
 	}
+	/* Si el simulador lo ha creado con páginas grandes, el monitor también las usa.
+	 * Solo entonces: con shmem_enabled=advise el madvise del monitor bastaría para
+	 * que el segmento pasara a páginas grandes sin que el simulador lo sepa */
+	if(mapa->cabecera.paginas_grandes)
+		madvise(mapa, sizeof(*mapa), MADV_HUGEPAGE);
 
+	/* Sin historial el monitor solo muestra la partida en directo */
+	if(historial_abrir(fichero_historial) == 0)
+		pasado = calloc(1, sizeof(*pasado));
+
+	afinidad_principal("Monitor");
 	screen_init();
+	monitor_zoom_inicial();
 
-	while(1){
-		sigset_t set, oset;
-
-        /* Máscara que bloqueará las señales */
-        sigemptyset(&set);
-        sigaddset(&set, SIGINT);
-        if (sigprocmask(SIG_BLOCK, &set, &oset) < 0) {
-            perror("sigprocmask");
-            exit(EXIT_FAILURE);
-        }
-
-        mapa_print(mapa);
-            
-        if (sigprocmask(SIG_UNBLOCK, &set, &oset) < 0) {
-            perror("sigprocmask");
-            exit(EXIT_FAILURE);
-        }
-
-        usleep(SCREEN_REFRESH);
+	/* Recorrido fijo para medir el coste de dibujo o entrenar la compilación PGO */
+	for(int k = 0; k < fotogramas && !fin; k++) {
+		zoom = k % (MIP_NIVELES + 1);
+		pagina = k;
+		mapa_print(mapa);
 	}
+	fin = fin || fotogramas > 0;
+
+	while(!fin) {
+		vista = observador_generacion(observador);
+		mapa_print(mapa);
+		if(fin) break;
+		clock_gettime(CLOCK_MONOTONIC, &fotograma);
+
+		/* Duerme hasta que el simulador cambie el mapa, llegue una tecla o una
+		 * señal, o pase SCREEN_ESPERA_MS */
+		observador_esperar(observador, vista, SCREEN_ESPERA_MS);
+
+		/* Los cambios que lleguen antes del siguiente fotograma se muestran juntos */
+		fotograma.tv_nsec += 1000000000L / fps;
+		if(fotograma.tv_nsec >= 1000000000L) {
+			fotograma.tv_sec++;
+			fotograma.tv_nsec -= 1000000000L;
+		}
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &fotograma, NULL);
+	}
+
+	screen_end();
+	historial_cerrar();
+	free(pasado);
+	observador_cerrar(observador);
+	exit(EXIT_SUCCESS);
 }
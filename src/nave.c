@@ -26,6 +26,7 @@
 #include <semaphore.h>
 #include <mapa.h>
 #include <simulador.h>
+#include <nave.h>
 
 /****************************************************************************/
 /* Funcion: manejador_SIGTERM                                               */
@@ -68,65 +69,29 @@ int manejador_SIGTERM_create(struct sigaction act){
 /* Funcion: nave_create                                                     */
 /*                                                                          */
 /* Descripcion: se encarga de crear las estructuras de las naves que guardan*/
-/*		su información y posicionarlas sobre el mapa.                       */
+/*		su información y posicionarlas sobre el mapa. La posición la elige  */
+/*		colocacion_repartir.                                                */
 /*                                                                          */
 /* Parametros de entrada:                                                   */
 /*		int numEquipo: número del equipo                                    */
 /*		int numNave: número de la nave                                      */
+/*		int posy: fila de la nave                                           */
+/*		int posx: columna de la nave                                        */
 /*                                                                          */
-/* Parametros de salida: retorna la estructura de la nave o NULL si no ha   */
-/*		sido posible crearla.                                               */
-/****************************************************************************/
-tipo_nave *nave_create(int numEquipo, int numNave) {
-	tipo_nave *nave = (tipo_nave*)malloc(sizeof(tipo_nave));
-	if(nave == NULL)
-		return NULL;
-
-	if(N_EQUIPOS > 4) {
-		/* Estos calculos son necesarios para centrar las naves */
-		double spaceX_aux = MAPA_MAXX/N_EQUIPOS;
-		int spaceX = (int)floor(spaceX_aux);
-		int leftSpaceX = (int)floor((MAPA_MAXX - (N_EQUIPOS - 1) * spaceX_aux)/2);
-		nave->posx = numEquipo*spaceX + leftSpaceX;
-
-		double spaceY_aux = MAPA_MAXY/N_EQUIPOS;
-		int spaceY = (int)floor(spaceY_aux);
-		int leftSpaceY = (int)floor((MAPA_MAXY - (N_NAVES - 1) * spaceY_aux)/2);
-		nave->posy = numNave*spaceY + leftSpaceY;
-	} 
-
-	else {
-		int sqrtNaves = 2;
-		if(N_NAVES > 3)
-			sqrtNaves = (int)floor(sqrt(N_NAVES));
-
-		if(numEquipo == 0) {
-			nave->posx = numNave%sqrtNaves;
-			nave->posy = (int)floor(numNave/sqrtNaves);
-		} 
-
-		else if(numEquipo == 1) {
-			nave->posx = (MAPA_MAXX - 1) - numNave%sqrtNaves;
-			nave->posy = (int)floor(numNave/sqrtNaves);
-		} 
-
-		else if(numEquipo == 2) {
-			nave->posx = numNave%sqrtNaves;
-			nave->posy = (MAPA_MAXY - 1) - (int)floor(numNave/sqrtNaves);
-		} 
-
-		else if(numEquipo == 3) {
-			nave->posx = (MAPA_MAXX - 1) - numNave%sqrtNaves;
-			nave->posy = (MAPA_MAXY - 1) - (int)floor(numNave/sqrtNaves);
-		}
-	}
+/* Parametros de salida: retorna la estructura de la nave.                  */
+/****************************************************************************/
+tipo_nave nave_create(int numEquipo, int numNave, int posy, int posx) {
+	tipo_nave nave_nueva;
+	tipo_nave *nave = &nave_nueva;
 
+	nave->posy = posy;
+	nave->posx = posx;
 	nave->vida = VIDA_MAX;
 	nave->equipo = numEquipo;
 	nave->numNave = numNave;
 	nave->viva = true;
 	
-	return nave;
+	return nave_nueva;
 }
 
 /****************************************************************************/
@@ -135,17 +100,17 @@ tipo_nave *nave_create(int numEquipo, int numNave) {
 /* Descripcion: se encarga de rastrear la nave más cercana.                 */
 /*                                                                          */
 /* Parametros de entrada:                                                   */
-/*		tipo_mapa *mapa: estructura del mapa                                */
-/*		tipo_nave *nave: esrtuctura de la nave                              */
-/*		int i: número de la nave                                            */
+/*		const tipo_vista *vista: vista del turno                            */
+/*		const tipo_nave *nave: esrtuctura de la nave                        */
+/*		int i: número del equipo de la nave                                 */
 /*                                                                          */
-/* Parametros de salida: retorna la estructura de la nave.                  */
+/* Parametros de salida: retorna la nave rastreada dentro de la vista o     */
+/*		NULL si no queda ninguna enemiga.                                   */
 /****************************************************************************/
-tipo_nave nave_rastrear(tipo_mapa *mapa, tipo_nave *nave, int i) {
-	tipo_nave nave_rastreada;
-	tipo_nave nave_enemiga;
-	nave_rastreada.equipo = -1;
-	int numEquipoEnemigo;
+const tipo_nave *nave_rastrear(const tipo_vista *vista, const tipo_nave *nave, int i) {
+	const tipo_nave *nave_rastreada = NULL;
+	const tipo_nave *nave_enemiga;
+	int numEquipoEnemigo, distancia, mejor = 0;
 
 	numEquipoEnemigo = rand() % N_EQUIPOS;
 
@@ -154,14 +119,13 @@ tipo_nave nave_rastrear(tipo_mapa *mapa, tipo_nave *nave, int i) {
 			numEquipoEnemigo = 0;
 		/* Solo se actua sobre enemigos */
 		if(numEquipoEnemigo != i) {
-			for(int numNaveEnemiga = 0; numNaveEnemiga < N_NAVES; numNaveEnemiga++) {
-				nave_enemiga = mapa_get_nave(mapa, numEquipoEnemigo, numNaveEnemiga);
-				if((nave_rastreada.equipo == -1) && (nave_enemiga.viva == true)) {
-					nave_rastreada = mapa_get_nave(mapa, numEquipoEnemigo, numNaveEnemiga);
-				} else if((mapa_get_distancia(mapa, nave->posy, nave->posx, nave_enemiga.posy, nave_enemiga.posx) < 
-					mapa_get_distancia(mapa, nave->posy, nave->posx, nave_rastreada.posy, nave_rastreada.posx))
-					&& nave_enemiga.viva == true) {
-					nave_rastreada = mapa_get_nave(mapa, numEquipoEnemigo, numNaveEnemiga);
+			/* Solo las vivas: las destruidas ya no están en la lista */
+			for(int k = 0; k < mapa_vista_num_vivas(vista, numEquipoEnemigo); k++) {
+				nave_enemiga = mapa_vista_viva(vista, numEquipoEnemigo, k);
+				distancia = mapa_get_distancia(NULL, nave->posy, nave->posx, nave_enemiga->posy, nave_enemiga->posx);
+				if(nave_rastreada == NULL || distancia < mejor) {
+					nave_rastreada = nave_enemiga;
+					mejor = distancia;
 				}
 			}	
 		}
@@ -176,23 +140,16 @@ tipo_nave nave_rastrear(tipo_mapa *mapa, tipo_nave *nave, int i) {
 /*		distancia de alcance.                                               */
 /*                                                                          */
 /* Parametros de entrada:                                                   */
-/*		tipo_mapa *mapa: estructura del mapa                                */
-/*		tipo_nave *nave: esrtuctura de la nave                              */
-/*		int i: número de la nave                                            */
+/*		const tipo_vista *vista: vista del turno                            */
+/*		const tipo_nave *nave: esrtuctura de la nave                        */
+/*		int i: número del equipo de la nave                                 */
 /*                                                                          */
-/* Parametros de salida: retorna la estructura de la nave.                  */
+/* Parametros de salida: retorna la nave a atacar dentro de la vista o NULL */
+/*		si no hay ninguna al alcance.                                       */
 /****************************************************************************/
-tipo_nave nave_atacar(tipo_mapa *mapa, tipo_nave *nave, int i) {
-	tipo_nave nave_enemiga, nave_enemiga_aux;
-	int distancia = 0;
-
-	nave_enemiga_aux = nave_rastrear(mapa, nave, i);
-	if(((distancia = mapa_get_distancia(mapa, nave->posy, nave->posx, nave_enemiga_aux.posy, nave_enemiga_aux.posx))< ATAQUE_ALCANCE)
-		&& nave_enemiga_aux.viva == true) {
-		return nave_enemiga_aux;
-	}
-	nave_enemiga.equipo = -1;
-	return nave_enemiga;
+const tipo_nave *nave_atacar(const tipo_vista *vista, const tipo_nave *nave, int i) {
+	/* Busca la más cercana por anillos en los planos de ocupación, sin recorrer todas las naves */
+	return mapa_vista_buscar_enemigo(vista, i, nave->posy, nave->posx, ATAQUE_ALCANCE - 1);
 }
 
 /****************************************************************************/
@@ -202,15 +159,15 @@ tipo_nave nave_atacar(tipo_mapa *mapa, tipo_nave *nave, int i) {
 /*		en la que se desplaza la nave.                                      */
 /*                                                                          */
 /* Parametros de entrada:                                                   */
-/*		tipo_nave *nave: esrtuctura de la nave                              */
-/*		tipo_nave nave_enemiga: esrtuctura de la nave enemiga               */
+/*		const tipo_nave *nave: esrtuctura de la nave                        */
+/*		const tipo_nave *nave_enemiga: esrtuctura de la nave enemiga        */
 /*                                                                          */
 /* Parametros de salida: retorna la dirección en la que se desplaza la nave.*/
 /****************************************************************************/
-int nave_seguirX(tipo_nave *nave, tipo_nave nave_enemiga) {
-	if(nave->posx < nave_enemiga.posx) 
+int nave_seguirX(const tipo_nave *nave, const tipo_nave *nave_enemiga) {
+	if(nave->posx < nave_enemiga->posx) 
 		return 1;
-	else if(nave->posx > nave_enemiga.posx)
+	else if(nave->posx > nave_enemiga->posx)
 		return -1;
 	else
 		return 0;
@@ -223,16 +180,130 @@ int nave_seguirX(tipo_nave *nave, tipo_nave nave_enemiga) {
 /*		en la que se desplaza la nave.                                      */
 /*                                                                          */
 /* Parametros de entrada:                                                   */
-/*		tipo_nave *nave: esrtuctura de la nave                              */
-/*		tipo_nave nave_enemiga: esrtuctura de la nave enemiga               */
+/*		const tipo_nave *nave: esrtuctura de la nave                        */
+/*		const tipo_nave *nave_enemiga: esrtuctura de la nave enemiga        */
 /*                                                                          */
 /* Parametros de salida: retorna la dirección en la que se desplaza la nave.*/
 /****************************************************************************/
-int nave_seguirY(tipo_nave *nave, tipo_nave nave_enemiga) {
-	if(nave->posy < nave_enemiga.posy) 
+int nave_seguirY(const tipo_nave *nave, const tipo_nave *nave_enemiga) {
+	if(nave->posy < nave_enemiga->posy) 
 		return 1;
-	else if(nave->posy > nave_enemiga.posy)
+	else if(nave->posy > nave_enemiga->posy)
 		return -1;
 	else
 		return 0;
-}
\ No newline at end of file
+}
+
+/****************************************************************************/
+/* Funcion: nave_moverAleatorioY                                            */
+/*                                                                          */
+/* Descripcion: genera un número aleatorio para el moviemiento de una nave  */
+/* 		en la coordenada 'y'.                                               */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		int posY: posición de la coordena 'y'                               */
+/* Parametros de salida: la posición de la coordenada 'y' a donde se        */
+/*		desplaza.                                                           */
+/****************************************************************************/
+int nave_moverAleatorioY(int posY) {
+	int maxY = 0, minY = 0;
+
+	maxY = posY + MOVER_ALCANCE;
+	minY = posY - MOVER_ALCANCE;
+
+	if(posY >= MAPA_MAXY - 1)
+		maxY = minY;
+	else if(posY <= 0)
+		minY = maxY;
+
+	return (rand() % (maxY + 1 - minY)) + minY;
+}
+
+/****************************************************************************/
+/* Funcion: nave_moverAleatorioX                                            */
+/*                                                                          */
+/* Descripcion: genera un número aleatorio para el moviemiento de una nave  */
+/* 		en la coordenada 'x'.                                               */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		int posY: posición de la coordena 'x'                               */
+/* Parametros de salida: la posición de la coordenada 'x' a donde se        */
+/*		desplaza.                                                           */
+/****************************************************************************/
+int nave_moverAleatorioX(int posX) {
+	int maxX = 0, minX = 0;
+
+	maxX = posX + MOVER_ALCANCE;
+	minX = posX - MOVER_ALCANCE;
+
+	if(posX >= MAPA_MAXX - 1)
+		maxX = minX;
+	else if(posX <= 0)
+		minX = maxX;
+
+	return (rand() % (maxX + 1 - minX)) + minX;
+}
+
+/****************************************************************************/
+/* Funcion: nave_decidir                                                    */
+/*                                                                          */
+/* Descripcion: decide qué hace una nave al recibir la orden ACCION ATAQUE  */
+/*		del jefe: ataca si tiene un enemigo a su alcance o se acerca al más */
+/*		cercano, y después intenta un movimiento aleatorio alrededor del    */
+/*		destino anterior. Todo se decide sobre la vista publicada al        */
+/*		empezar el turno, que no cambia mientras se lee y se consulta sin   */
+/*		copiar naves ni casillas. No depende del proceso, así que la usan   */
+/*		tanto las naves como la partida sin procesos del simulador.         */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		const tipo_vista *vista: vista del turno                            */
+/*		int equipo: equipo de la nave                                       */
+/*		int numNave: número de la nave                                      */
+/*		tipo_accion *acciones: destino, con sitio para NAVE_MAX_ACCIONES    */
+/*                                                                          */
+/* Parametros de salida: retorna el número de acciones.                     */
+/****************************************************************************/
+int nave_decidir(const tipo_vista *vista, int equipo, int numNave, tipo_accion *acciones) {
+	const tipo_nave *nave, *nave_enemiga;
+	tipo_accion *accion = &acciones[0];
+	int aleatY, aleatX;
+
+	nave = mapa_vista_nave(vista, equipo, numNave);
+	memset(acciones, 0, NAVE_MAX_ACCIONES * sizeof(tipo_accion));
+	accion->equipo = equipo;
+	accion->nave = numNave;
+	accion->oriY = nave->posy;
+	accion->oriX = nave->posx;
+
+	/* Si la nave se encuentra en posición de atacar */
+	nave_enemiga = nave_atacar(vista, nave, equipo);
+	if(nave_enemiga != NULL) {
+		strcpy(accion->tipo, "ACCION ATAQUE");
+		accion->desY = nave_enemiga->posy;
+		accion->desX = nave_enemiga->posx;
+	} else {
+		/* Si no, realiza un movimiento hacia un enemigo */
+		strcpy(accion->tipo, "ACCION MOVER");
+		nave_enemiga = nave_rastrear(vista, nave, equipo);
+		if(nave_enemiga != NULL) {
+			accion->desY = nave->posy + nave_seguirY(nave, nave_enemiga);
+			accion->desX = nave->posx + nave_seguirX(nave, nave_enemiga);
+		} else {
+			accion->desY = nave->posy;
+			accion->desX = nave->posx;
+		}
+	}
+
+	/* Realiza un movimiento aleatorio */
+	acciones[1] = acciones[0];
+	accion = &acciones[1];
+	strcpy(accion->tipo, "ACCION MOVER");
+	aleatY = nave_moverAleatorioY(acciones[0].desY);
+	aleatX = nave_moverAleatorioX(acciones[0].desX);
+	if(mapa_vista_vacia(vista, aleatY, aleatX) == true) {
+		accion->desY = aleatY;
+		accion->desX = aleatX;
+	}
+
+	return NAVE_MAX_ACCIONES;
+}
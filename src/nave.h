@@ -3,26 +3,37 @@
 
 #include <stdbool.h>
 
+#define NAVE_MAX_ACCIONES 2 // Acciones que decide una nave con cada orden del jefe
+
 /* rutina de tratamiento de la señal SIGTERM */
 void manejador_SIGTERM(int sig);
 
 /*inicializa los parámetros de la estructura sigaction para enlazarlo con el manejador_SIGTERM */
 int manejador_SIGTERM_create(struct sigaction act);
 
-/* Crea la estructura tipo_Nave otorgandole cierta posición en el mapa */
-tipo_nave *nave_create(int numEquipo, int numNave);
+/* Crea la estructura tipo_Nave en la posición y,x del mapa */
+tipo_nave nave_create(int numEquipo, int numNave, int posy, int posx);
 
 /* Controla las acciones que realiza la nave */
 void nave_update(tipo_nave *nave);
 
-/* Comprueba si es posible que la nave en cuestión realice una acción de ataque */
-tipo_nave nave_atacar(tipo_mapa *mapa, tipo_nave *nave, int i);
+/* Busca en la vista una nave enemiga al alcance de la nave. Retorna NULL si no hay ninguna */
+const tipo_nave *nave_atacar(const tipo_vista *vista, const tipo_nave *nave, int i);
+
+/* Rastrea en la vista la nave enemiga más cercana para moverse hacia ella. Retorna NULL si no queda ninguna */
+const tipo_nave *nave_rastrear(const tipo_vista *vista, const tipo_nave *nave, int i);
+
+int nave_seguirX(const tipo_nave *nave, const tipo_nave *nave_enemiga);
+
+int nave_seguirY(const tipo_nave *nave, const tipo_nave *nave_enemiga);
 
-/* Rastrea la nave más cercana para moverse hacia ella */
-tipo_nave nave_rastrear(tipo_mapa *mapa, tipo_nave *nave, int i);
+/* Genera la coordenada 'y' de un movimiento aleatorio alrededor de posY */
+int nave_moverAleatorioY(int posY);
 
-int nave_seguirX(tipo_nave *nave, tipo_nave nave_enemiga);
+/* Genera la coordenada 'x' de un movimiento aleatorio alrededor de posX */
+int nave_moverAleatorioX(int posX);
 
-int nave_seguirY(tipo_nave *nave, tipo_nave nave_enemiga);
+/* Decide las acciones de la nave ante la orden ACCION ATAQUE sobre la vista del turno. Retorna el número de acciones */
+int nave_decidir(const tipo_vista *vista, int equipo, int numNave, tipo_accion *acciones);
 
 #endif /* SRC_NAVE_H_ */
\ No newline at end of file
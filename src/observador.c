@@ -0,0 +1,387 @@
+/**
+ *
+ * Descripcion: biblioteca para observar una partida en marcha sin formar
+ *		parte de ella. Lee la cabecera del segmento del mapa para saber
+ *		dónde está cada campo, de modo que no hace falta compilar con las
+ *		mismas constantes que el simulador. Las instantáneas se copian de la
+ *		vista que el simulador publica al empezar cada turno (un seqlock),
+ *		así que siempre son de un único turno.
+ *
+ * Fichero: observador.c
+ * Autor: Miguel González Bustamante, miguel.gonzalezb@estudiante.uam.es
+ * Grupo: 2261
+ * Fecha: 08-05-2019
+ *
+ */
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <simulador.h>
+#include <observador.h>
+
+/* De simulador.h solo se usan la cabecera y tipo_nave, tipo_estadisticas, que
+ * no dependen de las constantes de compilación; los tamaños salen de la cabecera */
+
+#define OBS_SONDEO_MS 10 // Sin el segmento de avisos nadie despierta al observador: mira cada tanto
+
+struct tipo_observador {
+	char *segmento;
+	size_t tamano;
+	uint32_t *esperando; // Contador del segmento de avisos, NULL si no se ha podido abrir
+	tipo_mapa_cabecera cab; // Copia de la cabecera ya validada
+	tipo_nave *naves; // Copia de las naves de la vista antes de convertirlas
+};
+
+/****************************************************************************/
+/* Funcion: observador_avisos                                               */
+/*                                                                          */
+/* Descripcion: mapea con escritura el segmento de avisos del mapa (el      */
+/*		nombre del mapa seguido de "_avisos"), en el que se apuntan los     */
+/*		procesos que esperan un cambio para que el simulador los despierte. */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		const char *nombre: segmento del mapa                               */
+/* Parametros de salida: contador de procesos en espera, o NULL si no hay   */
+/*		segmento de avisos o no se puede escribir en él.                    */
+/****************************************************************************/
+static uint32_t *observador_avisos(const char *nombre) {
+	char avisos[256];
+	struct stat st;
+	uint32_t *esperando;
+	int fd;
+
+	if(snprintf(avisos, sizeof(avisos), "%s_avisos", nombre) >= (int)sizeof(avisos))
+		return NULL;
+	fd = shm_open(avisos, O_RDWR, 0);
+	if(fd == -1)
+		return NULL;
+	if(fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(*esperando)) {
+		close(fd);
+		return NULL;
+	}
+	esperando = mmap(NULL, sizeof(*esperando), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	return (esperando == MAP_FAILED) ? NULL : esperando;
+}
+
+/****************************************************************************/
+/* Funcion: observador_abrir                                                */
+/*                                                                          */
+/* Descripcion: mapea en solo lectura el segmento del mapa y comprueba su   */
+/*		cabecera. Para esperar cambios sin sondear se apunta en el segmento */
+/*		de avisos, que va aparte para no tener que escribir en el mapa.     */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		const char *nombre: segmento, o NULL para SHM_MAP_NAME              */
+/* Parametros de salida: observador, o NULL con errno ENOENT, EAGAIN o      */
+/*		EPROTO (formato de otra versión).                                   */
+/****************************************************************************/
+tipo_observador *observador_abrir(const char *nombre) {
+	tipo_observador *obs;
+	tipo_mapa_cabecera *cab;
+	struct stat st;
+	int fd, error;
+
+	if(nombre == NULL) nombre = SHM_MAP_NAME;
+	obs = calloc(1, sizeof(*obs));
+	if(obs == NULL)
+		return NULL;
+
+	fd = shm_open(nombre, O_RDONLY, 0);
+	if(fd == -1) {
+		free(obs);
+		return NULL;
+	}
+	if(fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(tipo_mapa_cabecera)) {
+		close(fd);
+		free(obs);
+		errno = EAGAIN;
+		return NULL;
+	}
+
+	obs->tamano = st.st_size;
+	obs->segmento = mmap(NULL, obs->tamano, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(obs->segmento == MAP_FAILED) {
+		free(obs);
+		return NULL;
+	}
+
+	/* La magia se escribe la última: sin ella la cabecera aún no está completa */
+	cab = (tipo_mapa_cabecera *)obs->segmento;
+	error = 0;
+	if(memcmp(cab->magia, MAPA_MAGIA, sizeof(cab->magia)) != 0) {
+		error = EAGAIN;
+	} else {
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		obs->cab = *cab;
+		if(obs->cab.version != MAPA_VERSION || obs->cab.tamano != obs->tamano
+			|| obs->cab.tam_nave != sizeof(tipo_nave) || obs->cab.tam_estadisticas != sizeof(tipo_estadisticas)
+			|| obs->cab.num_equipos < 1 || obs->cab.num_naves < 1 || obs->cab.maxy < 1 || obs->cab.maxx < 1
+			|| obs->cab.off_vistas + 2 * obs->cab.tam_vista > obs->tamano)
+			error = EPROTO;
+	}
+	if(error == 0) {
+		obs->naves = malloc((size_t)obs->cab.num_equipos * obs->cab.num_naves * sizeof(tipo_nave));
+		if(obs->naves == NULL)
+			error = ENOMEM;
+	}
+	if(error != 0) {
+		observador_cerrar(obs);
+		errno = error;
+		return NULL;
+	}
+	obs->esperando = observador_avisos(nombre);
+	return obs;
+}
+
+void observador_cerrar(tipo_observador *obs) {
+	if(obs == NULL) return;
+	munmap(obs->segmento, obs->tamano);
+	if(obs->esperando != NULL)
+		munmap(obs->esperando, sizeof(*obs->esperando));
+	free(obs->naves);
+	free(obs);
+}
+
+void observador_dimensiones(tipo_observador *obs, int *equipos, int *naves, int *filas, int *columnas) {
+	if(equipos != NULL) *equipos = obs->cab.num_equipos;
+	if(naves != NULL) *naves = obs->cab.num_naves;
+	if(filas != NULL) *filas = obs->cab.maxy;
+	if(columnas != NULL) *columnas = obs->cab.maxx;
+}
+
+char observador_simbolo(tipo_observador *obs, int equipo) {
+	if(equipo < 0 || equipo >= obs->cab.num_equipos || equipo >= MAPA_SIMBOLOS_MAX)
+		return '?';
+	return obs->cab.simbolos[equipo];
+}
+
+void *observador_segmento(tipo_observador *obs, size_t tamano) {
+	return (tamano == obs->cab.tamano) ? obs->segmento : NULL;
+}
+
+uint32_t observador_generacion(tipo_observador *obs) {
+	return __atomic_load_n((uint32_t *)(obs->segmento + obs->cab.off_generacion), __ATOMIC_ACQUIRE);
+}
+
+int observador_turno(tipo_observador *obs) {
+	return __atomic_load_n((int *)(obs->segmento + obs->cab.off_turno), __ATOMIC_ACQUIRE);
+}
+
+/****************************************************************************/
+/* Funcion: observador_esperar                                              */
+/*                                                                          */
+/* Descripcion: se apunta en el segmento de avisos y duerme en el futex del  */
+/*		contador de cambios (basta con leerlo). Sin segmento de avisos el   */
+/*		simulador no lo despierta, así que duerme a intervalos de           */
+/*		OBS_SONDEO_MS.                                                      */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		tipo_observador *obs: observador                                    */
+/*		uint32_t generacion: contador de cambios ya visto                   */
+/*		int espera_ms: espera máxima                                        */
+/* Parametros de salida: true si el contador ha cambiado.                   */
+/****************************************************************************/
+bool observador_esperar(tipo_observador *obs, uint32_t generacion, int espera_ms) {
+	uint32_t *contador = (uint32_t *)(obs->segmento + obs->cab.off_generacion);
+	struct timespec espera;
+	int tramo;
+
+	if(obs->esperando != NULL) {
+		espera.tv_sec = espera_ms / 1000;
+		espera.tv_nsec = (espera_ms % 1000) * 1000000L;
+		/* El futex solo duerme si la generación sigue siendo la vista, así que un
+		 * cambio entre la comprobación y la espera no se pierde */
+		__atomic_add_fetch(obs->esperando, 1, __ATOMIC_SEQ_CST);
+		if(observador_generacion(obs) == generacion)
+			syscall(SYS_futex, contador, FUTEX_WAIT, generacion, &espera, NULL, 0);
+		__atomic_sub_fetch(obs->esperando, 1, __ATOMIC_SEQ_CST);
+		return observador_generacion(obs) != generacion;
+	}
+
+	while(espera_ms > 0 && observador_generacion(obs) == generacion) {
+		tramo = (espera_ms < OBS_SONDEO_MS) ? espera_ms : OBS_SONDEO_MS;
+		espera.tv_sec = 0;
+		espera.tv_nsec = tramo * 1000000L;
+		nanosleep(&espera, NULL);
+		espera_ms -= tramo;
+	}
+	return observador_generacion(obs) != generacion;
+}
+
+tipo_obs_instantanea *observador_instantanea_crear(tipo_observador *obs) {
+	tipo_obs_instantanea *inst = calloc(1, sizeof(*inst));
+
+	if(inst == NULL)
+		return NULL;
+	inst->turno = -1;
+	inst->num_equipos = obs->cab.num_equipos;
+	inst->num_naves = obs->cab.num_naves;
+	inst->filas = obs->cab.maxy;
+	inst->columnas = obs->cab.maxx;
+	inst->naves = calloc((size_t)inst->num_equipos * inst->num_naves, sizeof(tipo_obs_nave));
+	inst->indices = malloc((size_t)inst->filas * inst->columnas * sizeof(int));
+	inst->estadisticas = calloc(inst->num_equipos, sizeof(tipo_obs_estadisticas));
+	if(inst->naves == NULL || inst->indices == NULL || inst->estadisticas == NULL) {
+		observador_instantanea_liberar(inst);
+		return NULL;
+	}
+	memset(inst->indices, -1, (size_t)inst->filas * inst->columnas * sizeof(int));
+	return inst;
+}
+
+void observador_instantanea_liberar(tipo_obs_instantanea *inst) {
+	if(inst == NULL) return;
+	free(inst->naves);
+	free(inst->indices);
+	free(inst->estadisticas);
+	free(inst);
+}
+
+/****************************************************************************/
+/* Funcion: observador_capturar                                             */
+/*                                                                          */
+/* Descripcion: copia la vista publicada por el simulador. Como las naves,  */
+/*		si la secuencia de la vista ha cambiado durante la copia (el        */
+/*		simulador estaba publicando otra encima) se vuelve a copiar.        */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		tipo_observador *obs: observador                                    */
+/*		tipo_obs_instantanea *inst: instantánea de observador_instantanea_crear */
+/* Parametros de salida: 0, o -1 si aún no hay ninguna vista publicada.     */
+/****************************************************************************/
+int observador_capturar(tipo_observador *obs, tipo_obs_instantanea *inst) {
+	tipo_mapa_cabecera *cab = &obs->cab;
+	size_t num = (size_t)cab->num_equipos * cab->num_naves;
+	tipo_estadisticas est;
+	uint32_t secuencia, actual;
+	char *vista;
+	int k;
+
+	do {
+		actual = __atomic_load_n((uint32_t *)(obs->segmento + cab->off_vista_actual), __ATOMIC_ACQUIRE);
+		vista = obs->segmento + cab->off_vistas + (actual & 1) * cab->tam_vista;
+		secuencia = __atomic_load_n((uint32_t *)(vista + cab->off_vista_secuencia), __ATOMIC_ACQUIRE);
+		if(secuencia == 0)
+			return -1;
+		if(secuencia & 1)
+			continue;
+
+		memcpy(&inst->turno, vista + cab->off_vista_turno, sizeof(int));
+		memcpy(&inst->equipos_vivos, vista + cab->off_vista_equipos_vivos, sizeof(int));
+		memcpy(obs->naves, vista + cab->off_vista_naves, num * sizeof(tipo_nave));
+		memcpy(inst->indices, vista + cab->off_vista_indices, (size_t)cab->maxy * cab->maxx * sizeof(int));
+		for(k = 0; k < cab->num_equipos; k++) {
+			memcpy(&est, vista + cab->off_vista_estadisticas + k * sizeof(tipo_estadisticas), sizeof(est));
+			inst->estadisticas[k].naves_vivas = est.naves_vivas;
+			inst->estadisticas[k].vida_total = est.vida_total;
+			inst->estadisticas[k].bajas = est.bajas;
+			inst->estadisticas[k].dano_causado = est.dano_causado;
+		}
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	} while(__atomic_load_n((uint32_t *)(vista + cab->off_vista_secuencia), __ATOMIC_RELAXED) != secuencia || (secuencia & 1));
+
+	for(k = 0; k < (int)num; k++) {
+		inst->naves[k].equipo = k / cab->num_naves;
+		inst->naves[k].numero = k % cab->num_naves;
+		inst->naves[k].vida = obs->naves[k].vida;
+		inst->naves[k].posy = obs->naves[k].posy;
+		inst->naves[k].posx = obs->naves[k].posx;
+		inst->naves[k].viva = obs->naves[k].viva;
+	}
+	return 0;
+}
+
+const tipo_obs_nave *observador_nave(const tipo_obs_instantanea *inst, int equipo, int numero) {
+	if(equipo < 0 || equipo >= inst->num_equipos || numero < 0 || numero >= inst->num_naves)
+		return NULL;
+	return &inst->naves[equipo * inst->num_naves + numero];
+}
+
+const tipo_obs_nave *observador_casilla(const tipo_obs_instantanea *inst, int posy, int posx) {
+	int k;
+
+	if(posy < 0 || posy >= inst->filas || posx < 0 || posx >= inst->columnas)
+		return NULL;
+	k = inst->indices[posy * inst->columnas + posx];
+	return (k < 0) ? NULL : &inst->naves[k];
+}
+
+const tipo_obs_nave *observador_siguiente_viva(const tipo_obs_instantanea *inst, int *k) {
+	int total = inst->num_equipos * inst->num_naves;
+
+	while(*k < total) {
+		if(inst->naves[(*k)++].viva)
+			return &inst->naves[*k - 1];
+	}
+	return NULL;
+}
+
+/****************************************************************************/
+/* Funcion: observador_agregados                                            */
+/*                                                                          */
+/* Descripcion: resume en una pasada las naves vivas de un equipo: número,  */
+/*		vida, posición media y rectángulo que las contiene.                 */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		const tipo_obs_instantanea *inst: instantánea                       */
+/*		int equipo: equipo, o -1 para todas las naves                       */
+/*		tipo_obs_agregados *agregados: donde se deja el resumen             */
+/* Parametros de salida: void                                               */
+/****************************************************************************/
+void observador_agregados(const tipo_obs_instantanea *inst, int equipo, tipo_obs_agregados *agregados) {
+	const tipo_obs_nave *nave;
+	double sumay = 0, sumax = 0;
+	int k = 0;
+
+	memset(agregados, 0, sizeof(*agregados));
+	agregados->miny = agregados->minx = agregados->maxy = agregados->maxx = -1;
+	while((nave = observador_siguiente_viva(inst, &k)) != NULL) {
+		if(equipo >= 0 && nave->equipo != equipo)
+			continue;
+		if(agregados->naves_vivas == 0) {
+			agregados->miny = agregados->maxy = nave->posy;
+			agregados->minx = agregados->maxx = nave->posx;
+		}
+		agregados->naves_vivas++;
+		agregados->vida_total += nave->vida;
+		sumay += nave->posy;
+		sumax += nave->posx;
+		if(nave->posy < agregados->miny) agregados->miny = nave->posy;
+		if(nave->posy > agregados->maxy) agregados->maxy = nave->posy;
+		if(nave->posx < agregados->minx) agregados->minx = nave->posx;
+		if(nave->posx > agregados->maxx) agregados->maxx = nave->posx;
+	}
+	if(agregados->naves_vivas > 0) {
+		agregados->vida_media = (double)agregados->vida_total / agregados->naves_vivas;
+		agregados->centroy = sumay / agregados->naves_vivas;
+		agregados->centrox = sumax / agregados->naves_vivas;
+	}
+}
+
+int observador_contar(const tipo_obs_instantanea *inst, int equipo, int y0, int x0, int y1, int x1) {
+	int y, x, k, num = 0;
+
+	y0 = (y0 < 0) ? 0 : y0;
+	x0 = (x0 < 0) ? 0 : x0;
+	y1 = (y1 >= inst->filas) ? inst->filas - 1 : y1;
+	x1 = (x1 >= inst->columnas) ? inst->columnas - 1 : x1;
+	for(y = y0; y <= y1; y++) {
+		for(x = x0; x <= x1; x++) {
+			k = inst->indices[y * inst->columnas + x];
+			if(k >= 0 && (equipo < 0 || inst->naves[k].equipo == equipo))
+				num++;
+		}
+	}
+	return num;
+}
@@ -0,0 +1,108 @@
+#ifndef SRC_OBSERVADOR_H_
+#define SRC_OBSERVADOR_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Biblioteca de solo lectura (libmapa_observer.a) para seguir una partida en
+ * marcha. No depende de N_EQUIPOS, N_NAVES ni del tamaño del mapa: los lee de
+ * la cabecera del segmento, así que sirve con cualquier compilación del
+ * simulador de la misma versión (MAPA_VERSION) */
+
+typedef struct tipo_observador tipo_observador;
+
+// Una nave en una instantánea
+typedef struct {
+	int equipo;
+	int numero; // Número de la nave en el equipo
+	int vida;
+	int posy;
+	int posx;
+	bool viva;
+} tipo_obs_nave;
+
+// Estadísticas de un equipo en una instantánea
+typedef struct {
+	int naves_vivas;
+	int vida_total;
+	int bajas; // Naves enemigas destruidas por el equipo
+	int dano_causado;
+} tipo_obs_estadisticas;
+
+// Estado del mapa al empezar un turno, siempre coherente (todo del mismo turno)
+typedef struct {
+	int turno;
+	int num_equipos, num_naves, filas, columnas;
+	int equipos_vivos;
+	tipo_obs_nave *naves; // La nave n del equipo e en e * num_naves + n
+	int *indices; // filas * columnas: posición en 'naves' de la nave de cada casilla, -1 si está vacía
+	tipo_obs_estadisticas *estadisticas; // Una por equipo
+} tipo_obs_instantanea;
+
+// Resumen de las naves vivas de un equipo (o de todos) en una instantánea
+typedef struct {
+	int naves_vivas;
+	int vida_total;
+	double vida_media;
+	double centroy, centrox; // Posición media de las naves vivas
+	int miny, minx, maxy, maxx; // Rectángulo que las contiene, -1 si no hay ninguna
+} tipo_obs_agregados;
+
+/* Se conecta al mapa del simulador (NULL para el de siempre, "/shm_naves") en solo
+ * lectura. Retorna NULL si no hay simulador (errno ENOENT), si todavía está
+ * arrancando (EAGAIN) o si el formato no es el de esta versión (EPROTO) */
+tipo_observador *observador_abrir(const char *nombre);
+
+/* Se desconecta del mapa */
+void observador_cerrar(tipo_observador *obs);
+
+/* Obtiene el número de equipos, de naves por equipo y el tamaño del mapa */
+void observador_dimensiones(tipo_observador *obs, int *equipos, int *naves, int *filas, int *columnas);
+
+/* Obtiene el símbolo con el que se dibuja un equipo */
+char observador_simbolo(tipo_observador *obs, int equipo);
+
+/* Obtiene el segmento entero para las herramientas del propio simulador compiladas con las
+ * mismas constantes. Retorna NULL si 'tamano' no es el del tipo_mapa del simulador */
+void *observador_segmento(tipo_observador *obs, size_t tamano);
+
+/* Obtiene el contador de cambios del mapa, que crece con cada cambio visible */
+uint32_t observador_generacion(tipo_observador *obs);
+
+/* Obtiene el turno en curso */
+int observador_turno(tipo_observador *obs);
+
+/* Espera hasta espera_ms a que el contador de cambios deje de ser 'generacion'.
+ * Retorna true si ha cambiado */
+bool observador_esperar(tipo_observador *obs, uint32_t generacion, int espera_ms);
+
+/* Reserva una instantánea con el tamaño del mapa observado */
+tipo_obs_instantanea *observador_instantanea_crear(tipo_observador *obs);
+
+/* Libera una instantánea */
+void observador_instantanea_liberar(tipo_obs_instantanea *inst);
+
+/* Copia en la instantánea el último turno publicado. Retorna -1 si el simulador
+ * todavía no ha publicado ninguno */
+int observador_capturar(tipo_observador *obs, tipo_obs_instantanea *inst);
+
+/* Obtiene la nave 'numero' del equipo */
+const tipo_obs_nave *observador_nave(const tipo_obs_instantanea *inst, int equipo, int numero);
+
+/* Obtiene la nave de la casilla y,x o NULL si está vacía */
+const tipo_obs_nave *observador_casilla(const tipo_obs_instantanea *inst, int posy, int posx);
+
+/* Recorre las naves vivas: devuelve la primera a partir de *k y deja *k en la
+ * siguiente posición. Retorna NULL al terminar. Uso:
+ *     int k = 0;
+ *     while((nave = observador_siguiente_viva(inst, &k)) != NULL) ... */
+const tipo_obs_nave *observador_siguiente_viva(const tipo_obs_instantanea *inst, int *k);
+
+/* Calcula el resumen de las naves vivas del equipo, o de todos con equipo -1 */
+void observador_agregados(const tipo_obs_instantanea *inst, int equipo, tipo_obs_agregados *agregados);
+
+/* Cuenta las naves vivas del equipo (o de todos con -1) entre las filas y0-y1 y las columnas x0-x1 */
+int observador_contar(const tipo_obs_instantanea *inst, int equipo, int y0, int x0, int y1, int x1);
+
+#endif /* SRC_OBSERVADOR_H_ */
@@ -0,0 +1,199 @@
+/**
+ *
+ * Descripcion: planificador de acciones delante de simulador_update. Cada equipo
+ *		tiene dos subcolas (ataques y movimientos), cada nave tiene un cupo de
+ *		acciones por turno y los equipos se atienden con deficit round robin
+ *		sobre la lista de equipos con acciones pendientes, de modo que el coste
+ *		por acción no depende del número de equipos. Las métricas de espera y
+ *		reparto se publican en el mapa compartido.
+ *
+ * Fichero: planificador.c
+ * Autor: Miguel González Bustamante, miguel.gonzalezb@estudiante.uam.es
+ * Grupo: 2261
+ * Fecha: 08-05-2019
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <planificador.h>
+
+#define N_IDS (N_EQUIPOS * N_NAVES) // Número total de naves
+#define PLAN_CAPACIDAD (N_NAVES * ACCIONES_MAX_TURNO) // Acciones que caben en cada subcola
+
+#define SUBCOLA_ATAQUES 0
+#define SUBCOLA_MOVIMIENTOS 1
+
+/* Cola circular de acciones de un equipo */
+typedef struct {
+	tipo_accion acciones[PLAN_CAPACIDAD];
+	int primera;
+	int num;
+} tipo_subcola;
+
+static tipo_subcola subcolas[N_EQUIPOS][2];
+static int pendientes_equipo[N_EQUIPOS];
+static int pendientes = 0;
+
+/* Lista circular de equipos con acciones pendientes */
+static int activos[N_EQUIPOS];
+static int primero_activo = 0;
+static int num_activos = 0;
+static int deficit[N_EQUIPOS];
+static bool nueva_visita = true; // El equipo en cabeza aún no ha recibido su quantum
+
+/* Cupo de acciones por nave y turno */
+static int turno_nave[N_IDS];
+static int acciones_nave[N_IDS];
+
+static int quantum = PLAN_QUANTUM;
+static bool ataques_primero = true;
+
+/****************************************************************************/
+/* Funcion: planificador_config                                             */
+/*                                                                          */
+/* Descripcion: fija los parámetros del reparto.                            */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		int q: acciones por ronda de cada equipo                            */
+/*		bool ataques: si los ataques tienen prioridad sobre los movimientos */
+/* Parametros de salida: void                                               */
+/****************************************************************************/
+void planificador_config(int q, bool ataques) {
+	quantum = (q < 1) ? 1 : q;
+	ataques_primero = ataques;
+}
+
+/****************************************************************************/
+/* Funcion: planificador_pendientes                                         */
+/*                                                                          */
+/* Descripcion: obtiene el número de acciones pendientes de despachar.      */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/* Parametros de salida: número de acciones pendientes.                     */
+/****************************************************************************/
+int planificador_pendientes() {
+	return pendientes;
+}
+
+/****************************************************************************/
+/* Funcion: planificador_ns                                                 */
+/*                                                                          */
+/* Descripcion: lee CLOCK_MONOTONIC en nanosegundos.                        */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/* Parametros de salida: nanosegundos.                                      */
+/****************************************************************************/
+static uint64_t planificador_ns() {
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t)t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+/****************************************************************************/
+/* Funcion: planificador_encolar                                            */
+/*                                                                          */
+/* Descripcion: guarda una acción en la subcola de su equipo si la nave no  */
+/*		ha agotado su cupo del turno.                                       */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		tipo_mapa *mapa: estructura del mapa, donde se publican métricas    */
+/*		tipo_accion *accion: acción recibida                                */
+/*		int turno: turno en curso                                           */
+/* Parametros de salida: retorna 1 si se acepta o 0 si se descarta.         */
+/****************************************************************************/
+int planificador_encolar(tipo_mapa *mapa, tipo_accion *accion, int turno) {
+	tipo_subcola *sub;
+	int equipo = accion->equipo, id;
+
+	if(equipo < 0 || equipo >= N_EQUIPOS || accion->nave < 0 || accion->nave >= N_NAVES)
+		return 0;
+
+	id = equipo * N_NAVES + accion->nave;
+	if(turno_nave[id] != turno) {
+		turno_nave[id] = turno;
+		acciones_nave[id] = 0;
+	}
+
+	sub = &subcolas[equipo][(ataques_primero && strcmp(accion->tipo, "ACCION ATAQUE") == 0) ? SUBCOLA_ATAQUES : SUBCOLA_MOVIMIENTOS];
+	if(acciones_nave[id] >= ACCIONES_MAX_TURNO || sub->num == PLAN_CAPACIDAD) {
+		mapa->planificacion[equipo].descartadas++;
+		return 0;
+	}
+
+	if(accion->t_envio == 0)
+		accion->t_envio = planificador_ns();
+
+	sub->acciones[(sub->primera + sub->num) % PLAN_CAPACIDAD] = *accion;
+	sub->num++;
+	acciones_nave[id]++;
+	mapa->planificacion[equipo].encoladas++;
+
+	/* El equipo entra en la ronda al tener su primera acción pendiente */
+	if(pendientes_equipo[equipo]++ == 0) {
+		activos[(primero_activo + num_activos) % N_EQUIPOS] = equipo;
+		if(num_activos++ == 0)
+			nueva_visita = true;
+	}
+	pendientes++;
+	return 1;
+}
+
+/****************************************************************************/
+/* Funcion: planificador_despachar                                          */
+/*                                                                          */
+/* Descripcion: saca la siguiente acción. El equipo en cabeza recibe        */
+/*		'quantum' de crédito al empezar su visita y se atiende mientras le  */
+/*		quede crédito y acciones; después pasa al final de la lista.        */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		tipo_mapa *mapa: estructura del mapa, donde se publican métricas    */
+/*		tipo_accion *accion: destino de la acción                           */
+/* Parametros de salida: retorna 1 si hay acción o 0 si no hay pendientes.  */
+/****************************************************************************/
+int planificador_despachar(tipo_mapa *mapa, tipo_accion *accion) {
+	tipo_planificacion *met;
+	tipo_subcola *sub;
+	uint64_t espera;
+	int equipo;
+
+	if(pendientes == 0)
+		return 0;
+
+	equipo = activos[primero_activo];
+	if(nueva_visita) {
+		deficit[equipo] += quantum;
+		nueva_visita = false;
+	}
+
+	sub = (subcolas[equipo][SUBCOLA_ATAQUES].num > 0) ? &subcolas[equipo][SUBCOLA_ATAQUES] : &subcolas[equipo][SUBCOLA_MOVIMIENTOS];
+	*accion = sub->acciones[sub->primera];
+	sub->primera = (sub->primera + 1) % PLAN_CAPACIDAD;
+	sub->num--;
+	pendientes--;
+	deficit[equipo]--;
+
+	/* Métricas del equipo */
+	met = &mapa->planificacion[equipo];
+	espera = (planificador_ns() - accion->t_envio) / 1000;
+	met->despachadas++;
+	met->espera_total_us += espera;
+	if(espera > met->espera_max_us)
+		met->espera_max_us = espera;
+
+	if(--pendientes_equipo[equipo] == 0) {
+		/* Sin acciones sale de la ronda y pierde el crédito */
+		deficit[equipo] = 0;
+		primero_activo = (primero_activo + 1) % N_EQUIPOS;
+		num_activos--;
+		nueva_visita = true;
+	} else if(deficit[equipo] <= 0) {
+		/* Crédito agotado: pasa al final de la lista */
+		primero_activo = (primero_activo + 1) % N_EQUIPOS;
+		activos[(primero_activo + num_activos - 1) % N_EQUIPOS] = equipo;
+		nueva_visita = true;
+	}
+	return 1;
+}
@@ -0,0 +1,22 @@
+#ifndef SRC_PLANIFICADOR_H_
+#define SRC_PLANIFICADOR_H_
+
+#include <simulador.h>
+#include <stdbool.h>
+
+/* Configura el planificador: acciones por ronda para cada equipo y si los ataques
+ * de un equipo pasan por delante de sus movimientos */
+void planificador_config(int quantum, bool ataques_primero);
+
+/* Guarda una acción recibida en la subcola de su equipo. Retorna 0 si se descarta
+ * por superar el cupo de acciones de la nave en este turno o por subcola llena */
+int planificador_encolar(tipo_mapa *mapa, tipo_accion *accion, int turno);
+
+/* Saca la siguiente acción a aplicar con reparto deficit round robin entre equipos.
+ * Retorna 0 si no hay acciones pendientes */
+int planificador_despachar(tipo_mapa *mapa, tipo_accion *accion);
+
+/* Obtiene el número de acciones pendientes entre todos los equipos */
+int planificador_pendientes();
+
+#endif /* SRC_PLANIFICADOR_H_ */
@@ -0,0 +1,247 @@
+/**
+ *
+ * Descripcion: funciones comunes del protocolo entre el simulador en modo
+ *		servidor y los clientes 'equipo': creación de sockets Unix o TCP a
+ *		partir de una dirección y envío y recepción de mensajes completos.
+ *
+ * Fichero: protocolo.c
+ * Autor: Miguel González Bustamante, miguel.gonzalezb@estudiante.uam.es
+ * Grupo: 2261
+ * Fecha: 08-05-2019
+ *
+ */
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <protocolo.h>
+
+/****************************************************************************/
+/* Funcion: proto_direccion                                                 */
+/*                                                                          */
+/* Descripcion: resuelve una dirección: ruta de socket Unix si contiene '/' */
+/*		o [host:]puerto TCP, por defecto en la interfaz de loopback.        */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		const char *direccion: dirección a resolver                         */
+/*		struct sockaddr_storage *sa: donde se deja la dirección             */
+/*		socklen_t *tam: tamaño de la dirección                              */
+/* Parametros de salida: familia (AF_UNIX o AF_INET/AF_INET6) o -1.         */
+/****************************************************************************/
+static int proto_direccion(const char *direccion, struct sockaddr_storage *sa, socklen_t *tam) {
+	struct sockaddr_un *un = (struct sockaddr_un *)sa;
+	struct addrinfo pistas, *res;
+	char host[256];
+	const char *puerto = strrchr(direccion, ':');
+
+	memset(sa, 0, sizeof(*sa));
+	if(strchr(direccion, '/') != NULL) {
+		if(strlen(direccion) >= sizeof(un->sun_path))
+			return -1;
+		un->sun_family = AF_UNIX;
+		strcpy(un->sun_path, direccion);
+		*tam = sizeof(*un);
+		return AF_UNIX;
+	}
+
+	strcpy(host, "127.0.0.1");
+	if(puerto == NULL) {
+		puerto = direccion;
+	} else {
+		if(puerto - direccion >= (long)sizeof(host))
+			return -1;
+		if(puerto > direccion) {
+			memcpy(host, direccion, puerto - direccion);
+			host[puerto - direccion] = '\0';
+		}
+		puerto++;
+	}
+
+	memset(&pistas, 0, sizeof(pistas));
+	pistas.ai_family = AF_UNSPEC;
+	pistas.ai_socktype = SOCK_STREAM;
+	if(getaddrinfo(host, puerto, &pistas, &res) != 0)
+		return -1;
+	memcpy(sa, res->ai_addr, res->ai_addrlen);
+	*tam = res->ai_addrlen;
+	freeaddrinfo(res);
+	return sa->ss_family;
+}
+
+/****************************************************************************/
+/* Funcion: proto_escuchar                                                  */
+/*                                                                          */
+/* Descripcion: crea el socket de escucha del servidor.                     */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		const char *direccion: ruta Unix o [host:]puerto TCP                */
+/* Parametros de salida: descriptor del socket o -1.                        */
+/****************************************************************************/
+int proto_escuchar(const char *direccion) {
+	struct sockaddr_storage sa;
+	socklen_t tam;
+	int fd, familia, si = 1;
+
+	familia = proto_direccion(direccion, &sa, &tam);
+	if(familia < 0)
+		return -1;
+	fd = socket(familia, SOCK_STREAM, 0);
+	if(fd == -1)
+		return -1;
+
+	if(familia == AF_UNIX)
+		unlink(direccion);
+	else
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &si, sizeof(si));
+
+	if(bind(fd, (struct sockaddr *)&sa, tam) == -1 || listen(fd, 16) == -1) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/****************************************************************************/
+/* Funcion: proto_conectar                                                  */
+/*                                                                          */
+/* Descripcion: conecta con el servidor. En TCP desactiva el algoritmo de   */
+/*		Nagle, porque cada mensaje se envía de una vez y espera respuesta.  */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		const char *direccion: ruta Unix o [host:]puerto TCP                */
+/* Parametros de salida: descriptor del socket o -1.                        */
+/****************************************************************************/
+int proto_conectar(const char *direccion) {
+	struct sockaddr_storage sa;
+	socklen_t tam;
+	int fd, familia, si = 1;
+
+	familia = proto_direccion(direccion, &sa, &tam);
+	if(familia < 0)
+		return -1;
+	fd = socket(familia, SOCK_STREAM, 0);
+	if(fd == -1)
+		return -1;
+	if(connect(fd, (struct sockaddr *)&sa, tam) == -1) {
+		close(fd);
+		return -1;
+	}
+	if(familia != AF_UNIX)
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &si, sizeof(si));
+	return fd;
+}
+
+/****************************************************************************/
+/* Funcion: proto_borrar                                                    */
+/*                                                                          */
+/* Descripcion: borra la ruta de un socket Unix al cerrar el servidor.      */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		const char *direccion: dirección de escucha                         */
+/* Parametros de salida: void                                               */
+/****************************************************************************/
+void proto_borrar(const char *direccion) {
+	if(strchr(direccion, '/') != NULL)
+		unlink(direccion);
+}
+
+/****************************************************************************/
+/* Funcion: proto_enviar                                                    */
+/*                                                                          */
+/* Descripcion: envía la cabecera y los datos de un mensaje en una sola     */
+/*		llamada siempre que quepan, repitiendo si la escritura es parcial.  */
+/*		Si el socket tiene plazo de envío (SO_SNDTIMEO) y vence, falla.     */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		int fd: conexión                                                    */
+/*		int tipo: tipo de mensaje (PROTO_*)                                   */
+/*		const void *datos, size_t longitud: contenido ya en orden de red    */
+/* Parametros de salida: 0 si se ha enviado o -1 si no.                     */
+/****************************************************************************/
+int proto_enviar(int fd, int tipo, const void *datos, size_t longitud) {
+	tipo_msg_cabecera cab;
+	struct iovec partes[2];
+	struct msghdr msg;
+	ssize_t n;
+
+	cab.tipo = htons(tipo);
+	cab.version = htons(PROTO_VERSION);
+	cab.longitud = htonl(longitud);
+	partes[0].iov_base = &cab;
+	partes[0].iov_len = sizeof(cab);
+	partes[1].iov_base = (void *)datos;
+	partes[1].iov_len = longitud;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = partes;
+	msg.msg_iovlen = 2;
+
+	while(partes[0].iov_len + partes[1].iov_len > 0) {
+		n = sendmsg(fd, &msg, MSG_NOSIGNAL);
+		if(n < 0 && errno == EINTR)
+			continue;
+		if(n <= 0)
+			return -1;
+		for(int k = 0; k < 2; k++) {
+			size_t usado = ((size_t)n < partes[k].iov_len) ? (size_t)n : partes[k].iov_len;
+			partes[k].iov_base = (char *)partes[k].iov_base + usado;
+			partes[k].iov_len -= usado;
+			n -= usado;
+		}
+	}
+	return 0;
+}
+
+/****************************************************************************/
+/* Funcion: proto_leer                                                      */
+/*                                                                          */
+/* Descripcion: lee exactamente 'longitud' bytes.                           */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		int fd: conexión                                                    */
+/*		void *datos, size_t longitud: destino                               */
+/* Parametros de salida: 0 si se ha leído todo o -1 si se cierra antes.     */
+/****************************************************************************/
+static int proto_leer(int fd, void *datos, size_t longitud) {
+	ssize_t n;
+
+	while(longitud > 0) {
+		n = recv(fd, datos, longitud, 0);
+		if(n < 0 && errno == EINTR)
+			continue;
+		if(n <= 0)
+			return -1;
+		datos = (char *)datos + n;
+		longitud -= n;
+	}
+	return 0;
+}
+
+/****************************************************************************/
+/* Funcion: proto_recibir                                                   */
+/*                                                                          */
+/* Descripcion: recibe un mensaje completo, esperando si hace falta.        */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		int fd: conexión                                                    */
+/*		void *datos, size_t capacidad: destino del contenido                */
+/*		size_t *longitud: donde se deja la longitud del contenido           */
+/* Parametros de salida: tipo de mensaje o -1 si hay error.                 */
+/****************************************************************************/
+int proto_recibir(int fd, void *datos, size_t capacidad, size_t *longitud) {
+	tipo_msg_cabecera cab;
+
+	if(proto_leer(fd, &cab, sizeof(cab)) < 0 || ntohs(cab.version) != PROTO_VERSION)
+		return -1;
+	*longitud = ntohl(cab.longitud);
+	if(*longitud > capacidad || proto_leer(fd, datos, *longitud) < 0)
+		return -1;
+	return ntohs(cab.tipo);
+}
@@ -0,0 +1,75 @@
+#ifndef SRC_PROTOCOLO_H_
+#define SRC_PROTOCOLO_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Protocolo entre el simulador en modo servidor (-S) y los clientes 'equipo'. Cada
+ * mensaje es una cabecera seguida de 'longitud' bytes; todos los campos van en el
+ * orden de bytes de la red para poder repartir los equipos entre máquinas */
+#define PROTO_VERSION 1
+
+#define PROTO_HOLA 1 // Servidor -> equipo: equipo asignado y tamaños de la partida
+#define PROTO_TURNO 2 // Servidor -> equipo: nuevo turno con las naves que han cambiado
+#define PROTO_ACCIONES 3 // Equipo -> servidor: acciones de todas sus naves para un turno
+#define PROTO_FIN 4 // Servidor -> equipo: fin de la partida
+
+typedef struct {
+	uint16_t tipo;
+	uint16_t version;
+	uint32_t longitud; // Bytes que siguen a la cabecera
+} tipo_msg_cabecera;
+
+typedef struct {
+	int32_t equipo;
+	int32_t num_equipos, num_naves, maxy, maxx;
+	int32_t limite_ms; // Tiempo para responder a cada turno
+} tipo_msg_hola;
+
+/* Seguido de num_naves tipo_msg_nave. El primer turno lleva todas las naves */
+typedef struct {
+	int32_t turno;
+	int32_t num_naves;
+} tipo_msg_turno;
+
+typedef struct {
+	uint16_t indice; // equipo * num_naves + nave
+	int16_t posy, posx;
+	int16_t vida; // 0 si la nave está destruida
+} tipo_msg_nave;
+
+/* Seguido de num_acciones tipo_msg_accion */
+typedef struct {
+	int32_t turno;
+	int32_t num_acciones;
+} tipo_msg_acciones;
+
+typedef struct {
+	uint16_t nave; // Número de la nave dentro del equipo
+	uint16_t ataque; // 1 ataque, 0 movimiento
+	int16_t desY, desX;
+} tipo_msg_accion;
+
+typedef struct {
+	int32_t turnos;
+	int32_t ganador; // Símbolo del equipo ganador o '*' si no hay (máximo de turnos o ningún equipo vivo)
+} tipo_msg_fin;
+
+/* Crea el socket de escucha: una ruta (con '/') es un socket Unix; si no, [host:]puerto
+ * TCP, por defecto en 127.0.0.1. Retorna el descriptor o -1 */
+int proto_escuchar(const char *direccion);
+
+/* Conecta con el servidor en la misma forma de dirección. Retorna el descriptor o -1 */
+int proto_conectar(const char *direccion);
+
+/* Libera la ruta de un socket Unix de escucha */
+void proto_borrar(const char *direccion);
+
+/* Envía un mensaje completo. Retorna -1 si la conexión se ha cerrado */
+int proto_enviar(int fd, int tipo, const void *datos, size_t longitud);
+
+/* Recibe un mensaje completo esperando lo necesario. Retorna el tipo, o -1 si la conexión
+ * se ha cerrado o el mensaje no cabe en 'capacidad' */
+int proto_recibir(int fd, void *datos, size_t capacidad, size_t *longitud);
+
+#endif /* SRC_PROTOCOLO_H_ */
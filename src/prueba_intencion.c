@@ -0,0 +1,102 @@
+/**
+ *
+ * Descripcion: prueba de la recogida de intenciones cuando una nave muere a
+ *		mitad de publicar. Deja la secuencia de una intención impar con su
+ *		bit de pendientes marcado y comprueba que intencion_recoger vuelve,
+ *		se salta esa nave y sigue recogiendo las demás. Una alarma corta la
+ *		prueba si la recogida se queda esperando. bench/intenciones.sh la
+ *		compila y la ejecuta.
+ *
+ * Fichero: prueba_intencion.c
+ * Autor: Miguel González Bustamante, miguel.gonzalezb@estudiante.uam.es
+ * Grupo: 2261
+ * Fecha: 08-05-2019
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+#include <intencion.h>
+
+#define PRUEBA_LIMITE_S 5 // Segundos que puede tardar la prueba
+
+/* Copias que recoge el simulador */
+tipo_intencion copias[N_EQUIPOS * N_NAVES];
+
+/****************************************************************************/
+/* Funcion: manejador_SIGALRM                                               */
+/*                                                                          */
+/* Descripcion: la recogida no ha vuelto a tiempo: la prueba falla.         */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		int sig: señal recibida                                             */
+/* Parametros de salida: void                                               */
+/****************************************************************************/
+void manejador_SIGALRM(int sig) {
+	static const char mensaje[] = "ERROR DE PRUEBA: intencion_recoger no vuelve con una intención a medias\n";
+
+	write(STDOUT_FILENO, mensaje, sizeof(mensaje) - 1);
+	_exit(EXIT_FAILURE);
+}
+
+/****************************************************************************/
+/* Funcion: prueba_comprobar                                                */
+/*                                                                          */
+/* Descripcion: comprueba lo recogido frente a lo esperado.                 */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		char *caso: descripción del caso                                    */
+/*		int n: intenciones recogidas                                        */
+/*		int esperadas: intenciones que se tenían que recoger                */
+/*		int nave: nave que tenía que recogerse primero (-1 si ninguna)      */
+/* Parametros de salida: 0 si coincide o -1 si no.                          */
+/****************************************************************************/
+int prueba_comprobar(char *caso, int n, int esperadas, int nave) {
+	if(n != esperadas || (n > 0 && copias[0].nave != nave)) {
+		printf("ERROR DE PRUEBA: %s: %d intenciones recogidas (%d esperadas)\n", caso, n, esperadas);
+		return -1;
+	}
+	printf("Prueba: %s: bien\n", caso);
+	return 0;
+}
+
+int main() {
+	tipo_intenciones *intenciones;
+	tipo_accion accion = {0};
+	int fallos = 0;
+
+	if(N_NAVES < 2) {
+		printf("ERROR DE PRUEBA: hacen falta al menos dos naves por equipo.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	intenciones = intencion_create();
+	if(intenciones == NULL) {
+		printf("ERROR DE PRUEBA: no se han podido crear las intenciones.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	signal(SIGALRM, manejador_SIGALRM);
+	alarm(PRUEBA_LIMITE_S);
+
+	/* La nave 0 publica y muere a mitad de la siguiente: secuencia impar y
+	 * bit marcado. La nave 1 publica con normalidad */
+	intencion_publicar(intenciones, 0, 0, 0, &accion, 1);
+	intencion_publicar(intenciones, 0, 1, 0, &accion, 1);
+	intenciones->naves[0][0].secuencia++;
+	fallos += prueba_comprobar("nave a medias", intencion_recoger(intenciones, copias, N_EQUIPOS * N_NAVES), 1, 1);
+
+	/* Sin nadie que vuelva a marcar el bit no se vuelve a mirar */
+	fallos += prueba_comprobar("nave muerta", intencion_recoger(intenciones, copias, N_EQUIPOS * N_NAVES), 0, -1);
+
+	/* Si la nave termina de publicar se recoge en la siguiente vuelta */
+	intenciones->naves[0][0].secuencia++;
+	intencion_publicar(intenciones, 0, 0, 1, &accion, 1);
+	fallos += prueba_comprobar("nave que termina", intencion_recoger(intenciones, copias, N_EQUIPOS * N_NAVES), 1, 0);
+
+	alarm(0);
+	intencion_destroy(intenciones);
+	exit(fallos == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+}
@@ -0,0 +1,287 @@
+/**
+ *
+ * Descripcion: registro asíncrono de eventos. Los caminos críticos solo copian
+ *		un registro binario de tamaño fijo en un anillo sin cerrojos (un único
+ *		productor y un único consumidor por proceso); un hilo en segundo plano
+ *		lo vuelca a disco en binario o lo formatea en la salida estándar.
+ *
+ * Fichero: registro.c
+ * Autor: Miguel González Bustamante, miguel.gonzalezb@estudiante.uam.es
+ * Grupo: 2261
+ * Fecha: 08-05-2019
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <registro.h>
+
+#define REGISTRO_VERSION 1
+#define REGISTRO_ESPERA_NS 10000000L // Espera del hilo de volcado cuando no hay eventos
+
+/* Descripción de cada evento */
+typedef struct {
+	int nivel;
+	int num_args;
+	const char *formato;
+} tipo_descripcion;
+
+static const tipo_descripcion eventos[EV_NUM_EVENTOS] = {
+	[EV_TURNO] = {REG_INFO, 1, "New TURNO %d"},
+	[EV_ESCUCHANDO] = {REG_DEBUG, 0, "Simulador: escuchando cola mensajes"},
+	[EV_RECIBIDO] = {REG_DEBUG, 0, "Simulador: recibido en cola de mensajes"},
+	[EV_MOVER_EXITO] = {REG_INFO, 6, "ACCION MOVER [%c%d] %d,%d -> %d,%d: éxito"},
+	[EV_MOVER_FALLO] = {REG_INFO, 6, "ACCION MOVER [%c%d] %d,%d -> %d,%d: fallo"},
+	[EV_ATAQUE_AGUA] = {REG_INFO, 6, "ACCION ATAQUE [%c%d] %d,%d -> %d,%d: FALLIDO: Casilla target vacia"},
+	[EV_ATAQUE_DESTRUIDO] = {REG_INFO, 6, "ACCION ATAQUE [%c%d] %d,%d -> %d,%d: target destruido"},
+	[EV_ATAQUE_TOCADO] = {REG_INFO, 7, "ACCION ATAQUE [%c%d] %d,%d -> %d,%d: target a %d de vida"},
+	[EV_FUERA_DE_PLAZO] = {REG_INFO, 3, "ACCION [%c%d] del turno %d: fuera de plazo, descartada"},
+};
+
+/* Anillo del proceso */
+static tipo_registro anillo[REGISTRO_CAPACIDAD];
+static unsigned long cabeza = 0; // Siguiente posición a escribir (solo el productor)
+static unsigned long cola = 0; // Siguiente posición a volcar (solo el consumidor)
+static unsigned long descartados = 0; // Eventos perdidos por anillo lleno
+static int nivel_actual = REG_INFO; // Se cambia desde un manejador de señal: acceso atómico
+
+static pthread_t hilo;
+static volatile bool activo = false;
+static FILE *salida = NULL;
+static bool binario = false;
+
+/****************************************************************************/
+/* Funcion: registro_ns                                                     */
+/*                                                                          */
+/* Descripcion: lee un reloj en nanosegundos.                               */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		clockid_t reloj: reloj a leer                                       */
+/* Parametros de salida: nanosegundos.                                      */
+/****************************************************************************/
+static uint64_t registro_ns(clockid_t reloj) {
+	struct timespec t;
+
+	clock_gettime(reloj, &t);
+	return (uint64_t)t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+/****************************************************************************/
+/* Funcion: registro_formato                                                */
+/*                                                                          */
+/* Descripcion: obtiene el formato de texto de un evento.                   */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		int evento: tipo_evento                                             */
+/* Parametros de salida: el formato o NULL si el evento no existe.          */
+/****************************************************************************/
+const char *registro_formato(int evento) {
+	if(evento < 0 || evento >= EV_NUM_EVENTOS)
+		return NULL;
+	return eventos[evento].formato;
+}
+
+/****************************************************************************/
+/* Funcion: registro_imprimir                                               */
+/*                                                                          */
+/* Descripcion: formatea un registro como una línea de texto.               */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		FILE *f: destino                                                    */
+/*		tipo_registro *reg: registro                                        */
+/* Parametros de salida: void                                               */
+/****************************************************************************/
+void registro_imprimir(FILE *f, tipo_registro *reg) {
+	const char *formato = registro_formato(reg->evento);
+	int32_t *a = reg->args;
+
+	if(formato == NULL) {
+		fprintf(f, "evento desconocido %d\n", reg->evento);
+		return;
+	}
+	fprintf(f, formato, a[0], a[1], a[2], a[3], a[4], a[5], a[6]);
+	fputc('\n', f);
+}
+
+/****************************************************************************/
+/* Funcion: registro_volcar                                                 */
+/*                                                                          */
+/* Descripcion: vuelca los eventos pendientes del anillo.                   */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/* Parametros de salida: número de eventos volcados.                        */
+/****************************************************************************/
+static unsigned long registro_volcar() {
+	unsigned long h = __atomic_load_n(&cabeza, __ATOMIC_ACQUIRE);
+	unsigned long t = cola;
+	unsigned long n = h - t;
+
+	for(; t != h; t++) {
+		tipo_registro *reg = &anillo[t & (REGISTRO_CAPACIDAD - 1)];
+		if(binario)
+			fwrite(reg, sizeof(*reg), 1, salida);
+		else
+			registro_imprimir(salida, reg);
+	}
+
+	__atomic_store_n(&cola, t, __ATOMIC_RELEASE);
+	if(n > 0)
+		fflush(salida);
+	return n;
+}
+
+/****************************************************************************/
+/* Funcion: registro_hilo                                                   */
+/*                                                                          */
+/* Descripcion: hilo de volcado. Cuando no hay eventos duerme un momento.   */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		void *arg: no se usa                                                */
+/* Parametros de salida: NULL.                                              */
+/****************************************************************************/
+static void *registro_hilo(void *arg) {
+	struct timespec espera = {0, REGISTRO_ESPERA_NS};
+
+	while(activo) {
+		if(registro_volcar() == 0)
+			nanosleep(&espera, NULL);
+	}
+	registro_volcar();
+	return NULL;
+}
+
+/****************************************************************************/
+/* Funcion: registro_init                                                   */
+/*                                                                          */
+/* Descripcion: abre el destino del registro y arranca el hilo de volcado.  */
+/*		Debe llamarse después de crear los procesos hijos, que no heredan   */
+/*		el hilo.                                                            */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		const char *fichero: fichero binario o NULL para la salida estándar */
+/*		int nivel: nivel de detalle inicial                                 */
+/* Parametros de salida: retorna positivo si no se produce ningún error o   */
+/*		negativo en caso contrario.                                         */
+/****************************************************************************/
+int registro_init(const char *fichero, int nivel) {
+	__atomic_store_n(&nivel_actual, nivel, __ATOMIC_RELAXED);
+
+	if(fichero == NULL) {
+		salida = stdout;
+		binario = false;
+	} else {
+		tipo_registro_cabecera cab;
+
+		salida = fopen(fichero, "wb");
+		if(salida == NULL)
+			return -1;
+		binario = true;
+
+		memset(&cab, 0, sizeof(cab));
+		memcpy(cab.magia, REGISTRO_MAGIA, sizeof(cab.magia));
+		cab.version = REGISTRO_VERSION;
+		cab.pid = getpid();
+		cab.inicio_realtime = registro_ns(CLOCK_REALTIME);
+		cab.inicio_monotonic = registro_ns(CLOCK_MONOTONIC);
+		fwrite(&cab, sizeof(cab), 1, salida);
+	}
+
+	activo = true;
+	if(pthread_create(&hilo, NULL, registro_hilo, NULL) != 0) {
+		activo = false;
+		return -1;
+	}
+	return 1;
+}
+
+/****************************************************************************/
+/* Funcion: registro_set_nivel                                              */
+/*                                                                          */
+/* Descripcion: cambia el nivel de detalle del registro. Se puede llamar   */
+/*		desde un manejador de señal.                                        */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		int nivel: nuevo nivel                                              */
+/* Parametros de salida: void                                               */
+/****************************************************************************/
+void registro_set_nivel(int nivel) {
+	__atomic_store_n(&nivel_actual, nivel, __ATOMIC_RELAXED);
+}
+
+/****************************************************************************/
+/* Funcion: registro_get_nivel                                              */
+/*                                                                          */
+/* Descripcion: obtiene el nivel de detalle actual del registro.            */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/* Parametros de salida: nivel actual.                                      */
+/****************************************************************************/
+int registro_get_nivel() {
+	return __atomic_load_n(&nivel_actual, __ATOMIC_RELAXED);
+}
+
+/****************************************************************************/
+/* Funcion: registro_evento                                                 */
+/*                                                                          */
+/* Descripcion: copia un evento en el anillo. Nunca se bloquea: si el       */
+/*		anillo está lleno el evento se descarta y se cuenta.                */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		int evento: tipo_evento                                             */
+/*		...: argumentos enteros del evento                                  */
+/* Parametros de salida: void                                               */
+/****************************************************************************/
+void registro_evento(int evento, ...) {
+	const tipo_descripcion *desc = &eventos[evento];
+	unsigned long h = cabeza;
+	tipo_registro *reg;
+	va_list ap;
+
+	if(desc->nivel > __atomic_load_n(&nivel_actual, __ATOMIC_RELAXED) || !activo)
+		return;
+
+	if(h - __atomic_load_n(&cola, __ATOMIC_ACQUIRE) >= REGISTRO_CAPACIDAD) {
+		descartados++;
+		return;
+	}
+
+	reg = &anillo[h & (REGISTRO_CAPACIDAD - 1)];
+	reg->tiempo = registro_ns(CLOCK_MONOTONIC);
+	reg->evento = evento;
+	reg->nivel = desc->nivel;
+	va_start(ap, evento);
+	for(int i = 0; i < REGISTRO_MAXARGS; i++)
+		reg->args[i] = (i < desc->num_args) ? va_arg(ap, int) : 0;
+	va_end(ap);
+
+	__atomic_store_n(&cabeza, h + 1, __ATOMIC_RELEASE);
+}
+
+/****************************************************************************/
+/* Funcion: registro_end                                                    */
+/*                                                                          */
+/* Descripcion: detiene el hilo de volcado después de vaciar el anillo.     */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/* Parametros de salida: void                                               */
+/****************************************************************************/
+void registro_end() {
+	if(!activo)
+		return;
+
+	activo = false;
+	pthread_join(hilo, NULL);
+
+	if(descartados > 0)
+		fprintf(stderr, "Registro: %lu eventos descartados por anillo lleno\n", descartados);
+	if(binario)
+		fclose(salida);
+	else
+		fflush(salida);
+}
@@ -0,0 +1,69 @@
+#ifndef SRC_REGISTRO_H_
+#define SRC_REGISTRO_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* Niveles de detalle del registro */
+#define REG_ERROR 0 // Solo errores
+#define REG_INFO 1 // Resultado de las acciones y turnos
+#define REG_DEBUG 2 // Actividad de la cola de mensajes
+
+#define REGISTRO_MAXARGS 7 // Número máximo de argumentos de un evento
+#define REGISTRO_CAPACIDAD 8192 // Registros en el anillo de cada proceso (potencia de 2)
+#define REGISTRO_MAGIA "REGNAVE1" // Cabecera de los ficheros de registro binario
+
+/* Eventos del registro. El formato de cada uno está en la tabla de registro.c */
+typedef enum {
+	EV_TURNO,
+	EV_ESCUCHANDO,
+	EV_RECIBIDO,
+	EV_MOVER_EXITO,
+	EV_MOVER_FALLO,
+	EV_ATAQUE_AGUA,
+	EV_ATAQUE_DESTRUIDO,
+	EV_ATAQUE_TOCADO,
+	EV_FUERA_DE_PLAZO,
+	EV_NUM_EVENTOS
+} tipo_evento;
+
+/* Registro binario de tamaño fijo */
+typedef struct {
+	uint64_t tiempo; // Nanosegundos de CLOCK_MONOTONIC
+	uint16_t evento; // tipo_evento
+	uint16_t nivel; // Nivel del evento
+	int32_t args[REGISTRO_MAXARGS];
+} tipo_registro;
+
+/* Cabecera de un fichero de registro binario */
+typedef struct {
+	char magia[8]; // REGISTRO_MAGIA
+	int32_t version; // Versión del formato
+	int32_t pid; // Proceso que generó el registro
+	uint64_t inicio_realtime; // Nanosegundos de CLOCK_REALTIME al abrir el registro
+	uint64_t inicio_monotonic; // Nanosegundos de CLOCK_MONOTONIC al abrir el registro
+} tipo_registro_cabecera;
+
+/* Arranca el hilo que vuelca el registro. Si fichero es NULL se formatea en stdout,
+ * si no se escribe en binario en el fichero */
+int registro_init(const char *fichero, int nivel);
+
+/* Cambia el nivel de detalle en tiempo de ejecución (también desde un manejador de señal) */
+void registro_set_nivel(int nivel);
+
+/* Obtiene el nivel de detalle actual */
+int registro_get_nivel();
+
+/* Anota un evento con sus argumentos enteros sin formatear ni esperar */
+void registro_evento(int evento, ...);
+
+/* Vacía el anillo y detiene el hilo de volcado */
+void registro_end();
+
+/* Obtiene el formato de texto de un evento */
+const char *registro_formato(int evento);
+
+/* Escribe un registro formateado en el fichero */
+void registro_imprimir(FILE *f, tipo_registro *reg);
+
+#endif /* SRC_REGISTRO_H_ */
@@ -0,0 +1,64 @@
+/**
+ *
+ * Descripcion: decodificador de los ficheros de registro binario que genera el
+ *		simulador con la opción -l. Formatea cada evento con su marca de
+ *		tiempo relativa al inicio del registro.
+ *
+ * Fichero: registro_leer.c
+ * Autor: Miguel González Bustamante, miguel.gonzalezb@estudiante.uam.es
+ * Grupo: 2261
+ * Fecha: 08-05-2019
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <registro.h>
+
+int main(int argc, char *argv[]) {
+	tipo_registro_cabecera cab;
+	tipo_registro reg;
+	FILE *f;
+	int opt, nivel = REG_DEBUG;
+
+	while((opt = getopt(argc, argv, "v:")) != -1) {
+		switch(opt) {
+			case 'v':
+				nivel = atoi(optarg);
+				break;
+			default:
+				printf("Uso: %s [-v nivel] fichero\n", argv[0]);
+				exit(EXIT_FAILURE);
+		}
+	}
+
+	if(optind >= argc) {
+		printf("Uso: %s [-v nivel] fichero\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	f = fopen(argv[optind], "rb");
+	if(f == NULL) {
+		printf("ERROR DE REGISTRO: abriendo %s.\n", argv[optind]);
+		exit(EXIT_FAILURE);
+	}
+
+	if(fread(&cab, sizeof(cab), 1, f) != 1 || memcmp(cab.magia, REGISTRO_MAGIA, sizeof(cab.magia)) != 0) {
+		printf("ERROR DE REGISTRO: %s no es un fichero de registro.\n", argv[optind]);
+		exit(EXIT_FAILURE);
+	}
+
+	printf("# Registro del proceso %d (versión %d)\n", cab.pid, cab.version);
+
+	while(fread(&reg, sizeof(reg), 1, f) == 1) {
+		if(reg.nivel > nivel)
+			continue;
+		printf("[%12.6f] ", (reg.tiempo - cab.inicio_monotonic) / 1e9);
+		registro_imprimir(stdout, &reg);
+	}
+
+	fclose(f);
+	exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,238 @@
+/**
+ *
+ * Descripcion: fase de resolución de movimientos al final de cada turno. Los
+ *		mensajes 'ACCION MOVER' no se aplican al llegar sino que se guardan como
+ *		intenciones (una por nave) y al acabar el turno se resuelven todas a la
+ *		vez con una tabla de casillas destino:
+ *		- Si varias naves quieren la misma casilla gana la de mayor prioridad,
+ *		  calculada a partir del turno y de la nave (no del orden de llegada).
+ *		- Una nave puede entrar en una casilla ocupada solo si la nave que la
+ *		  ocupa sale de ella con éxito este mismo turno.
+ *		- Los intercambios y ciclos de naves fallan enteros.
+ *		Todo el proceso es lineal en el número de intenciones.
+ *
+ * Fichero: resolucion.c
+ * Autor: Miguel González Bustamante, miguel.gonzalezb@estudiante.uam.es
+ * Grupo: 2261
+ * Fecha: 08-05-2019
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <mapa.h>
+#include <resolucion.h>
+#include <registro.h>
+
+#define N_IDS (N_EQUIPOS * N_NAVES) // Número total de naves
+#define N_CASILLAS (MAPA_MAXY * MAPA_MAXX) // Número total de casillas
+
+/* Estado de una intención durante la resolución */
+#define PENDIENTE 0
+#define VISITANDO 1
+#define EXITO 2
+#define FALLO 3
+
+static tipo_accion intenciones[N_IDS]; // Intenciones del turno, como mucho una por nave
+static int estado[N_IDS]; // Estado de cada intención
+static int num_intenciones = 0;
+
+/* Las tablas se marcan con el número de ronda para no tener que limpiarlas cada turno */
+static unsigned int ronda = 1;
+static int intencion_nave[N_IDS]; // Intención registrada por cada nave
+static unsigned int ronda_nave[N_IDS];
+static int destino[N_CASILLAS]; // Intención ganadora para cada casilla destino
+static unsigned int ronda_destino[N_CASILLAS];
+
+/****************************************************************************/
+/* Funcion: resolucion_prioridad                                            */
+/*                                                                          */
+/* Descripcion: calcula la prioridad de una nave en un turno. Es una mezcla */
+/*		pseudoaleatoria reproducible para que ningún equipo gane siempre    */
+/*		los conflictos.                                                     */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		int turno: número de turno                                          */
+/*		int id: identificador global de la nave                            */
+/* Parametros de salida: la prioridad (mayor gana).                         */
+/****************************************************************************/
+static unsigned int resolucion_prioridad(int turno, int id) {
+	unsigned int h = (unsigned int)turno * 0x9E3779B9u ^ (unsigned int)id * 0x85EBCA6Bu;
+
+	h ^= h >> 16;
+	h *= 0x7FEB352Du;
+	h ^= h >> 15;
+	h *= 0x846CA68Bu;
+	h ^= h >> 16;
+	return h;
+}
+
+/****************************************************************************/
+/* Funcion: resolucion_informar                                             */
+/*                                                                          */
+/* Descripcion: muestra el resultado de un movimiento.                      */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		tipo_accion *accion: movimiento                                     */
+/*		int exito: si el movimiento se ha realizado                         */
+/* Parametros de salida: void                                               */
+/****************************************************************************/
+static void resolucion_informar(tipo_accion *accion, int exito) {
+	registro_evento(exito ? EV_MOVER_EXITO : EV_MOVER_FALLO, symbol_equipos[accion->equipo], accion->nave,
+		accion->oriY, accion->oriX, accion->desY, accion->desX);
+}
+
+/****************************************************************************/
+/* Funcion: resolucion_registrar                                            */
+/*                                                                          */
+/* Descripcion: guarda la intención de movimiento de una nave. Los          */
+/*		movimientos imposibles (fuera del mapa, a más de MOVER_ALCANCE o a  */
+/*		la propia casilla) fallan aquí y no sustituyen a uno anterior.      */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		tipo_mapa *mapa: estructura del mapa                                */
+/*		tipo_accion *accion: mensaje 'ACCION MOVER'                         */
+/* Parametros de salida: void                                               */
+/****************************************************************************/
+void resolucion_registrar(tipo_mapa *mapa, tipo_accion *accion) {
+	tipo_nave nave;
+	int id, distancia;
+
+	if(accion->equipo < 0 || accion->equipo >= N_EQUIPOS || accion->nave < 0 || accion->nave >= N_NAVES)
+		return;
+
+	nave = mapa_get_nave(mapa, accion->equipo, accion->nave);
+	if(nave.viva == false)
+		return;
+
+	if(accion->desY < 0 || accion->desY >= MAPA_MAXY || accion->desX < 0 || accion->desX >= MAPA_MAXX) {
+		resolucion_informar(accion, 0);
+		return;
+	}
+
+	distancia = mapa_get_distancia(mapa, nave.posy, nave.posx, accion->desY, accion->desX);
+	if(distancia == 0 || distancia > MOVER_ALCANCE) {
+		resolucion_informar(accion, 0);
+		return;
+	}
+
+	id = accion->equipo * N_NAVES + accion->nave;
+	if(ronda_nave[id] != ronda) {
+		ronda_nave[id] = ronda;
+		intencion_nave[id] = num_intenciones++;
+	}
+	intenciones[intencion_nave[id]] = *accion;
+}
+
+/****************************************************************************/
+/* Funcion: resolucion_resolver                                             */
+/*                                                                          */
+/* Descripcion: decide si una intención que ha ganado su casilla destino    */
+/*		puede realizarse. Si la casilla está ocupada depende de que la nave */
+/*		que la ocupa se mueva; si se vuelve a una intención que se está     */
+/*		resolviendo hay un ciclo y falla.                                   */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		tipo_mapa *mapa: estructura del mapa                                */
+/*		int k: índice de la intención                                       */
+/* Parametros de salida: EXITO o FALLO.                                     */
+/****************************************************************************/
+static int resolucion_resolver(tipo_mapa *mapa, int k) {
+	tipo_casilla casilla;
+	int ocupante, siguiente, resultado;
+
+	if(estado[k] == VISITANDO)
+		return FALLO;
+	if(estado[k] != PENDIENTE)
+		return estado[k];
+
+	estado[k] = VISITANDO;
+	if(mapa_is_casilla_vacia(mapa, intenciones[k].desY, intenciones[k].desX)) {
+		resultado = EXITO;
+	} else {
+		casilla = mapa_get_casilla(mapa, intenciones[k].desY, intenciones[k].desX);
+		ocupante = casilla.equipo * N_NAVES + casilla.numNave;
+		if(ronda_nave[ocupante] != ronda) {
+			/* El ocupante no intenta moverse */
+			resultado = FALLO;
+		} else {
+			siguiente = intencion_nave[ocupante];
+			resultado = (resolucion_resolver(mapa, siguiente) == EXITO) ? EXITO : FALLO;
+		}
+	}
+
+	estado[k] = resultado;
+	return resultado;
+}
+
+/****************************************************************************/
+/* Funcion: resolucion_aplicar                                              */
+/*                                                                          */
+/* Descripcion: resuelve los conflictos entre las intenciones del turno y   */
+/*		aplica sobre el mapa las que tienen éxito en una sola pasada.       */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		tipo_mapa *mapa: estructura del mapa                                */
+/*		int turno: número de turno, usado para las prioridades              */
+/* Parametros de salida: void                                               */
+/****************************************************************************/
+void resolucion_aplicar(tipo_mapa *mapa, int turno) {
+	tipo_nave nave;
+	int k, c, rival, id, id_rival;
+	unsigned int p, p_rival;
+
+	/* 1. Tabla de casillas destino: una sola intención gana cada casilla */
+	for(k = 0; k < num_intenciones; k++) {
+		nave = mapa_get_nave(mapa, intenciones[k].equipo, intenciones[k].nave);
+		/* La nave ha podido ser destruida después de registrar el movimiento */
+		if(nave.viva == false) {
+			estado[k] = FALLO;
+			continue;
+		}
+		intenciones[k].oriY = nave.posy;
+		intenciones[k].oriX = nave.posx;
+
+		estado[k] = PENDIENTE;
+		c = intenciones[k].desY * MAPA_MAXX + intenciones[k].desX;
+		if(ronda_destino[c] != ronda) {
+			ronda_destino[c] = ronda;
+			destino[c] = k;
+			continue;
+		}
+
+		rival = destino[c];
+		id = intenciones[k].equipo * N_NAVES + intenciones[k].nave;
+		id_rival = intenciones[rival].equipo * N_NAVES + intenciones[rival].nave;
+		p = resolucion_prioridad(turno, id);
+		p_rival = resolucion_prioridad(turno, id_rival);
+		if(p > p_rival || (p == p_rival && id < id_rival)) {
+			estado[rival] = FALLO;
+			destino[c] = k;
+		} else {
+			estado[k] = FALLO;
+		}
+	}
+
+	/* 2. Cadenas de naves que dejan libre la casilla a la siguiente */
+	for(k = 0; k < num_intenciones; k++) {
+		resolucion_resolver(mapa, k);
+	}
+
+	/* 3. Primero se vacían todas las casillas de origen y después se ocupan los destinos */
+	for(k = 0; k < num_intenciones; k++) {
+		if(estado[k] == EXITO)
+			mapa_clean_casilla(mapa, intenciones[k].oriY, intenciones[k].oriX);
+	}
+	for(k = 0; k < num_intenciones; k++) {
+		if(estado[k] == EXITO) {
+			nave = mapa_get_nave(mapa, intenciones[k].equipo, intenciones[k].nave);
+			nave.posy = intenciones[k].desY;
+			nave.posx = intenciones[k].desX;
+			mapa_set_nave(mapa, nave);
+		}
+		resolucion_informar(&intenciones[k], estado[k] == EXITO);
+	}
+
+	num_intenciones = 0;
+	ronda++;
+}
@@ -0,0 +1,14 @@
+#ifndef SRC_RESOLUCION_H_
+#define SRC_RESOLUCION_H_
+
+#include <simulador.h>
+
+/* Registra la intención de movimiento de una nave para el turno en curso. Si la nave
+ * ya tenía una intención válida este turno, la nueva la sustituye */
+void resolucion_registrar(tipo_mapa *mapa, tipo_accion *accion);
+
+/* Resuelve todas las intenciones de movimiento del turno a la vez y las aplica sobre
+ * el mapa. El resultado no depende del orden de llegada de los mensajes */
+void resolucion_aplicar(tipo_mapa *mapa, int turno);
+
+#endif /* SRC_RESOLUCION_H_ */
@@ -0,0 +1,437 @@
+/**
+ *
+ * Descripcion: modo servidor del simulador. En lugar de crear los procesos
+ *		jefe y nave, acepta un cliente por equipo en un socket Unix o TCP.
+ *		Cada turno envía a cada equipo solo las naves que han cambiado
+ *		desde lo que ya le envió, y recibe de una vez las acciones de todas
+ *		sus naves. Cada conexión tiene su plazo por turno: las acciones que
+ *		llegan después se descartan.
+ *
+ * Fichero: servidor.c
+ * Autor: Miguel González Bustamante, miguel.gonzalezb@estudiante.uam.es
+ * Grupo: 2261
+ * Fecha: 08-05-2019
+ *
+ */
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <mapa.h>
+#include <planificador.h>
+#include <protocolo.h>
+#include <servidor.h>
+
+/* Los mensajes llevan índices de nave y coordenadas en 16 bits */
+_Static_assert(N_EQUIPOS * N_NAVES <= UINT16_MAX + 1, "el índice de nave del protocolo no llega a tantas naves");
+_Static_assert(MAPA_MAXY <= INT16_MAX && MAPA_MAXX <= INT16_MAX, "las coordenadas del protocolo no llegan a un mapa tan grande");
+
+#define SERV_MAX_ACCIONES (N_NAVES * ACCIONES_MAX_TURNO) // Acciones que admite un lote
+#define SERV_ENTRADA (sizeof(tipo_msg_cabecera) + sizeof(tipo_msg_acciones) + SERV_MAX_ACCIONES * sizeof(tipo_msg_accion))
+
+/* Conexión de un equipo */
+typedef struct {
+	int fd; // -1 si el equipo se ha desconectado
+	bool respondido; // Si ya ha enviado las acciones del turno en curso
+	uint64_t envio; // Instante en que se envió el turno (ns)
+	uint64_t limite; // Plazo para responder al turno en curso (ns)
+	char entrada[SERV_ENTRADA]; // Bytes recibidos de mensajes aún incompletos
+	size_t llenos;
+	tipo_nave enviadas[N_EQUIPOS][N_NAVES]; // Lo que el equipo conoce de cada nave
+	bool primero; // Si todavía no ha recibido ningún turno
+	unsigned long respuestas, tardias, acciones; // Estadísticas
+	double respuesta_ms; // Suma de los tiempos de respuesta
+} tipo_conexion;
+
+static int escucha = -1;
+static char *direccion_escucha = NULL;
+static int limite_turno_ms;
+static tipo_conexion *conexiones = NULL; // Una por equipo
+static char *salida = NULL; // Mensaje de turno en preparación
+
+/****************************************************************************/
+/* Funcion: servidor_ahora                                                  */
+/*                                                                          */
+/* Descripcion: instante actual en nanosegundos de CLOCK_MONOTONIC.         */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/* Parametros de salida: nanosegundos.                                      */
+/****************************************************************************/
+static uint64_t servidor_ahora() {
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t)t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+/****************************************************************************/
+/* Funcion: servidor_crear                                                  */
+/*                                                                          */
+/* Descripcion: crea el socket de escucha y el estado de las conexiones.    */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		const char *direccion: ruta Unix o [host:]puerto TCP                */
+/*		int limite_ms: plazo de cada equipo para responder a un turno       */
+/* Parametros de salida: 0 si se ha creado o -1 si no.                      */
+/****************************************************************************/
+int servidor_crear(const char *direccion, int limite_ms) {
+	conexiones = calloc(N_EQUIPOS, sizeof(tipo_conexion));
+	salida = malloc(sizeof(tipo_msg_turno) + N_EQUIPOS * N_NAVES * sizeof(tipo_msg_nave));
+	if(conexiones == NULL || salida == NULL)
+		return -1;
+	for(int e = 0; e < N_EQUIPOS; e++)
+		conexiones[e].fd = -1;
+
+	escucha = proto_escuchar(direccion);
+	if(escucha == -1)
+		return -1;
+	direccion_escucha = strdup(direccion);
+	limite_turno_ms = limite_ms;
+	return 0;
+}
+
+/****************************************************************************/
+/* Funcion: servidor_aceptar                                                */
+/*                                                                          */
+/* Descripcion: acepta un cliente por equipo, en orden de llegada, y le     */
+/*		envía su equipo, los tamaños de la partida y el plazo por turno.    */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/* Parametros de salida: 0 si están todos los equipos o -1 si no (errno    */
+/*		EINTR si una señal ha cortado la espera).                           */
+/****************************************************************************/
+int servidor_aceptar() {
+	tipo_msg_hola hola;
+	struct timeval espera;
+	int fd, si = 1;
+
+	for(int e = 0; e < N_EQUIPOS; e++) {
+		/* Una señal corta la espera (errno EINTR) para que el simulador la atienda */
+		fd = accept(escucha, NULL, NULL);
+		if(fd == -1)
+			return -1;
+		/* En un socket Unix no hace nada */
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &si, sizeof(si));
+		/* Un cliente que no lee llena el buffer del socket: enviar le da el mismo plazo
+		 * que tiene para responder y, si no cabe, proto_enviar falla y se le desconecta
+		 * en lugar de parar al simulador entero */
+		espera.tv_sec = (limite_turno_ms > 0) ? limite_turno_ms / 1000 : 0;
+		espera.tv_usec = (limite_turno_ms > 0) ? (limite_turno_ms % 1000) * 1000L : 1000L;
+		if(setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &espera, sizeof(espera)) < 0) {
+			close(fd);
+			return -1;
+		}
+
+		hola.equipo = htonl(e);
+		hola.num_equipos = htonl(N_EQUIPOS);
+		hola.num_naves = htonl(N_NAVES);
+		hola.maxy = htonl(MAPA_MAXY);
+		hola.maxx = htonl(MAPA_MAXX);
+		hola.limite_ms = htonl(limite_turno_ms);
+		conexiones[e].fd = fd;
+		conexiones[e].primero = true;
+		if(proto_enviar(fd, PROTO_HOLA, &hola, sizeof(hola)) < 0) {
+			close(fd);
+			conexiones[e].fd = -1;
+		} else {
+			fprintf(stdout, "Servidor: equipo %c conectado\n", symbol_equipos[e]);
+			fflush(stdout);
+		}
+	}
+	return 0;
+}
+
+/****************************************************************************/
+/* Funcion: servidor_desconectar                                            */
+/*                                                                          */
+/* Descripcion: cierra la conexión de un equipo. Sus naves dejan de actuar. */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		tipo_conexion *con: conexión                                        */
+/* Parametros de salida: void                                               */
+/****************************************************************************/
+static void servidor_desconectar(tipo_conexion *con) {
+	if(con->fd == -1)
+		return;
+	close(con->fd);
+	con->fd = -1;
+	fprintf(stdout, "Servidor: equipo %c desconectado\n", symbol_equipos[con - conexiones]);
+}
+
+/****************************************************************************/
+/* Funcion: servidor_conectados                                             */
+/*                                                                          */
+/* Descripcion: cuenta los equipos que siguen conectados.                   */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/* Parametros de salida: número de equipos.                                 */
+/****************************************************************************/
+int servidor_conectados() {
+	int n = 0;
+
+	for(int e = 0; e < N_EQUIPOS; e++)
+		n += (conexiones[e].fd != -1);
+	return n;
+}
+
+/****************************************************************************/
+/* Funcion: servidor_turno                                                  */
+/*                                                                          */
+/* Descripcion: envía a cada equipo el nuevo turno con las naves que han    */
+/*		cambiado respecto a lo que ya le envió (todas la primera vez) y     */
+/*		abre su plazo para responder.                                       */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		const tipo_vista *vista: vista publicada para el turno              */
+/* Parametros de salida: void                                               */
+/****************************************************************************/
+void servidor_turno(const tipo_vista *vista) {
+	tipo_msg_turno *msg = (tipo_msg_turno *)salida;
+	tipo_msg_nave *naves = (tipo_msg_nave *)(msg + 1);
+	const tipo_nave *nave;
+	tipo_nave *enviada;
+	int e, k, num;
+
+	for(e = 0; e < N_EQUIPOS; e++) {
+		tipo_conexion *con = &conexiones[e];
+		if(con->fd == -1)
+			continue;
+
+		num = 0;
+		for(k = 0; k < N_EQUIPOS * N_NAVES; k++) {
+			nave = mapa_vista_nave(vista, k / N_NAVES, k % N_NAVES);
+			enviada = &con->enviadas[k / N_NAVES][k % N_NAVES];
+			if(!con->primero && nave->viva == enviada->viva && (!nave->viva
+				|| (nave->posy == enviada->posy && nave->posx == enviada->posx && nave->vida == enviada->vida)))
+				continue;
+			naves[num].indice = htons(k);
+			naves[num].posy = htons(nave->posy);
+			naves[num].posx = htons(nave->posx);
+			naves[num].vida = htons(nave->viva ? nave->vida : 0);
+			num++;
+			*enviada = *nave;
+		}
+		con->primero = false;
+
+		msg->turno = htonl(vista->turno);
+		msg->num_naves = htonl(num);
+		con->respondido = false;
+		con->envio = servidor_ahora();
+		con->limite = con->envio + (uint64_t)limite_turno_ms * 1000000ULL;
+		if(proto_enviar(con->fd, PROTO_TURNO, salida, sizeof(*msg) + num * sizeof(tipo_msg_nave)) < 0)
+			servidor_desconectar(con);
+	}
+}
+
+/****************************************************************************/
+/* Funcion: servidor_acciones                                               */
+/*                                                                          */
+/* Descripcion: pasa al planificador un lote de acciones de un equipo. Si   */
+/*		es de un turno anterior (llegó fuera de plazo) se descarta entero.  */
+/*		El equipo de cada acción es el de la conexión y el origen es la     */
+/*		posición real de la nave, así que un cliente no puede mover naves   */
+/*		ajenas.                                                             */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		tipo_mapa *mapa: mapa del simulador                                 */
+/*		tipo_conexion *con: conexión del equipo                             */
+/*		char *datos, size_t longitud: contenido del mensaje                 */
+/*		int turno: turno en curso                                           */
+/* Parametros de salida: número de acciones aceptadas, o -1 si el mensaje   */
+/*		no es válido.                                                       */
+/****************************************************************************/
+static int servidor_acciones(tipo_mapa *mapa, tipo_conexion *con, char *datos, size_t longitud, int turno) {
+	tipo_msg_acciones *msg = (tipo_msg_acciones *)datos;
+	tipo_msg_accion *lote = (tipo_msg_accion *)(msg + 1);
+	tipo_accion accion;
+	tipo_nave nave;
+	int k, num, aceptadas = 0, equipo = con - conexiones;
+
+	if(longitud < sizeof(*msg))
+		return -1;
+	num = ntohl(msg->num_acciones);
+	if(num < 0 || num > SERV_MAX_ACCIONES || longitud != sizeof(*msg) + num * sizeof(tipo_msg_accion))
+		return -1;
+
+	if((int)ntohl(msg->turno) != turno || con->respondido || servidor_ahora() > con->limite) {
+		con->tardias++;
+		return 0;
+	}
+	con->respondido = true;
+	con->respuestas++;
+	con->respuesta_ms += (servidor_ahora() - con->envio) / 1e6;
+
+	for(k = 0; k < num; k++) {
+		if(ntohs(lote[k].nave) >= N_NAVES)
+			continue;
+		memset(&accion, 0, sizeof(accion));
+		strcpy(accion.tipo, ntohs(lote[k].ataque) ? "ACCION ATAQUE" : "ACCION MOVER");
+		nave = mapa_get_nave(mapa, equipo, ntohs(lote[k].nave));
+		accion.equipo = equipo;
+		accion.nave = nave.numNave;
+		accion.oriY = nave.posy;
+		accion.oriX = nave.posx;
+		accion.desY = (int16_t)ntohs(lote[k].desY);
+		accion.desX = (int16_t)ntohs(lote[k].desX);
+		accion.t_envio = con->envio;
+		aceptadas += planificador_encolar(mapa, &accion, turno);
+	}
+	con->acciones += aceptadas;
+	return aceptadas;
+}
+
+/****************************************************************************/
+/* Funcion: servidor_leer                                                   */
+/*                                                                          */
+/* Descripcion: lee lo que haya llegado por una conexión sin esperar y      */
+/*		procesa los mensajes completos. Los incompletos quedan en su buffer */
+/*		hasta la siguiente lectura.                                         */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		tipo_mapa *mapa: mapa del simulador                                 */
+/*		tipo_conexion *con: conexión del equipo                             */
+/*		int turno: turno en curso                                           */
+/* Parametros de salida: número de acciones aceptadas.                      */
+/****************************************************************************/
+static int servidor_leer(tipo_mapa *mapa, tipo_conexion *con, int turno) {
+	tipo_msg_cabecera *cab = (tipo_msg_cabecera *)con->entrada;
+	size_t longitud;
+	ssize_t n;
+	int aceptadas = 0, r;
+
+	n = recv(con->fd, con->entrada + con->llenos, SERV_ENTRADA - con->llenos, MSG_DONTWAIT);
+	if(n < 0 && (errno == EAGAIN || errno == EINTR))
+		return 0;
+	if(n <= 0) {
+		servidor_desconectar(con);
+		return 0;
+	}
+	con->llenos += n;
+
+	while(con->llenos >= sizeof(*cab)) {
+		longitud = ntohl(cab->longitud);
+		if(ntohs(cab->version) != PROTO_VERSION || ntohs(cab->tipo) != PROTO_ACCIONES
+			|| sizeof(*cab) + longitud > SERV_ENTRADA) {
+			servidor_desconectar(con);
+			return aceptadas;
+		}
+		if(con->llenos < sizeof(*cab) + longitud)
+			break;
+
+		r = servidor_acciones(mapa, con, (char *)(cab + 1), longitud, turno);
+		if(r < 0) {
+			servidor_desconectar(con);
+			return aceptadas;
+		}
+		aceptadas += r;
+		con->llenos -= sizeof(*cab) + longitud;
+		memmove(con->entrada, con->entrada + sizeof(*cab) + longitud, con->llenos);
+	}
+	return aceptadas;
+}
+
+/****************************************************************************/
+/* Funcion: servidor_recibir                                                */
+/*                                                                          */
+/* Descripcion: espera con poll a los equipos que no han respondido y       */
+/*		cuyo plazo no ha vencido. El turno se cierra en cuanto responden    */
+/*		todos, sin esperar al plazo más largo.                              */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		tipo_mapa *mapa: mapa del simulador                                 */
+/*		int turno: turno en curso                                           */
+/* Parametros de salida: número de acciones aceptadas.                      */
+/****************************************************************************/
+int servidor_recibir(tipo_mapa *mapa, int turno) {
+	struct pollfd pendientes[N_EQUIPOS];
+	int equipos[N_EQUIPOS];
+	uint64_t ahora, limite;
+	int e, k, num, aceptadas = 0;
+
+	while(1) {
+		ahora = servidor_ahora();
+		limite = 0;
+		for(e = 0, num = 0; e < N_EQUIPOS; e++) {
+			if(conexiones[e].fd == -1 || conexiones[e].respondido || ahora > conexiones[e].limite)
+				continue;
+			pendientes[num].fd = conexiones[e].fd;
+			pendientes[num].events = POLLIN;
+			equipos[num++] = e;
+			limite = (conexiones[e].limite > limite) ? conexiones[e].limite : limite;
+		}
+		if(num == 0)
+			return aceptadas;
+
+		if(poll(pendientes, num, (limite - ahora) / 1000000 + 1) < 0 && errno != EINTR)
+			return aceptadas;
+		for(k = 0; k < num; k++) {
+			if(pendientes[k].revents != 0)
+				aceptadas += servidor_leer(mapa, &conexiones[equipos[k]], turno);
+		}
+	}
+}
+
+/****************************************************************************/
+/* Funcion: servidor_fin                                                    */
+/*                                                                          */
+/* Descripcion: envía el resultado a los equipos, muestra sus estadísticas  */
+/*		de respuesta y cierra el servidor.                                  */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		int turnos: turnos jugados                                          */
+/*		char ganador: símbolo del equipo ganador o '*'                      */
+/* Parametros de salida: void                                               */
+/****************************************************************************/
+void servidor_fin(int turnos, char ganador) {
+	tipo_msg_fin fin;
+
+	fin.turnos = htonl(turnos);
+	fin.ganador = htonl(ganador);
+	fprintf(stdout, "# equipo respuestas fuera_de_plazo acciones respuesta_media_ms\n");
+	for(int e = 0; e < N_EQUIPOS; e++) {
+		tipo_conexion *con = &conexiones[e];
+		if(con->fd != -1)
+			proto_enviar(con->fd, PROTO_FIN, &fin, sizeof(fin));
+		fprintf(stdout, "# %c %lu %lu %lu %.3f\n", symbol_equipos[e], con->respuestas, con->tardias, con->acciones,
+			con->respuestas ? con->respuesta_ms / con->respuestas : 0.0);
+	}
+	servidor_cerrar();
+}
+
+/****************************************************************************/
+/* Funcion: servidor_cerrar                                                 */
+/*                                                                          */
+/* Descripcion: cierra las conexiones y el socket de escucha, borrando su   */
+/*		ruta si es un socket Unix.                                          */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/* Parametros de salida: void                                               */
+/****************************************************************************/
+void servidor_cerrar() {
+	if(conexiones != NULL) {
+		for(int e = 0; e < N_EQUIPOS; e++) {
+			if(conexiones[e].fd != -1)
+				close(conexiones[e].fd);
+		}
+		free(conexiones);
+		conexiones = NULL;
+	}
+	if(escucha != -1) {
+		close(escucha);
+		proto_borrar(direccion_escucha);
+		escucha = -1;
+	}
+	free(direccion_escucha);
+	free(salida);
+	direccion_escucha = NULL;
+	salida = NULL;
+}
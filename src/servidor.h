@@ -0,0 +1,28 @@
+#ifndef SRC_SERVIDOR_H_
+#define SRC_SERVIDOR_H_
+
+#include <simulador.h>
+
+/* Crea el socket de escucha del modo servidor. Retorna -1 si no es posible */
+int servidor_crear(const char *direccion, int limite_ms);
+
+/* Espera a que se conecte un cliente por equipo y les envía el saludo */
+int servidor_aceptar();
+
+/* Obtiene el número de equipos que siguen conectados */
+int servidor_conectados();
+
+/* Envía a cada equipo las naves que han cambiado desde su último turno y abre su plazo */
+void servidor_turno(const tipo_vista *vista);
+
+/* Recoge las acciones del turno hasta que respondan todos los equipos o venzan sus
+ * plazos y las pasa al planificador. Retorna el número de acciones aceptadas */
+int servidor_recibir(tipo_mapa *mapa, int turno);
+
+/* Envía el fin de partida, muestra las estadísticas de cada equipo y cierra las conexiones */
+void servidor_fin(int turnos, char ganador);
+
+/* Cierra las conexiones y el socket de escucha sin avisar a los equipos */
+void servidor_cerrar();
+
+#endif /* SRC_SERVIDOR_H_ */
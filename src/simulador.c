@@ -25,21 +25,192 @@
 #include <mapa.h>
 #include <semaphore.h>
 #include <nave.h>
+#include <canal.h>
+#include <intencion.h>
+#include <resolucion.h>
+#include <registro.h>
+#include <planificador.h>
+#include <memoria.h>
+#include <afinidad.h>
+#include <colocacion.h>
+#include <traza.h>
+#include <historial.h>
+#include <servidor.h>
 #include <time.h>
+#include <errno.h>
+#include <pthread.h>
 
 /* Variables globales */
 tipo_mapa *mapa;
 int fd_shm;
-bool alrm_flag = false;
+uint32_t *avisos = NULL; // Procesos esperando un cambio del mapa (SHM_AVISOS_NAME)
+volatile sig_atomic_t alrm_flag = false;
+volatile sig_atomic_t int_flag = false;
 int turno = 0;
 mqd_t queue;
 int fd1[N_EQUIPOS][2];
+tipo_canal *canales = NULL;
+tipo_intenciones *intenciones = NULL;
 sem_t *sem_ctrl = NULL;
+struct timespec t_arranque;
+bool modo_externo = false; // Sin procesos equipo: las acciones llegan de fuera (p. ej. 'generador')
+bool sin_pausas = false; // Sin animación ni pausa entre acciones
+char *fichero_traza = NULL; // Fichero en el que se guardan las trazas al terminar
+double ms_aplicacion = 0, ms_resolucion = 0; // Tiempo acumulado en cada fase de simulador_aplicar_turno
+
+/* Partida sin procesos en tubería: acciones de dos turnos, las que se aplican y las que se deciden */
+tipo_accion lotes[2][N_EQUIPOS * N_NAVES * NAVE_MAX_ACCIONES];
+int lotes_num[2];
+sem_t sem_decidir, sem_decidido; // Orden al hilo decisor y aviso de que ha terminado
+const tipo_vista *vista_decisor = NULL; // Vista sobre la que decide el hilo decisor
+int lote_decisor = 0; // Lote en el que escribe
+bool fin_decisor = false;
+double ms_decision = 0; // Tiempo acumulado decidiendo, en el hilo que sea
+
+/****************************************************************************/
+/* Funcion: simulador_guardar_traza                                         */
+/*                                                                          */
+/* Descripcion: si se pidieron trazas, guarda los intervalos de todos los   */
+/*		procesos en el fichero indicado con la opción -T.                   */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/* Parametros de salida: void                                               */
+/****************************************************************************/
+void simulador_guardar_traza() {
+	if(fichero_traza == NULL)
+		return;
+	if(traza_guardar(fichero_traza) < 0)
+		printf("ERROR DE SIMULADOR: guardando las trazas en %s.\n", fichero_traza);
+	else
+		fprintf(stdout, "Simulador: trazas guardadas en %s\n", fichero_traza);
+	fichero_traza = NULL;
+}
+
+/****************************************************************************/
+/* Funcion: simulador_ns                                                    */
+/*                                                                          */
+/* Descripcion: lee un reloj en nanosegundos.                               */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		clockid_t reloj: CLOCK_MONOTONIC, CLOCK_THREAD_CPUTIME_ID...        */
+/* Parametros de salida: nanosegundos del reloj.                            */
+/****************************************************************************/
+uint64_t simulador_ns(clockid_t reloj) {
+	struct timespec ahora;
+
+	clock_gettime(reloj, &ahora);
+	return (uint64_t)ahora.tv_sec * 1000000000ULL + ahora.tv_nsec;
+}
+
+/****************************************************************************/
+/* Funcion: simulador_a_tiempo                                              */
+/*                                                                          */
+/* Descripcion: comprueba que una acción de una nave llega dentro del plazo */
+/*		del turno para el que se decidió. Las que llegan tarde (de un turno */
+/*		ya cerrado o después del límite) se descartan y se anotan a la      */
+/*		nave; la nave se queda como estaba en ese turno.                    */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		tipo_accion *accion: acción recibida                                */
+/* Parametros de salida: true si se puede aplicar.                          */
+/****************************************************************************/
+bool simulador_a_tiempo(tipo_accion *accion) {
+	const tipo_vista *vista = &mapa->vistas[mapa->vista_actual];
+
+	/* Sin plazo o con acciones de fuera no hay nada que comprobar */
+	if(modo_externo || mapa->plazo_ns == 0)
+		return true;
+	if(accion->equipo < 0 || accion->equipo >= N_EQUIPOS || accion->nave < 0 || accion->nave >= N_NAVES)
+		return true;
+	if(accion->turno == turno && (vista->t_limite == 0 || simulador_ns(CLOCK_MONOTONIC) <= vista->t_limite))
+		return true;
+
+	mapa->tiempos[accion->equipo][accion->nave].descartadas++;
+	registro_evento(EV_FUERA_DE_PLAZO, symbol_equipos[accion->equipo], accion->nave, accion->turno);
+	return false;
+}
+
+/****************************************************************************/
+/* Funcion: simulador_puntualidad                                           */
+/*                                                                          */
+/* Descripcion: al cerrar un turno anota a cada nave viva que no ha         */
+/*		decidido a tiempo. Una nave que llega a NAVE_TARDIAS_MAX turnos     */
+/*		seguidos así queda señalada y se avisa una vez.                     */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/* Parametros de salida: void                                               */
+/****************************************************************************/
+void simulador_puntualidad() {
+	tipo_tiempos_nave *t;
+
+	/* El primer cierre solo lanza la partida: aún no se ha publicado ningún turno */
+	if(modo_externo || mapa->plazo_ns == 0 || mapa->vistas[mapa->vista_actual].secuencia == 0)
+		return;
+	for(int i = 0; i < N_EQUIPOS; i++) {
+		for(int k = 0, j; k < mapa_get_num_naves(mapa, i); k++) {
+			j = mapa_get_viva(mapa, i, k);
+			t = &mapa->tiempos[i][j];
+			if(__atomic_load_n(&t->turno, __ATOMIC_ACQUIRE) == turno && !t->tarde) {
+				t->seguidas = 0;
+				continue;
+			}
+			t->tardias++;
+			if(++t->seguidas == NAVE_TARDIAS_MAX && !t->senalada) {
+				t->senalada = true;
+				printf("AVISO DE SIMULADOR: la nave %c%d lleva %d turnos sin decidir a tiempo.\n",
+					symbol_equipos[i], j, NAVE_TARDIAS_MAX);
+			}
+		}
+	}
+}
+
+/****************************************************************************/
+/* Funcion: simulador_informe_tiempos                                       */
+/*                                                                          */
+/* Descripcion: muestra por equipo los tiempos de decisión de sus naves y   */
+/*		las que han quedado señaladas por no decidir a tiempo.              */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/* Parametros de salida: void                                               */
+/****************************************************************************/
+void simulador_informe_tiempos() {
+	tipo_tiempos_nave *t;
+
+	if(modo_externo)
+		return;
+	printf("# equipo decisiones decision_media_us cpu_media_us decision_max_us tardias descartadas sustituidas senaladas\n");
+	for(int i = 0; i < N_EQUIPOS; i++) {
+		unsigned long decisiones = 0, tardias = 0, descartadas = 0, sustituidas = 0;
+		uint64_t total = 0, cpu = 0, max = 0;
+		int senaladas = 0;
+		for(int j = 0; j < N_NAVES; j++) {
+			t = &mapa->tiempos[i][j];
+			decisiones += t->decisiones;
+			total += t->decision_total_ns;
+			cpu += t->cpu_total_ns;
+			max = (t->decision_max_ns > max) ? t->decision_max_ns : max;
+			tardias += t->tardias;
+			descartadas += t->descartadas;
+			sustituidas += t->sustituidas;
+			senaladas += t->senalada;
+		}
+		printf("# %c %lu %.1f %.1f %.1f %lu %lu %lu %d\n", symbol_equipos[i], decisiones,
+			decisiones ? total / 1e3 / decisiones : 0.0, decisiones ? cpu / 1e3 / decisiones : 0.0,
+			max / 1e3, tardias, descartadas, sustituidas, senaladas);
+	}
+	for(int i = 0; i < N_EQUIPOS; i++)
+		for(int j = 0; j < N_NAVES; j++)
+			if(mapa->tiempos[i][j].senalada)
+				printf("# señalada %c%d: %lu turnos sin decidir a tiempo\n", symbol_equipos[i], j, mapa->tiempos[i][j].tardias);
+}
 
 /****************************************************************************/
 /* Funcion: manejador_SIGINT                                                */
 /*                                                                          */
-/* Descripcion: rutina de tratamiento de la señal SIGINT.                   */
+/* Descripcion: rutina de tratamiento de la señal SIGINT. Como con SIGALRM, */
+/*		solo se marca: liberar los recursos exige funciones que no se       */
+/*		pueden llamar desde un manejador (printf, pthread_join, fopen...),  */
+/*		así que lo hace simulador_interrumpir desde el bucle de la partida. */
 /*                                                                          */
 /* Parametros de entrada:                                                   */
 /*		int *sig: señal SIGINT                                              */
@@ -47,14 +218,7 @@ sem_t *sem_ctrl = NULL;
 /* Parametros de salida: void                                               */
 /****************************************************************************/
 void manejador_SIGINT(int sig) {
-	munmap(mapa, sizeof(*mapa));
-	shm_unlink(SHM_MAP_NAME);
-    mq_close(queue);
-	mq_unlink(MQ_NAME);
-	sem_close(sem_ctrl);
-    sem_unlink(SEM_CTRL);
-	while(wait(NULL) > 0);
-	exit(EXIT_SUCCESS);
+	int_flag = true;
 }
 
 /****************************************************************************/
@@ -80,11 +244,52 @@ int manejador_SIGINT_create(struct sigaction act){
     return 1;
 }
 
+/****************************************************************************/
+/* Funcion: manejador_SIGUSR1                                               */
+/*                                                                          */
+/* Descripcion: rutina de tratamiento de la señal SIGUSR1. Pasa el registro */
+/*		al siguiente nivel de detalle (errores, acciones, cola de mensajes  */
+/*		y vuelta a empezar) sin parar la partida.                           */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		int *sig: señal SIGUSR1                                             */
+/*                                                                          */
+/* Parametros de salida: void                                               */
+/****************************************************************************/
+void manejador_SIGUSR1(int sig) {
+	registro_set_nivel((registro_get_nivel() + 1) % (REG_DEBUG + 1));
+}
+
+/****************************************************************************/
+/* Funcion: manejador_SIGUSR1_create                                        */
+/*                                                                          */
+/* Descripcion: inicializa los parámetros de la estructura sigaction para   */
+/*		enlazarlo con el manejador_SIGUSR1. Con SA_RESTART la señal no      */
+/*		corta las esperas del simulador.                                    */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		struct sigaction act: estructura del manejador                      */
+/*                                                                          */
+/* Parametros de salida: retorna positivo si no se produce ningún error o   */
+/*		negativo en caso contrario.                                         */
+/****************************************************************************/
+int manejador_SIGUSR1_create(struct sigaction act){
+	sigemptyset(&(act.sa_mask));
+    act.sa_flags = SA_RESTART;
+    act.sa_handler = manejador_SIGUSR1;
+    if(sigaction(SIGUSR1, &act, NULL) < 0) {
+        return -1;
+    }
+
+    return 1;
+}
+
 /****************************************************************************/
 /* Funcion: shm_create                                                      */
 /*                                                                          */
 /* Descripcion: crea el segmento de memoria compartida necesario para       */
-/*		gestionar el mapa.                                                  */
+/*		gestionar el mapa y el de avisos, en el que se apuntan los procesos */
+/*		que esperan un cambio sin poder escribir en el mapa.                */
 /*                                                                          */
 /* Parametros de entrada:                                                   */
 /*                                                                          */
@@ -92,6 +297,8 @@ int manejador_SIGINT_create(struct sigaction act){
 /*		negativo en caso contrario.                                         */
 /****************************************************************************/
 int shm_create() {
+	int fd;
+
 	/* Creación de la memoria compartida */
 	fd_shm = shm_open(SHM_MAP_NAME, O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
 
@@ -116,6 +323,24 @@ int shm_create() {
 		return -1;
 	}
 
+	/* Segmento de avisos: antes de la cabecera, que es lo que buscan los observadores.
+	 * Puede quedar uno de una partida que no terminó bien */
+	fd = shm_open(SHM_AVISOS_NAME, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+	if(fd == -1 || ftruncate(fd, sizeof(*avisos)) == -1 ||
+			(avisos = (uint32_t *)mmap(NULL, sizeof(*avisos), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+		printf("ERROR DE SIMULADOR: creando el segmento de avisos.\n");
+		if(fd != -1)
+			close(fd);
+		shm_unlink(SHM_AVISOS_NAME);
+		shm_unlink(SHM_MAP_NAME);
+		return -1;
+	}
+	close(fd);
+	mapa_set_avisos(avisos);
+
+	/* Páginas grandes y NUMA se deciden antes de tocar el segmento */
+	mapa_iniciar_cabecera(mapa, memoria_preparar(mapa, sizeof(*mapa)));
+
 	return 1;
 }
 
@@ -158,9 +383,9 @@ int pipe_read(int *fd, char *buffer) {
 /****************************************************************************/
 /* Funcion: manejador_SIGALRM                                               */
 /*                                                                          */
-/* Descripcion: rutina de tratamiento de la señal SIGALRM. Se encarga de    */
-/*		restaurar el mapa, comprobar si hay algún equipo ganador y enviar   */
-/*		los mensajes de nuevo turno a los procesos 'jefes' por las tuberías.*/
+/* Descripcion: rutina de tratamiento de la señal SIGALRM. Solo marca el    */
+/*		fin de turno; el bucle principal se encarga de procesarlo para no   */
+/*		modificar el mapa a medias de otra acción.                          */
 /*                                                                          */
 /* Parametros de entrada:                                                   */
 /*		int *sig: señal SIGALRM                                             */
@@ -168,23 +393,98 @@ int pipe_read(int *fd, char *buffer) {
 /* Parametros de salida: void                                               */
 /****************************************************************************/
 void manejador_SIGALRM(int sig) {
+	alrm_flag = true;
+}
+
+/****************************************************************************/
+/* Funcion: simulador_liberar                                               */
+/*                                                                          */
+/* Descripcion: libera la memoria compartida, la cola de mensajes, el       */
+/*		semáforo del monitor y los canales al terminar la partida.          */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/* Parametros de salida: void                                               */
+/****************************************************************************/
+void simulador_liberar() {
+	simulador_guardar_traza();
+	munmap(mapa, sizeof(*mapa));
+	shm_unlink(SHM_MAP_NAME);
+	munmap(avisos, sizeof(*avisos));
+	shm_unlink(SHM_AVISOS_NAME);
+	mq_close(queue);
+	mq_unlink(MQ_NAME);
+	sem_close(sem_ctrl);
+	sem_unlink(SEM_CTRL);
+	canal_destroy(canales, N_EQUIPOS * N_NAVES);
+	intencion_destroy(intenciones);
+	historial_destruir();
+}
+
+/****************************************************************************/
+/* Funcion: simulador_interrumpir                                           */
+/*                                                                          */
+/* Descripcion: termina la partida tras un SIGINT: muestra los tiempos de   */
+/*		las naves, vacía el registro, espera a los procesos hijos (la señal */
+/*		llega a todo el grupo), cierra el servidor y libera el resto de     */
+/*		recursos como al acabar la partida.                                 */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/* Parametros de salida: void (termina el proceso)                          */
+/****************************************************************************/
+void simulador_interrumpir() {
+	simulador_informe_tiempos();
+	registro_end();
+	while(wait(NULL) > 0);
+	servidor_cerrar();
+	simulador_liberar();
+	exit(EXIT_SUCCESS);
+}
+
+/****************************************************************************/
+/* Funcion: simulador_turno                                                 */
+/*                                                                          */
+/* Descripcion: fin de turno. Se encarga de resolver los movimientos del    */
+/*		turno, restaurar el mapa, comprobar si hay algún equipo ganador y   */
+/*		enviar los mensajes de nuevo turno a los procesos 'jefes' por las   */
+/*		tuberías.                                                           */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*                                                                          */
+/* Parametros de salida: void                                               */
+/****************************************************************************/
+void simulador_turno() {
 	char buffer[PIPE_MAXSIZE];
-	int campeon, flag = 0;
+	uint64_t t_turno = traza_inicio(), t_resolucion;
+
+	/* Anota las naves que no han decidido a tiempo en el turno que acaba */
+	simulador_puntualidad();
+
+	/* Aplica a la vez todos los movimientos del turno */
+	t_resolucion = traza_inicio();
+	resolucion_aplicar(mapa, turno);
+	traza_fin(TR_RESOLUCION, t_resolucion, turno, -1, -1, 0);
+
+	/* El historial guarda el turno con los disparos antes de borrarlos */
+	historial_guardar(mapa, turno);
+	turno++;
+	mapa->turno = turno;
 
 	/* Restaura el mapa dejando solo los símbolos que sean naves */
 	mapa_restore(mapa);
 
-	/* Comprueba si hay algún equipo ganador */
-	for(int i = 0; i < N_EQUIPOS; i++) {
-		if(mapa_get_num_naves(mapa, i) > 0) {
-			campeon = i;
-			flag++;
-		}
-	}
+	/* Las naves deciden el nuevo turno sobre una copia que ya no cambia */
+	mapa_vista_publicar(mapa, turno);
 
-	/* Si hay un equipo ganador, lo notifica y envía la orden 'FIN' a todos los procesos 'jefes' */
-	if(flag < 2) {
-		fprintf(stdout, "****** EQUIPO GANADOR %c *******\n", campeon+65);
+	/* Si hay un equipo ganador, lo notifica y envía la orden 'FIN' a todos los procesos 'jefes'.
+	 * En modo externo no hay jefes y la partida no termina */
+	if(!modo_externo && mapa_get_equipos_vivos(mapa) < 2) {
+		registro_end();
+		/* Si los últimos se destruyen a la vez no queda ningún equipo */
+		if(mapa_get_ganador(mapa) == '*')
+			fprintf(stdout, "****** SIN GANADOR *******\n");
+		else
+			fprintf(stdout, "****** EQUIPO GANADOR %c *******\n", mapa_get_ganador(mapa));
+		simulador_informe_tiempos();
 
 		sprintf(buffer, "FIN");
 		for(int i = 0; i < N_EQUIPOS; i++) {
@@ -198,26 +498,22 @@ void manejador_SIGALRM(int sig) {
 		
 		while(wait(NULL) > 0);
 
-		munmap(mapa, sizeof(*mapa));
-		shm_unlink(SHM_MAP_NAME);
-	    mq_close(queue);
-		mq_unlink(MQ_NAME);
-		sem_close(sem_ctrl);
-	    sem_unlink(SEM_CTRL);
-
+		simulador_liberar();
 		exit(EXIT_SUCCESS);
 	}
 
 	/* Si no hay un ganador, envía la orden 'TURNO' a los procesos 'jefes' */
-	fprintf(stdout, "\nNew TURNO\n");
+	registro_evento(EV_TURNO, turno);
 	sprintf(buffer, "TURNO");
-	for(int i = 0; i < N_EQUIPOS; i++) {
+	for(int i = 0; i < N_EQUIPOS && !modo_externo; i++) {
 		if(pipe_write(fd1[i], buffer) < 0) {
 			printf("ERROR DE SIMULADOR: escribiendo en la tubería.\n");
 			exit(EXIT_FAILURE);
 		}
 	}
 
+	traza_fin(TR_FIN_TURNO, t_turno, turno - 1, -1, -1, 0);
+
 	/* Vuelve a establecer la alarma */
 	alarm(TURNO_SECS);
 }
@@ -245,58 +541,6 @@ int manejador_SIGALRM_create(struct sigaction act){
     return 1;
 }
 
-/****************************************************************************/
-/* Funcion: accion_moverAleatorioY                                          */
-/*                                                                          */
-/* Descripcion: genera un número aleatorio para el moviemiento de una nave  */
-/* 		en la coordenada 'y'.                                               */
-/*                                                                          */
-/* Parametros de entrada:                                                   */
-/*		int posY: posición de la coordena 'y'                               */
-/* Parametros de salida: la posición de la coordenada 'y' a donde se        */
-/*		desplaza.                                                           */
-/****************************************************************************/
-int accion_moverAleatorioY(int posY) {
-	int maxY = 0, minY = 0;
-
-	maxY = posY + MOVER_ALCANCE;
-	minY = posY - MOVER_ALCANCE;
-
-	if(posY >= MAPA_MAXY - 1)
-		maxY = minY;
-	else if(posY <= 0)
-		minY = maxY;
-
-	srand(time(NULL)*getpid());
-	return (rand() % (maxY + 1 - minY)) + minY;
-}
-
-/****************************************************************************/
-/* Funcion: accion_moverAleatorioX                                          */
-/*                                                                          */
-/* Descripcion: genera un número aleatorio para el moviemiento de una nave  */
-/* 		en la coordenada 'x'.                                               */
-/*                                                                          */
-/* Parametros de entrada:                                                   */
-/*		int posY: posición de la coordena 'x'                               */
-/* Parametros de salida: la posición de la coordenada 'x' a donde se        */
-/*		desplaza.                                                           */
-/****************************************************************************/
-int accion_moverAleatorioX(int posX) {
-	int maxX = 0, minX = 0;
-
-	maxX = posX + MOVER_ALCANCE;
-	minX = posX - MOVER_ALCANCE;
-
-	if(posX >= MAPA_MAXX - 1)
-		maxX = minX;
-	else if(posX <= 0)
-		minX = maxX;
-
-	srand(time(NULL)*getpid());
-	return (rand() % (maxX + 1 - minX)) + minX;
-}
-
 /****************************************************************************/
 /* Funcion: simulador_update                                                */
 /*                                                                          */
@@ -311,76 +555,608 @@ int accion_moverAleatorioX(int posX) {
 void simulador_update(tipo_accion accion) {
 	char buffer[PIPE_MAXSIZE];
 	tipo_nave nave;
+	uint64_t t_accion = traza_inicio();
+
+	/* Las acciones pueden venir de procesos externos */
+	if(accion.equipo < 0 || accion.equipo >= N_EQUIPOS || accion.nave < 0 || accion.nave >= N_NAVES)
+		return;
+	if(accion.desY < 0 || accion.desY >= MAPA_MAXY || accion.desX < 0 || accion.desX >= MAPA_MAXX)
+		return;
+
 	nave = mapa_get_nave(mapa, accion.equipo, accion.nave);
 	
 	/* Puede ocurrir que otro proceso destruya esta nave en el mismo turno y quede algún mensaje en la cola */	
 	if(nave.viva == true) {
 		if(strcmp(accion.tipo, "ACCION MOVER") == 0) {
-			/* Con esta comprobación se pretende frenar los movimientos que invaden posiciones ocupadas */
-			if(mapa_is_casilla_vacia(mapa, accion.desY, accion.desY) == false) {
-				fprintf(stdout, "%s [%c%d] %d,%d -> %d,%d: fallo\n", accion.tipo, accion.equipo+65, accion.nave, accion.oriY, accion.oriX, accion.desY, accion.desX);
-			} else {
-				/* Si no está ocupada, se mueve a dicha posición */
-				tipo_casilla casilla;
-				casilla = mapa_get_casilla(mapa, accion.desY, accion.desX);
-				if(casilla.equipo < 0) {
-					mapa_clean_casilla(mapa, nave.posy, nave.posx);
-					nave.posy = accion.desY;
-					nave.posx = accion.desX;
-					mapa_set_nave(mapa, nave);
-					fprintf(stdout, "%s [%c%d] %d,%d -> %d,%d: éxito\n", accion.tipo, accion.equipo+65, accion.nave, accion.oriY, accion.oriX, accion.desY, accion.desX);
-				} else {
-					fprintf(stdout, "%s [%c%d] %d,%d -> %d,%d: fallo\n", accion.tipo, accion.equipo+65, accion.nave, accion.oriY, accion.oriX, accion.desY, accion.desX);
-				}
-			}
+			/* Los movimientos se resuelven todos juntos al final del turno */
+			resolucion_registrar(mapa, &accion);
 		} else if(strcmp(accion.tipo, "ACCION ATAQUE") == 0) {
 
 			/* Envía un misil */
 			mapa_send_misil(mapa, accion.oriY, accion.oriX, accion.desY, accion.desX);
 
 			tipo_casilla casilla;
-			casilla = mapa_get_casilla(mapa, accion.desY, accion.desX);
 
-			/* Si la casilla está vacía se marca como agua */
-			if(casilla.equipo == -1 || casilla.equipo == accion.equipo) {
+			/* Si en la casilla no hay enemigo se marca como agua */
+			if(!mapa_hay_enemigo(mapa, accion.equipo, accion.desY, accion.desX, 0)) {
 				mapa_set_symbol(mapa, accion.desY, accion.desX, SYMB_AGUA);
-				fprintf(stdout, "%s [%c%d] %d,%d -> %d,%d: FALLIDO: Casilla target vacia\n", accion.tipo, accion.equipo+65, accion.nave, accion.oriY, accion.oriX, accion.desY, accion.desX);
+				registro_evento(EV_ATAQUE_AGUA, symbol_equipos[accion.equipo], accion.nave, accion.oriY, accion.oriX, accion.desY, accion.desX);
 			} else {
 					
 				tipo_nave nave_enemiga;
+				casilla = mapa_get_casilla(mapa, accion.desY, accion.desX);
 				nave_enemiga = mapa_get_nave(mapa, casilla.equipo, casilla.numNave);
 				nave_enemiga.vida -= ATAQUE_DANO;
+				mapa_registrar_ataque(mapa, accion.equipo, ATAQUE_DANO, nave_enemiga.vida <= 0);
 				/* Se comprueba la vida y si es menor que cero se envía destruir la nave */
 				if(nave_enemiga.vida <= 0) {
 					nave_enemiga.viva = false;
 					mapa_set_nave(mapa, nave_enemiga);
 					mapa_set_symbol(mapa, nave_enemiga.posy, nave_enemiga.posx, SYMB_DESTRUIDO);
-					fprintf(stdout, "%s [%c%d] %d,%d -> %d,%d: target destruido\n", accion.tipo, accion.equipo+65, accion.nave, accion.oriY, accion.oriX, accion.desY, accion.desX);
+					registro_evento(EV_ATAQUE_DESTRUIDO, symbol_equipos[accion.equipo], accion.nave, accion.oriY, accion.oriX, accion.desY, accion.desX);
 					bzero(buffer, sizeof(buffer));
 					sprintf(buffer, "DESTRUIR <%d>", nave_enemiga.numNave);
-					if(pipe_write(fd1[nave_enemiga.equipo], buffer) < 0) {
+					if(!modo_externo && pipe_write(fd1[nave_enemiga.equipo], buffer) < 0) {
 						printf("ERROR DE SIMULADOR: escribiendo en la tubería.\n");
 						exit(EXIT_FAILURE);
 					}
 				} else {
 					/* Si no se marca como tocado */
 					mapa_set_nave(mapa, nave_enemiga);
-					fprintf(stdout, "%s [%c%d] %d,%d -> %d,%d: target a %d de vida\n", accion.tipo, accion.equipo+65, accion.nave, accion.oriY, accion.oriX, accion.desY, accion.desX, nave_enemiga.vida);
+					registro_evento(EV_ATAQUE_TOCADO, symbol_equipos[accion.equipo], accion.nave, accion.oriY, accion.oriX, accion.desY, accion.desX, nave_enemiga.vida);
 					mapa_set_symbol(mapa, nave_enemiga.posy, nave_enemiga.posx, SYMB_TOCADO);
 				}
 
 			}
 		}
 	}
+
+	/* El dato del intervalo es lo que la acción ha esperado desde que se envió */
+	traza_fin(TR_ACCION, t_accion, turno, accion.equipo, accion.nave,
+		(accion.t_envio > 0 && t_accion > accion.t_envio) ? (int)((t_accion - accion.t_envio) / 1000) : 0);
 }
 
+/****************************************************************************/
+/* Funcion: simulador_ms_desde                                              */
+/*                                                                          */
+/* Descripcion: calcula los milisegundos transcurridos desde un instante.   */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		struct timespec *inicio: instante de referencia (CLOCK_MONOTONIC)   */
+/* Parametros de salida: milisegundos transcurridos.                        */
+/****************************************************************************/
+double simulador_ms_desde(struct timespec *inicio) {
+	struct timespec ahora;
 
-int main() {
+	clock_gettime(CLOCK_MONOTONIC, &ahora);
+	return (ahora.tv_sec - inicio->tv_sec) * 1e3 + (ahora.tv_nsec - inicio->tv_nsec) / 1e6;
+}
+
+/****************************************************************************/
+/* Funcion: simulador_esperar_naves                                         */
+/*                                                                          */
+/* Descripcion: espera a que todos los procesos nave estén listos para      */
+/*		recibir órdenes. Como máximo espera lo que antes se dormía de forma */
+/*		fija (TURNO_SECS+1 segundos).                                       */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/* Parametros de salida: void                                               */
+/****************************************************************************/
+void simulador_esperar_naves() {
+	struct timespec limite;
+
+	clock_gettime(CLOCK_REALTIME, &limite);
+	limite.tv_sec += TURNO_SECS + 1;
+
+	while(sem_timedwait(&mapa->sem_listas, &limite) < 0) {
+		if(int_flag)
+			return;
+		if(errno != EINTR) {
+			printf("AVISO DE SIMULADOR: solo %d de %d naves listas.\n", mapa->naves_listas, N_EQUIPOS * N_NAVES);
+			return;
+		}
+	}
+}
+
+/****************************************************************************/
+/* Funcion: simulador_intencion                                             */
+/*                                                                          */
+/* Descripcion: pasa al planificador las acciones de la intención recogida  */
+/*		de una nave. De cada nave se acepta una intención por turno; otra   */
+/*		del mismo turno llega repetida (p. ej. órdenes del jefe atrasadas)  */
+/*		y se descarta. Las que la nave sustituyó antes de que se recogieran */
+/*		no llegan aquí: se cuentan por la diferencia con las publicadas.    */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		tipo_intencion *in: copia de la intención                           */
+/* Parametros de salida: void                                               */
+/****************************************************************************/
+void simulador_intencion(tipo_intencion *in) {
+	tipo_tiempos_nave *t = &mapa->tiempos[in->equipo][in->nave];
+
+	t->recogidas += in->num_acciones;
+	t->sustituidas = in->publicadas - t->recogidas;
+
+	/* Una acción descartada cuenta como procesada para quien espera su efecto */
+	if(in->turno == t->turno_recogido) {
+		t->descartadas += in->num_acciones;
+		__atomic_store_n(&mapa->acciones_procesadas, mapa->acciones_procesadas + in->num_acciones, __ATOMIC_RELEASE);
+		return;
+	}
+	t->turno_recogido = in->turno;
+
+	for(int k = 0; k < in->num_acciones; k++) {
+		registro_evento(EV_RECIBIDO);
+		if(!simulador_a_tiempo(&in->acciones[k]) || !planificador_encolar(mapa, &in->acciones[k], turno))
+			__atomic_store_n(&mapa->acciones_procesadas, mapa->acciones_procesadas + 1, __ATOMIC_RELEASE);
+	}
+}
+
+/****************************************************************************/
+/* Funcion: simulador_recibir                                               */
+/*                                                                          */
+/* Descripcion: pasa al planificador las intenciones de las naves y los     */
+/*		mensajes de la cola (procesos externos). Si no hay acciones         */
+/*		pendientes espera como mucho SIM_REFRESH a la primera: a una        */
+/*		intención con equipos y a un mensaje de la cola en modo externo; el */
+/*		resto se recoge sin esperar.                                        */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/* Parametros de salida: void                                               */
+/****************************************************************************/
+void simulador_recibir() {
+	static tipo_intencion copias[N_EQUIPOS * N_NAVES];
+	struct timespec limite = {0, 0};
+	tipo_accion accion;
+	uint32_t avisos;
+	int i, num;
+
+	if(!modo_externo) {
+		avisos = intencion_avisos(intenciones);
+		num = intencion_recoger(intenciones, copias, N_EQUIPOS * N_NAVES);
+		if(num == 0 && planificador_pendientes() == 0 && intencion_esperar(intenciones, avisos, SIM_REFRESH))
+			num = intencion_recoger(intenciones, copias, N_EQUIPOS * N_NAVES);
+		for(i = 0; i < num; i++)
+			simulador_intencion(&copias[i]);
+	} else if(planificador_pendientes() == 0) {
+		clock_gettime(CLOCK_REALTIME, &limite);
+		limite.tv_nsec += SIM_REFRESH * 1000L;
+		if(limite.tv_nsec >= 1000000000L) {
+			limite.tv_sec++;
+			limite.tv_nsec -= 1000000000L;
+		}
+	}
+
+	/* Con un límite ya vencido mq_timedreceive solo devuelve lo que hay en la cola */
+	for(i = 0; i < N_EQUIPOS * N_NAVES; i++) {
+		memset(&accion, 0, sizeof(accion));
+		if(mq_timedreceive(queue, (char*)&accion, QUEUE_MAXSIZE, NULL, &limite) < 0)
+			return;
+		registro_evento(EV_RECIBIDO);
+		/* Una acción descartada cuenta como procesada para quien espera su efecto */
+		if(!simulador_a_tiempo(&accion) || !planificador_encolar(mapa, &accion, turno))
+			__atomic_store_n(&mapa->acciones_procesadas, mapa->acciones_procesadas + 1, __ATOMIC_RELEASE);
+		limite.tv_sec = 0;
+		limite.tv_nsec = 0;
+	}
+}
+
+/****************************************************************************/
+/* Funcion: simulador_aplicar_turno                                         */
+/*                                                                          */
+/* Descripcion: cierra un turno de la partida sin procesos o del modo       */
+/*		servidor: aplica todas las acciones encoladas, resuelve los         */
+/*		movimientos, lo guarda en el historial y restaura el mapa.          */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/* Parametros de salida: void                                               */
+/****************************************************************************/
+void simulador_aplicar_turno() {
+	tipo_accion accion;
+	unsigned long num_acciones = 0;
+	uint64_t t_resolucion;
+	struct timespec fase;
+
+	clock_gettime(CLOCK_MONOTONIC, &fase);
+	while(planificador_despachar(mapa, &accion)) {
+		simulador_update(accion);
+		num_acciones++;
+	}
+	__atomic_store_n(&mapa->acciones_procesadas, mapa->acciones_procesadas + num_acciones, __ATOMIC_RELEASE);
+	ms_aplicacion += simulador_ms_desde(&fase);
+
+	clock_gettime(CLOCK_MONOTONIC, &fase);
+	t_resolucion = traza_inicio();
+	resolucion_aplicar(mapa, turno);
+	traza_fin(TR_RESOLUCION, t_resolucion, turno, -1, -1, 0);
+	ms_resolucion += simulador_ms_desde(&fase);
+	historial_guardar(mapa, turno);
+	turno++;
+	mapa->turno = turno;
+	mapa_restore(mapa);
+	registro_evento(EV_TURNO, turno);
+}
+
+/****************************************************************************/
+/* Funcion: simulador_decidir                                               */
+/*                                                                          */
+/* Descripcion: todas las naves vivas de la vista deciden con nave_decidir  */
+/*		y sus acciones se guardan en uno de los dos lotes.                  */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		const tipo_vista *vista: vista sobre la que se decide               */
+/*		int lote: lote de destino (0 o 1)                                   */
+/*		bool trazar: si se anota cada decisión en las trazas, que solo      */
+/*			puede escribir el hilo principal                                */
+/* Parametros de salida: void                                               */
+/****************************************************************************/
+void simulador_decidir(const tipo_vista *vista, int lote, bool trazar) {
+	struct timespec fase;
+	uint64_t t_decision = 0;
+	int num = 0, n;
+
+	clock_gettime(CLOCK_MONOTONIC, &fase);
+	for(int i = 0; i < N_EQUIPOS; i++) {
+		for(int k = 0, j; k < mapa_vista_num_vivas(vista, i); k++) {
+			j = vista->vivas[i][k];
+			if(trazar)
+				t_decision = traza_inicio();
+			n = nave_decidir(vista, i, j, &lotes[lote][num]);
+			if(trazar)
+				traza_fin(TR_DECISION, t_decision, vista->turno, i, j, n);
+			num += n;
+		}
+	}
+	lotes_num[lote] = num;
+	ms_decision += simulador_ms_desde(&fase);
+}
+
+/****************************************************************************/
+/* Funcion: simulador_decisor                                               */
+/*                                                                          */
+/* Descripcion: hilo decisor de la partida en tubería. Con cada orden       */
+/*		decide sobre vista_decisor en lote_decisor y avisa al terminar.     */
+/*		Es el único que llama a rand() mientras dura la partida, así que    */
+/*		el resultado con una semilla sigue siendo siempre el mismo.         */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		void *arg: no se usa                                                */
+/* Parametros de salida: NULL                                               */
+/****************************************************************************/
+void *simulador_decisor(void *arg) {
+	while(1) {
+		while(sem_wait(&sem_decidir) < 0);
+		if(fin_decisor)
+			return NULL;
+		simulador_decidir(vista_decisor, lote_decisor, false);
+		sem_post(&sem_decidido);
+	}
+}
+
+/****************************************************************************/
+/* Funcion: simulador_vigente                                               */
+/*                                                                          */
+/* Descripcion: en tubería las acciones se deciden sobre la vista del turno */
+/*		anterior. Comprueba que la nave sigue viva y en la casilla desde la */
+/*		que decidió; si no, la acción ya no es suya y se descarta.          */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		tipo_accion *accion: acción decidida                                */
+/* Parametros de salida: true si la acción sigue valiendo.                  */
+/****************************************************************************/
+bool simulador_vigente(tipo_accion *accion) {
+	tipo_nave nave = mapa_get_nave(mapa, accion->equipo, accion->nave);
+
+	if(nave.viva && nave.posy == accion->oriY && nave.posx == accion->oriX)
+		return true;
+	mapa->tiempos[accion->equipo][accion->nave].descartadas++;
+	return false;
+}
+
+/****************************************************************************/
+/* Funcion: simulador_partida                                               */
+/*                                                                          */
+/* Descripcion: juega una partida completa sin procesos jefe ni nave, sin   */
+/*		alarmas y sin pausas. En cada turno todas las naves vivas deciden   */
+/*		con nave_decidir, sus acciones pasan por el planificador y el turno */
+/*		se cierra en cuanto se han aplicado. Con la misma semilla y el      */
+/*		mismo tamaño de mapa la partida es siempre la misma, por lo que     */
+/*		sirve para medir el rendimiento y para entrenar la compilación PGO. */
+/*		Al terminar escribe el hash del estado final y el tiempo medio por  */
+/*		turno de cada fase, que comprueba bench/regresion.sh.               */
+/*                                                                          */
+/*		En tubería un hilo decide el turno N+1 sobre la vista publicada al  */
+/*		empezar el turno N mientras el hilo principal aplica y resuelve el  */
+/*		turno N en el mapa (la vista siguiente se escribe en el otro buffer */
+/*		de la vista). Las acciones llegan con un turno de retraso: las de   */
+/*		una nave que ya se ha movido o ya ha sido destruida se descartan    */
+/*		antes de encolarlas (simulador_vigente). La partida es otra, igual  */
+/*		de reproducible con la misma semilla.                               */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		unsigned int semilla: semilla de los números aleatorios             */
+/*		int max_turnos: turnos tras los que la partida termina sin ganador  */
+/*		bool tuberia: si se decide un turno mientras se aplica el anterior  */
+/* Parametros de salida: void (termina el proceso)                          */
+/****************************************************************************/
+void simulador_partida(unsigned int semilla, int max_turnos, bool tuberia) {
+	struct timespec inicio, fase;
+	const tipo_vista *vista;
+	pthread_t decisor;
+	uint32_t secuencia;
+	double ms, ms_espera = 0;
+	int lote;
+
+	srand(semilla);
+	if(tuberia && (sem_init(&sem_decidir, 0, 0) < 0 || sem_init(&sem_decidido, 0, 0) < 0 ||
+			pthread_create(&decisor, NULL, simulador_decisor, NULL) != 0)) {
+		printf("ERROR DE SIMULADOR: creando el hilo decisor.\n");
+		simulador_liberar();
+		exit(EXIT_FAILURE);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &inicio);
+
+	/* En tubería el primer lote se decide antes de empezar, como sin ella */
+	mapa_vista_publicar(mapa, turno);
+	vista = mapa_vista_obtener(mapa, &secuencia);
+	if(tuberia)
+		simulador_decidir(vista, 0, true);
+
+	while(turno < max_turnos && mapa_get_equipos_vivos(mapa) >= 2 && !int_flag) {
+		lote = turno % 2;
+		if(tuberia) {
+			/* El hilo decide el turno siguiente sobre la vista de este mientras se aplica */
+			vista_decisor = vista;
+			lote_decisor = 1 - lote;
+			sem_post(&sem_decidir);
+		} else {
+			/* Cada nave viva recibe la orden de su jefe y decide sobre la vista del turno */
+			simulador_decidir(vista, lote, true);
+		}
+
+		for(int k = 0; k < lotes_num[lote]; k++)
+			if(!tuberia || simulador_vigente(&lotes[lote][k]))
+				planificador_encolar(mapa, &lotes[lote][k], turno);
+		simulador_aplicar_turno();
+		mapa_vista_publicar(mapa, turno);
+		vista = mapa_vista_obtener(mapa, &secuencia);
+
+		if(tuberia) {
+			clock_gettime(CLOCK_MONOTONIC, &fase);
+			while(sem_wait(&sem_decidido) < 0);
+			ms_espera += simulador_ms_desde(&fase);
+		}
+	}
+
+	ms = simulador_ms_desde(&inicio);
+	if(tuberia) {
+		fin_decisor = true;
+		sem_post(&sem_decidir);
+		pthread_join(decisor, NULL);
+	}
+	if(int_flag)
+		simulador_interrumpir();
+	registro_end();
+	fprintf(stdout, "Partida sin procesos: semilla %u, %d turnos, %lu acciones en %.3f ms (%.1f turnos/s), ganador %c\n",
+		semilla, turno, mapa->acciones_procesadas, ms, turno / (ms / 1e3), mapa_get_ganador(mapa));
+	fprintf(stdout, "Estado final %016llx\n", (unsigned long long)mapa_hash(mapa));
+	if(turno > 0)
+		fprintf(stdout, "Fases por turno: decision %.2f us, aplicacion %.2f us, resolucion %.2f us\n",
+			ms_decision * 1e3 / turno, ms_aplicacion * 1e3 / turno, ms_resolucion * 1e3 / turno);
+	if(tuberia && turno > 0)
+		fprintf(stdout, "Tubería: el hilo principal espera %.2f us por turno a las decisiones\n", ms_espera * 1e3 / turno);
+
+	simulador_liberar();
+	exit(EXIT_SUCCESS);
+}
+
+/****************************************************************************/
+/* Funcion: simulador_servidor                                              */
+/*                                                                          */
+/* Descripcion: juega la partida con los equipos como clientes externos     */
+/*		('equipo') conectados por un socket. Cada turno publica la vista,   */
+/*		envía a cada equipo lo que ha cambiado, recoge sus acciones hasta   */
+/*		que responden todos o vencen sus plazos y cierra el turno. La       */
+/*		partida acaba con un ganador, al llegar a max_turnos o si se        */
+/*		desconectan todos los equipos.                                      */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		char *direccion: ruta Unix o [host:]puerto TCP de escucha           */
+/*		int limite_ms: plazo de cada equipo para responder a un turno       */
+/*		int max_turnos: turnos tras los que la partida termina sin ganador  */
+/* Parametros de salida: void (termina el proceso)                          */
+/****************************************************************************/
+void simulador_servidor(char *direccion, int limite_ms, int max_turnos) {
+	struct timespec inicio;
+	const tipo_vista *vista;
+	uint32_t secuencia;
+	double ms;
+
+	if(servidor_crear(direccion, limite_ms) < 0) {
+		printf("ERROR DE SIMULADOR: escuchando en %s.\n", direccion);
+		simulador_liberar();
+		exit(EXIT_FAILURE);
+	}
+	fprintf(stdout, "Servidor: esperando %d equipos en %s\n", N_EQUIPOS, direccion);
+	fflush(stdout);
+	if(servidor_aceptar() < 0) {
+		if(int_flag)
+			simulador_interrumpir();
+		printf("ERROR DE SIMULADOR: aceptando a los equipos.\n");
+		servidor_cerrar();
+		simulador_liberar();
+		exit(EXIT_FAILURE);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &inicio);
+	while(turno < max_turnos && mapa_get_equipos_vivos(mapa) >= 2 && servidor_conectados() > 0 && !int_flag) {
+		mapa_vista_publicar(mapa, turno);
+		vista = mapa_vista_obtener(mapa, &secuencia);
+		servidor_turno(vista);
+		servidor_recibir(mapa, turno);
+		simulador_aplicar_turno();
+	}
+
+	if(int_flag)
+		simulador_interrumpir();
+	ms = simulador_ms_desde(&inicio);
+	registro_end();
+	fprintf(stdout, "Partida en red: %d turnos, %lu acciones en %.3f ms (%.1f turnos/s), ganador %c\n",
+		turno, mapa->acciones_procesadas, ms, turno / (ms / 1e3), mapa_get_ganador(mapa));
+	servidor_fin(turno, mapa_get_ganador(mapa));
+
+	simulador_liberar();
+	exit(EXIT_SUCCESS);
+}
+
+/****************************************************************************/
+/* Funcion: simulador_uso                                                   */
+/*                                                                          */
+/* Descripcion: muestra las opciones del simulador y termina.               */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		char *nombre: nombre del programa                                   */
+/* Parametros de salida: void                                               */
+/****************************************************************************/
+void simulador_uso(char *nombre) {
+	printf("Uso: %s [-v nivel] [-l fichero] [-e] [-s] [-q quantum] [-f] [-m paginas] [-n numa] [-c cpus] [-w cpus] [-F prioridad] [-T fichero] [-R fichero] [-P ms] [-H semilla [-p] | -S direccion [-D ms]] [-t turnos]\n", nombre);
+	printf("  -v nivel    detalle del registro: 0 errores, 1 acciones (defecto), 2 cola de mensajes;\n");
+	printf("              con la partida en marcha, SIGUSR1 al simulador pasa al nivel siguiente\n");
+	printf("  -l fichero  guarda el registro en binario (ver 'registro') en lugar de mostrarlo\n");
+	printf("  -e          modo externo: no crea equipos, las acciones llegan de otros procesos\n");
+	printf("  -s          sin pausas: sin animación de misiles ni espera entre acciones\n");
+	printf("  -q quantum  acciones seguidas que se atienden de cada equipo (defecto %d)\n", PLAN_QUANTUM);
+	printf("  -f          sin prioridad de ataques: cada equipo se atiende en orden de llegada\n");
+	printf("  -m paginas  páginas del segmento del mapa: normales (defecto) o grandes\n");
+	printf("  -n numa     colocación NUMA del mapa: intercalar, trozos (uno por nodo) o número de nodo\n");
+	printf("  -c cpus     CPUs del simulador (p. ej. 0 o 0,2-3)\n");
+	printf("  -w cpus     CPUs de jefes y naves; con '/' un conjunto por equipo (p. ej. 2-3/4-5)\n");
+	printf("  -F prioridad  el bucle del simulador en SCHED_FIFO con esa prioridad\n");
+	printf("  -T fichero  guarda trazas de los intervalos de todos los procesos (ver 'traza')\n");
+	printf("  -R fichero  guarda el historial de turnos del monitor en un fichero en lugar de en memoria;\n");
+	printf("              con -H o -S solo hay historial si se da esta opción\n");
+	printf("  -P ms       plazo de cada nave para decidir en un turno, 0 sin plazo (defecto %d)\n", NAVE_PLAZO_MS);
+	printf("  -H semilla  partida sin procesos ni pausas, reproducible con la semilla; muestra turnos/s\n");
+	printf("  -p          con -H, en tubería: se decide cada turno mientras se aplica el anterior (un turno de retraso; se\n");
+	printf("              descartan las acciones de las naves que se han movido o destruido entretanto)\n");
+	printf("  -S direccion  modo servidor: los equipos son clientes 'equipo' conectados a una ruta Unix o [host:]puerto TCP\n");
+	printf("  -D ms       plazo de cada equipo para responder a un turno en modo servidor (defecto %d)\n", SERVIDOR_LIMITE_MS);
+	printf("  -t turnos   máximo de turnos de la partida sin procesos o en red (defecto %d);\n", PARTIDA_MAX_TURNOS);
+	printf("              si acaba sin ganador (por turnos o sin equipos vivos) se muestra 'ganador *'\n");
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[]) {
 
 	pid_t PIDjefe, PIDnave;
-	struct sigaction act_SIGINT, act_SIGALRM;
-	int pipe_status;
+	struct sigaction act_SIGINT, act_SIGALRM, act_SIGUSR1;
+	int pipe_status, opt;
 	char buffer[PIPE_MAXSIZE];
+	int nivel_registro = REG_INFO;
+	char *fichero_registro = NULL;
+	int quantum = PLAN_QUANTUM;
+	bool ataques_primero = true;
+	char *paginas = NULL, *numa = NULL;
+	char *cpus_simulador = NULL, *cpus_trabajadores = NULL;
+	int prioridad = 0;
+	char *fichero_historial = NULL;
+	char *direccion_servidor = NULL;
+	int limite_ms = SERVIDOR_LIMITE_MS;
+	int plazo_ms = NAVE_PLAZO_MS;
+	long semilla = -1;
+	bool tuberia = false;
+	int max_turnos = PARTIDA_MAX_TURNOS;
+
+	while((opt = getopt(argc, argv, "v:l:esq:fm:n:c:w:F:T:R:P:H:pS:D:t:")) != -1) {
+		switch(opt) {
+			case 'v':
+				nivel_registro = atoi(optarg);
+				break;
+			case 'l':
+				fichero_registro = optarg;
+				break;
+			case 'e':
+				modo_externo = true;
+				break;
+			case 's':
+				sin_pausas = true;
+				mapa_set_animacion(false);
+				break;
+			case 'q':
+				quantum = atoi(optarg);
+				break;
+			case 'f':
+				ataques_primero = false;
+				break;
+			case 'm':
+				paginas = optarg;
+				break;
+			case 'n':
+				numa = optarg;
+				break;
+			case 'c':
+				cpus_simulador = optarg;
+				break;
+			case 'w':
+				cpus_trabajadores = optarg;
+				break;
+			case 'F':
+				prioridad = atoi(optarg);
+				break;
+			case 'T':
+				fichero_traza = optarg;
+				break;
+			case 'R':
+				fichero_historial = optarg;
+				break;
+			case 'H':
+				/* Sin procesos: como el modo externo, pero las acciones se deciden dentro */
+				semilla = strtoul(optarg, NULL, 10);
+				modo_externo = true;
+				sin_pausas = true;
+				mapa_set_animacion(false);
+				break;
+			case 'p':
+				tuberia = true;
+				break;
+			case 'S':
+				/* Los equipos llegan por el socket: sin procesos y sin pausas */
+				direccion_servidor = optarg;
+				modo_externo = true;
+				sin_pausas = true;
+				mapa_set_animacion(false);
+				break;
+			case 'D':
+				limite_ms = atoi(optarg);
+				break;
+			case 'P':
+				plazo_ms = atoi(optarg);
+				break;
+			case 't':
+				max_turnos = atoi(optarg);
+				break;
+			default:
+				simulador_uso(argv[0]);
+		}
+	}
+	if(tuberia && semilla < 0) {
+		printf("ERROR DE SIMULADOR: -p solo vale para la partida sin procesos (-H).\n");
+		simulador_uso(argv[0]);
+	}
+	/* SIGUSR1 recorre los niveles desde este: tiene que ser uno de ellos */
+	if(nivel_registro < REG_ERROR || nivel_registro > REG_DEBUG) {
+		printf("AVISO DE SIMULADOR: el nivel del registro va de %d a %d.\n", REG_ERROR, REG_DEBUG);
+		nivel_registro = (nivel_registro < REG_ERROR) ? REG_ERROR : REG_DEBUG;
+	}
+	planificador_config(quantum, ataques_primero);
+	if(memoria_config(paginas, numa) < 0 || afinidad_config(cpus_simulador, cpus_trabajadores, prioridad) < 0)
+		simulador_uso(argv[0]);
+
+	/* Los buffers de trazas se heredan, así que se crean antes que los procesos */
+	if(fichero_traza != NULL && traza_crear() < 0) {
+		printf("ERROR DE SIMULADOR: creando el segmento de trazas.\n");
+		exit(EXIT_FAILURE);
+	}
 
 	/* Se establecen los atributos de la cola de mensajes */
 	struct mq_attr attributes = {
@@ -390,6 +1166,8 @@ int main() {
 		.mq_msgsize = QUEUE_MAXSIZE
 	};
 
+	clock_gettime(CLOCK_MONOTONIC, &t_arranque);
+
 	/* Se crea la cola de mensajes */
 	fprintf(stdout, "Simulador gestionando MQ\n");
 	queue = mq_open(MQ_NAME, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR, &attributes);
@@ -404,6 +1182,19 @@ int main() {
 		exit(EXIT_FAILURE);
 	}
 
+	/* Historial de turnos para que el monitor pueda volver atrás. Sin procesos o en red
+	 * (partidas para medir o jugar a toda velocidad) solo se guarda si se pide con -R */
+	if((semilla < 0 && direccion_servidor == NULL) || fichero_historial != NULL) {
+		fprintf(stdout, "Simulador gestionando el historial\n");
+		if(historial_crear(fichero_historial) < 0) {
+			printf("ERROR DE SIMULADOR: creando el historial de turnos.\n");
+			shm_unlink(SHM_MAP_NAME);
+			shm_unlink(SHM_AVISOS_NAME);
+			mq_unlink(MQ_NAME);
+			exit(EXIT_FAILURE);
+		}
+	}
+
 	/* Semáforo de control para gestionar el mapa */
 	fprintf(stdout, "Simulador gestionando SEM (control)\n");
 	if ((sem_ctrl = sem_open(SEM_CTRL, O_CREAT, S_IRUSR | S_IWUSR, 0)) == SEM_FAILED) {
@@ -431,7 +1222,50 @@ int main() {
 		}
 	}
 
-	for(int i = 0; i < N_EQUIPOS; i++) {
+	/* Coloca todas las naves en el mapa antes de crear ningún proceso */
+	if(colocacion_repartir(mapa) < 0) {
+		shm_unlink(SHM_MAP_NAME);
+		shm_unlink(SHM_AVISOS_NAME);
+		mq_unlink(MQ_NAME);
+		sem_unlink(SEM_CTRL);
+		exit(EXIT_FAILURE);
+	}
+
+	memoria_informe(mapa, sizeof(*mapa));
+
+	/* Plazo de las naves para decidir cada turno; las acciones de fuera no lo tienen */
+	mapa->plazo_ns = (modo_externo || plazo_ms <= 0) ? 0 : (uint64_t)plazo_ms * 1000000ULL;
+	for(int i = 0; i < N_EQUIPOS; i++)
+		for(int j = 0; j < N_NAVES; j++) {
+			mapa->tiempos[i][j].turno = -1;
+			mapa->tiempos[i][j].turno_recogido = -1;
+		}
+
+	/* Contador de naves listas para recibir el primer turno */
+	mapa->naves_listas = 0;
+	if(sem_init(&mapa->sem_listas, 1, 0) < 0) {
+		printf("ERROR DE SIMULADOR: creando el semaforo de naves listas.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	/* Creación de todos los canales JEFES-NAVES de una sola vez */
+	fprintf(stdout, "Simulador gestionando CANALES (Jefes-Naves)\n");
+	canales = canal_create(N_EQUIPOS * N_NAVES);
+	if(canales == NULL) {
+		printf("ERROR DE SIMULADOR: creando los canales JEFES-NAVES.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	/* Intenciones de las naves: la última decisión de cada una para el simulador */
+	intenciones = intencion_create();
+	if(intenciones == NULL) {
+		printf("ERROR DE SIMULADOR: creando las intenciones de las naves.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	fflush(stdout);
+
+	for(int i = 0; i < N_EQUIPOS && !modo_externo; i++) {
 		PIDjefe = fork();
         if(PIDjefe < 0) {
             printf("ERROR DE SIMULADOR: creando el EQUIPO <%d>.\n", i);
@@ -440,21 +1274,14 @@ int main() {
 
         else if(PIDjefe == 0) {
 
-        	int fd2[N_NAVES][2];
+        	tipo_canal *fd2 = &canales[i * N_NAVES];
         	int pid_naves[N_NAVES];
-			int pipe_status;
-
-		    /* Creación de la tubería SIMULADOR-JEFES */
-		    for(int i = 0; i < N_NAVES; i++) {
-			    pipe_status = pipe(fd2[i]);
-				if(pipe_status == -1) {
-					printf("ERROR DE JEFE: creando la tuberia JEFES-NAVES.\n");
-					exit(EXIT_FAILURE);
-				}
-			}
+        	bool viva[N_NAVES];
+        	int num_vivas = N_NAVES, destruida;
+        	uint64_t t_relevo;
 
-			/* Ajustar el número de naves de cada equipo */
-			mapa_set_num_naves(mapa, i, N_NAVES);
+        	traza_proceso(TRAZA_JEFE(i));
+        	afinidad_equipo(i, symbol_equipos[i]);
 
         	for(int j = 0; j < N_NAVES; j++) {
 
@@ -468,100 +1295,80 @@ int main() {
 
 		        	struct sigaction act_SIGTERM;
 
+		        	/* Cada nave tiene su propia secuencia de números aleatorios */
+		        	srand(time(NULL) * getpid());
+		        	traza_proceso(TRAZA_NAVE(i, j));
+
 					/* Creación del manejador encargado de capturar SIGTERM */
 					if(manejador_SIGTERM_create(act_SIGTERM) < 0) {
 					    printf("ERROR DE NAVE: creando el manejador_SIGTERM.\n");
 					    exit(EXIT_FAILURE);
 					}
 
-					/* Creación de una nave */
-		        	tipo_nave *nave = nave_create(i, j);
-		        	if(nave == NULL) {
-		        		printf("ERROR DE NAVE: creando la estructura nave.\n");
-						exit(EXIT_FAILURE);
-		        	}
-
-		        	mapa_set_nave(mapa, *nave);
+					/* La última nave en estar lista avisa al simulador */
+					if(__atomic_add_fetch(&mapa->naves_listas, 1, __ATOMIC_SEQ_CST) == N_EQUIPOS * N_NAVES) {
+						sem_post(&mapa->sem_listas);
+					}
 
-		        	int flag = 1;
+		        	sigset_t bloqueo;
+		        	sigemptyset(&bloqueo);
+		        	sigaddset(&bloqueo, SIGTERM);
 		        	while(1) {
 
 		        		bzero(buffer, sizeof(buffer));
-		        		if(pipe_read(fd2[j], buffer) < 0) {
-						 	printf("ERROR DE NAVE: leyendo del pipe con el jefe.\n");
+		        		if(canal_read(&fd2[j], buffer) < 0) {
+						 	printf("ERROR DE NAVE: leyendo del canal con el jefe.\n");
 						 	exit(EXIT_FAILURE);
 						}
 
-						if(flag) {
-							tipo_accion accion;
-							tipo_nave nave_aux;
-
-							nave_aux = mapa_get_nave(mapa, i, j);
-							nave = &nave_aux;
-
-							if(strcmp(buffer, "DESTRUIR") == 0) {
-								mapa_set_num_naves(mapa, i, mapa_get_num_naves(mapa, i) - 1);
-								flag = 0;
-
-							} else if(strcmp(buffer, "ACCION ATAQUE") == 0) {
-								tipo_nave nave_enemiga;
-
-								nave_enemiga.equipo = -1;
-
-								/* Si la nave se encunetra en posición de atacar */
-								nave_enemiga = nave_atacar(mapa, nave, i);
-								if(nave_enemiga.equipo != -1) {
-									strcpy(accion.tipo, buffer);
-									accion.equipo = i;
-									accion.nave = j;
-									accion.oriY = nave->posy;
-									accion.oriX = nave->posx;
-									accion.desY = nave_enemiga.posy;
-									accion.desX = nave_enemiga.posx;
-
-									if(mq_send(queue, (char*)&accion, sizeof(accion), 1) == -1) {
-										printf("ERROR DE NAVE: enviando mensaje por la cola de mensajes\n");
-										exit(EXIT_FAILURE);
-									}
-							    } else {
-							    	/* Si no, realiza un movimiento hacia un enemigo */
-							    	strcpy(accion.tipo, "ACCION MOVER");
-
-							    	nave_enemiga = nave_rastrear(mapa, nave, i);
-							    	accion.equipo = i;
-									accion.nave = j;
-									accion.oriY = nave->posy;
-									accion.oriX = nave->posx;
-							    	if(nave_enemiga.equipo != -1) {
-										accion.desY = nave->posy + nave_seguirY(nave, nave_enemiga);
-										accion.desX = nave->posx + nave_seguirX(nave, nave_enemiga);
-									} else {
-										accion.desY = nave->posy;
-										accion.desX = nave->posx;
-									}
-
-									if(mq_send(queue, (char*)&accion, sizeof(accion), 1) == -1) {
-										printf("ERROR DE NAVE: enviando mensaje por la cola de mensajes\n");
-										exit(EXIT_FAILURE);
-									}
-							    }
-							} 
-							/* Realiza un movimiento aleatorio */
-							strcpy(accion.tipo, "ACCION MOVER");
-							accion.equipo = i;
-							accion.nave = j;
-							accion.oriY = nave->posy;
-							accion.oriX = nave->posx;
-							int aleatY = accion_moverAleatorioY(accion.desY);
-							int aleatX = accion_moverAleatorioX(accion.desX);
-							if(mapa_is_casilla_vacia(mapa, aleatY, aleatX) == true) {
-								accion.desY = aleatY;
-								accion.desX = aleatX;
-							} 
-							
-							if(mq_send(queue, (char*)&accion, sizeof(accion), 1) == -1) {
-								printf("ERROR DE NAVE: enviando mensaje por la cola de mensajes\n");
-								exit(EXIT_FAILURE);
+						if(strcmp(buffer, "ACCION ATAQUE") == 0) {
+							tipo_accion acciones[NAVE_MAX_ACCIONES];
+							tipo_tiempos_nave *tiempos = &mapa->tiempos[i][j];
+							const tipo_vista *vista;
+							uint32_t secuencia;
+							uint64_t t_nave = traza_inicio();
+							uint64_t t_inicio = simulador_ns(CLOCK_MONOTONIC), c_inicio = simulador_ns(CLOCK_THREAD_CPUTIME_ID);
+							uint64_t t_limite, fin;
+							int num_acciones;
+
+							/* Si el simulador publica otra vista mientras se decide, se decide otra vez
+							 * sobre la nueva para no mezclar dos turnos */
+							do {
+								vista = mapa_vista_obtener(mapa, &secuencia);
+								num_acciones = nave_decidir(vista, i, j, acciones);
+								t_limite = vista->t_limite;
+							} while(!mapa_vista_vigente(vista, secuencia));
+							int turno_nave = vista->turno;
+
+							/* Publica lo que ha tardado; el turno va el último para que el
+							 * simulador lea ya el resto */
+							fin = simulador_ns(CLOCK_MONOTONIC);
+							tiempos->decision_ns = fin - t_inicio;
+							tiempos->cpu_ns = simulador_ns(CLOCK_THREAD_CPUTIME_ID) - c_inicio;
+							tiempos->decision_total_ns += tiempos->decision_ns;
+							tiempos->cpu_total_ns += tiempos->cpu_ns;
+							if(tiempos->decision_ns > tiempos->decision_max_ns)
+								tiempos->decision_max_ns = tiempos->decision_ns;
+							tiempos->decisiones++;
+							tiempos->tarde = t_limite > 0 && fin > t_limite;
+							__atomic_store_n(&tiempos->turno, turno_nave, __ATOMIC_RELEASE);
+
+							traza_fin(TR_DECISION, t_nave, turno_nave, i, j, num_acciones);
+
+							/* Fuera de plazo no publica nada: la nave se queda como está este turno.
+							 * Publicar nunca espera, vaya como vaya el simulador */
+							if(!tiempos->tarde) {
+								t_nave = traza_inicio();
+								for(int k = 0; k < num_acciones; k++) {
+									acciones[k].turno = turno_nave;
+									acciones[k].t_envio = simulador_ns(CLOCK_MONOTONIC);
+								}
+								/* El jefe termina con SIGTERM a las naves destruidas: a medio publicar
+								 * dejaría la intención impar y el simulador esperándola para siempre */
+								sigprocmask(SIG_BLOCK, &bloqueo, NULL);
+								intencion_publicar(intenciones, i, j, turno_nave, acciones, num_acciones);
+								sigprocmask(SIG_UNBLOCK, &bloqueo, NULL);
+								traza_fin(TR_ENVIO, t_nave, turno_nave, i, j, num_acciones);
 							}
 						}
 
@@ -570,6 +1377,7 @@ int main() {
 		        } else {
 		        	/* Guarda el pid de la nave recién creada para poder mandar la señal sigterm al finalizar */
 		        	pid_naves[j] = PIDnave;
+		        	viva[j] = true;
 		        }
 			}
 
@@ -582,45 +1390,50 @@ int main() {
 
 				if(strcmp(buffer, "TURNO") == 0) {
 
+					/* Si una nave no ha consumido las órdenes anteriores (por ejemplo, porque
+					 * sigue decidiendo) se descarta la orden para que el jefe no se bloquee */
+					t_relevo = traza_inicio();
 					for(int numOwnNave = 0; numOwnNave < N_NAVES; numOwnNave++) {	
+						if(!viva[numOwnNave])
+							continue;
 						bzero(buffer, sizeof(buffer));		
 						sprintf(buffer, "ACCION ATAQUE");
-						if(pipe_write(fd2[numOwnNave], buffer) < 0) {
+						if(canal_try_write(&fd2[numOwnNave], buffer) < 0) {
 							printf("ERROR DE JEFE: escribiendo en la tubería.\n");
 							exit(EXIT_FAILURE);
 						}
 					}
+					traza_fin(TR_RELEVO, t_relevo, mapa->turno, i, -1, num_vivas);
 				} else if(strcmp(buffer, "FIN") == 0) {
-					/* Manda SIGTERM a todas las naves y espera para finalizar su ejecución */
+					/* Manda SIGTERM a las naves que quedan y espera para finalizar su ejecución */
 					for(int k = 0; k < N_NAVES; k++) {
-						kill(pid_naves[k], SIGTERM);
+						if(viva[k])
+							kill(pid_naves[k], SIGTERM);
 					}
 
 					while(wait(NULL) > 0);
 					exit(EXIT_SUCCESS);
 
-				} else {
-
-					for(int numOwnNave = 0; numOwnNave < N_NAVES; numOwnNave++) {
-						/* Comprueba que proceso a de destruir */
-						char buffer_aux[PIPE_MAXSIZE];	
-						sprintf(buffer_aux, "DESTRUIR <%d>", numOwnNave);
-						if(strcmp(buffer, buffer_aux) == 0) {
-							bzero(buffer, sizeof(buffer));		
-							sprintf(buffer, "DESTRUIR");
-							if(pipe_write(fd2[numOwnNave], buffer) < 0) {
-								printf("ERROR DE JEFE: escribiendo en la tubería.\n");
-								exit(EXIT_FAILURE);
-							}
-						}
-					}
+				} else if(sscanf(buffer, "DESTRUIR <%d>", &destruida) == 1 && destruida >= 0 && destruida < N_NAVES && viva[destruida]) {
+					/* La nave destruida no vuelve a decidir: se termina su proceso y se recoge
+					 * ya, en lugar de dejarlo leyendo órdenes hasta el final de la partida,
+					 * y se cierra su canal */
+					kill(pid_naves[destruida], SIGTERM);
+					waitpid(pid_naves[destruida], NULL, 0);
+					canal_cerrar(&fd2[destruida]);
+					viva[destruida] = false;
+					num_vivas--;
 				}
-
-				sleep(1);
 			}
         }
 	}
  	
+	/* El hilo del registro se crea después de los procesos hijos, que no lo heredan */
+	if(registro_init(fichero_registro, nivel_registro) < 0) {
+		printf("ERROR DE SIMULADOR: iniciando el registro.\n");
+		exit(EXIT_FAILURE);
+	}
+
  	fprintf(stdout, "Simulador gestionando senales\n");
 	/* Creación del manejador encargado de capturar SIGINT */
 	if(manejador_SIGINT_create(act_SIGINT) < 0) {
@@ -634,24 +1447,55 @@ int main() {
 	    exit(EXIT_FAILURE);
 	}
 
-	alarm(TURNO_SECS);
+	/* Creación del manejador encargado de capturar SIGUSR1 (nivel del registro) */
+	if(manejador_SIGUSR1_create(act_SIGUSR1) < 0) {
+	    printf("ERROR DE SIMULADOR: creando el manejador_SIGUSR1.\n");
+	    exit(EXIT_FAILURE);
+	}
 
-	sleep(TURNO_SECS+1);
+	/* Después de crear los procesos y el hilo del registro, que no lo heredan */
+	afinidad_principal("Simulador");
+
+	if(semilla >= 0)
+		simulador_partida(semilla, max_turnos, tuberia);
+	if(direccion_servidor != NULL)
+		simulador_servidor(direccion_servidor, limite_ms, max_turnos);
+
+	/* Espera a que todas las naves estén listas y lanza el primer turno */
+	if(!modo_externo)
+		simulador_esperar_naves();
+	simulador_turno();
+
+	fprintf(stdout, "Simulador: primer turno a los %.3f ms del arranque\n", simulador_ms_desde(&t_arranque));
+	fflush(stdout);
 
     while(1) {
 
     	tipo_accion accion;
 
-    	fprintf(stdout, "Simulador: escuchando cola mensajes\n");
+    	/* Interrupción pendiente */
+    	if(int_flag)
+    		simulador_interrumpir();
 
-    	/* Recibe el mensaje de la cola de mensajes */
-    	mq_receive(queue, (char*)&accion, QUEUE_MAXSIZE, NULL);
+    	/* Fin de turno pendiente */
+    	if(alrm_flag) {
+    		alrm_flag = false;
+    		simulador_turno();
+    	}
 
-    	fprintf(stdout, "Simulador: recibido en cola de mensajes\n");
+    	registro_evento(EV_ESCUCHANDO);
 
-		simulador_update(accion);
+    	/* Recoge los mensajes de la cola. La espera está acotada para
+    	 * atender el fin de turno aunque no lleguen mensajes */
+    	simulador_recibir();
+    	if(!planificador_despachar(mapa, &accion))
+    		continue;
+
+    	simulador_update(accion);
+    	__atomic_store_n(&mapa->acciones_procesadas, mapa->acciones_procesadas + 1, __ATOMIC_RELEASE);
 
-	    usleep(SIM_REFRESH);
+    	if(!sin_pausas)
+    		usleep(SIM_REFRESH);
     }
 }
 
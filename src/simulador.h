@@ -2,17 +2,57 @@
 #define SRC_SIMULADOR_H_
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <semaphore.h>
 
+#ifndef N_EQUIPOS
 #define N_EQUIPOS 4// Número de equipos
+#endif
+#ifndef N_NAVES
 #define N_NAVES 3 // Número de naves por equipo
+#endif
 #define PIPE_MAXSIZE 512 // Longitud máxima del array usado en las tuberías
 #define QUEUE_MAXSIZE 512 // Longitud máxima del array usado en la cola de mensajes
 
 /*** SCREEN ***/
-extern char symbol_equipos[N_EQUIPOS]; // Símbolos de los diferentes equipos en el mapa (mirar mapa.c)
+extern const char symbol_equipos[]; // Símbolos de los diferentes equipos en el mapa (mirar mapa.c)
+#ifndef MAPA_MAXX
 #define MAPA_MAXX 12 // Número de columnas del mapa
-#define MAPA_MAXY 12 // Número de
-#define SCREEN_REFRESH 10000 // Frequencia de refresco del mapa en el monitor
+#endif
+#ifndef MAPA_MAXY
+#define MAPA_MAXY 12 // Número de filas del mapa
+#endif
+/* Orden de las casillas en memoria (mapa_casilla). Por teselas el mapa se guarda en
+ * cuadrados de MAPA_TESELA x MAPA_TESELA casillas seguidas, por filas dentro de cada
+ * una o en orden Morton (Z), para que las consultas en un cuadrado alrededor de una
+ * casilla toquen menos líneas de caché y páginas en mapas anchos. Con MORTON y una
+ * tesela que cubre todo el mapa el orden Z es el de todo el mapa */
+#define MAPA_ORDEN_FILAS 0
+#define MAPA_ORDEN_TESELAS 1
+#define MAPA_ORDEN_MORTON 2
+#ifndef MAPA_ORDEN
+#define MAPA_ORDEN MAPA_ORDEN_FILAS
+#endif
+#ifndef MAPA_TESELA
+#define MAPA_TESELA 8 // Lado de las teselas, potencia de dos
+#endif
+#if MAPA_ORDEN == MAPA_ORDEN_FILAS
+#define MAPA_CASILLAS (MAPA_MAXY * MAPA_MAXX)
+#define MAPA_DISPOSICION 0
+#else
+#define MAPA_TESELAS_X ((MAPA_MAXX + MAPA_TESELA - 1) / MAPA_TESELA) // Teselas por fila, la última incompleta
+#define MAPA_TESELAS_Y ((MAPA_MAXY + MAPA_TESELA - 1) / MAPA_TESELA)
+#define MAPA_CASILLAS (MAPA_TESELAS_Y * MAPA_TESELAS_X * MAPA_TESELA * MAPA_TESELA)
+#define MAPA_DISPOSICION (MAPA_ORDEN << 16 | MAPA_TESELA)
+#endif
+#define BITS_PALABRAS ((MAPA_MAXX + 63) / 64) // Palabras de 64 bits por fila en los planos de ocupación
+#define OCUPACION_TODAS N_EQUIPOS // Plano de ocupación de naves de cualquier equipo
+#define SCREEN_FPS 30 // Fotogramas por segundo máximos del monitor
+#define SCREEN_ESPERA_MS 1000 // Espera máxima del monitor sin cambios en el mapa
+#define MIP_NIVELES 4 // Niveles de zoom del monitor: bloques de 2x2, 4x4, 8x8 y 16x16 casillas
+#define MIP_LADO(n, nivel) (((n) + (1 << (nivel)) - 1) >> (nivel)) // Bloques por lado en un nivel
+#define MIP_BLOQUES(nivel) (MIP_LADO(MAPA_MAXY, nivel) * MIP_LADO(MAPA_MAXX, nivel))
+#define MIP_CELDAS (MIP_BLOQUES(1) + MIP_BLOQUES(2) + MIP_BLOQUES(3) + MIP_BLOQUES(4))
 #define SYMB_VACIO '.' // Símbolo para casilla vacia
 #define SYMB_TOCADO '%' // Símbolo para tocado
 #define SYMB_DESTRUIDO 'X' // Símbolo para destruido
@@ -21,10 +61,19 @@ extern char symbol_equipos[N_EQUIPOS]; // Símbolos de los diferentes equipos en
 /*** SIMULACION ***/
 #define VIDA_MAX 20 // Vida inicial de una nave
 #define ATAQUE_ALCANCE 5 // Distancia máxima de un ataque
+#define AMENAZA_RADIO (ATAQUE_ALCANCE - 1) // Casillas a las que llega un ataque (distancia < ATAQUE_ALCANCE)
 #define ATAQUE_DANO 10 // Daño de un ataque
 #define MOVER_ALCANCE 1 // Máximo de casillas a mover
+#ifndef TURNO_SECS
 #define TURNO_SECS 10 // Segundos que dura un turno
+#endif
 #define SIM_REFRESH 200000 // Frequencia de refresco del simulador
+#define PARTIDA_MAX_TURNOS 1000 // Turnos máximos de una partida sin procesos (-H)
+#define SERVIDOR_LIMITE_MS 1000 // Plazo por defecto de cada equipo para responder a un turno (-S)
+#define NAVE_PLAZO_MS (TURNO_SECS * 1000 / 2) // Plazo por defecto de cada nave para decidir en un turno (-P)
+#define NAVE_TARDIAS_MAX 3 // Turnos seguidos sin decidir a tiempo tras los que se señala a una nave
+#define ACCIONES_MAX_TURNO 2 // Acciones que el simulador acepta de cada nave por turno
+#define PLAN_QUANTUM 1 // Acciones por ronda que el planificador da a cada equipo
 
 
 /*** MAPA ***/
@@ -43,13 +92,103 @@ typedef struct {
 	char simbolo; // Símbolo que se mostrará en la pantalla para esta casilla
 	int equipo; // Si está vacia = -1. Si no, número de equipo de la nave que está en la casilla
 	int numNave; // Número de nave en el equipo de la nave que está en la casilla
+	bool marcada; // Si el símbolo se ha cambiado este turno y está en la lista de marcas
 } tipo_casilla;
 
+// Métricas del planificador de acciones para un equipo
+typedef struct {
+	unsigned long encoladas; // Acciones aceptadas en las subcolas del equipo
+	unsigned long descartadas; // Acciones rechazadas por superar el cupo de la nave o por subcola llena
+	unsigned long despachadas; // Acciones entregadas a simulador_update
+	unsigned long espera_total_us; // Suma de la espera desde el envío hasta el despacho
+	unsigned long espera_max_us; // Mayor espera observada
+} tipo_planificacion;
+
+// Estadísticas de un equipo, mantenidas al actualizar el mapa
+typedef struct {
+	int naves_vivas; // Número de naves vivas en el equipo
+	int vida_total; // Suma de la vida de las naves vivas
+	int bajas; // Naves enemigas destruidas por el equipo
+	int dano_causado; // Daño total causado a naves enemigas
+} tipo_estadisticas;
+
+// Tiempos de decisión de una nave. La nave escribe los de la primera parte y
+// el simulador los contadores de plazos, cada uno en su turno
+typedef struct {
+	int turno; // Último turno en el que la nave ha decidido, -1 si ninguno
+	bool tarde; // Si en ese turno terminó de decidir fuera de plazo
+	uint64_t decision_ns; // Tiempo real de la última decisión
+	uint64_t cpu_ns; // Tiempo de CPU de la última decisión
+	uint64_t decision_max_ns; // Mayor tiempo real de una decisión
+	uint64_t decision_total_ns; // Suma de los tiempos reales
+	uint64_t cpu_total_ns; // Suma de los tiempos de CPU
+	unsigned long decisiones; // Turnos en los que ha decidido
+	unsigned long tardias; // Turnos que ha terminado sin decidir a tiempo
+	unsigned long descartadas; // Acciones suyas recibidas fuera de plazo o repetidas en un turno y descartadas
+	unsigned long recogidas; // Acciones suyas recogidas por el simulador
+	unsigned long sustituidas; // Acciones suyas sustituidas por otras más nuevas antes de recogerlas
+	int turno_recogido; // Último turno del que se ha recogido su intención, -1 si ninguno
+	int seguidas; // Turnos seguidos sin decidir a tiempo
+	bool senalada; // Si ha llegado a NAVE_TARDIAS_MAX turnos seguidos sin decidir a tiempo
+} tipo_tiempos_nave;
+
+// Copia inmutable del mapa al empezar un turno, sobre la que deciden las naves
+typedef struct {
+	uint32_t secuencia; // Impar mientras el simulador la está escribiendo
+	int turno; // Turno para el que se publicó
+	uint64_t t_limite; // Instante (ns de CLOCK_MONOTONIC) hasta el que se aceptan acciones del turno, 0 sin plazo
+	int equipos_vivos;
+	tipo_estadisticas estadisticas[N_EQUIPOS];
+	tipo_nave naves[N_EQUIPOS][N_NAVES];
+	int vivas[N_EQUIPOS][N_NAVES]; // Como en tipo_mapa (solo las estadisticas[e].naves_vivas primeras)
+	uint64_t ocupacion[N_EQUIPOS + 1][MAPA_MAXY][BITS_PALABRAS]; // Como en tipo_mapa
+	int indices[MAPA_MAXY][MAPA_MAXX]; // equipo * N_NAVES + nave de la nave en cada casilla, -1 si está vacía
+} tipo_vista;
+
+// Cabecera al principio del segmento del mapa. Describe los tamaños y la
+// posición de los campos que leen los observadores (observador.h), que así no
+// necesitan compilarse con las mismas constantes que el simulador
+#define MAPA_MAGIA "MAPANAV1"
+#define MAPA_VERSION 3 // Cambia si cambia esta cabecera, tipo_nave o tipo_estadisticas
+#define MAPA_SIMBOLOS_MAX 64
+typedef struct {
+	char magia[8]; // MAPA_MAGIA una vez que el resto de la cabecera está completa
+	uint32_t version;
+	uint32_t disposicion; // MAPA_DISPOSICION: orden de las casillas (0 por filas)
+	uint64_t tamano; // sizeof(tipo_mapa)
+	int32_t num_equipos, num_naves, maxy, maxx;
+	int32_t tam_nave, tam_estadisticas;
+	uint64_t tam_vista;
+	uint64_t off_generacion, off_turno, off_vistas, off_vista_actual; // En tipo_mapa
+	uint64_t off_vista_secuencia, off_vista_turno, off_vista_equipos_vivos; // En tipo_vista
+	uint64_t off_vista_estadisticas, off_vista_naves, off_vista_indices;
+	char simbolos[MAPA_SIMBOLOS_MAX]; // Símbolo de cada equipo
+	uint32_t paginas_grandes; // 1 si el simulador ha pedido páginas grandes para el segmento
+	uint32_t relleno;
+} tipo_mapa_cabecera;
 
 typedef struct {
+	tipo_mapa_cabecera cabecera; // Siempre al principio
 	tipo_nave info_naves[N_EQUIPOS][N_NAVES];
-	tipo_casilla casillas[MAPA_MAXY][MAPA_MAXX];
-	int num_naves[N_EQUIPOS]; // Número de naves vivas en un equipo
+	tipo_casilla casillas[MAPA_CASILLAS]; // En el orden MAPA_ORDEN: la de y,x es casillas[mapa_casilla(y, x)]
+	uint64_t ocupacion[N_EQUIPOS + 1][MAPA_MAXY][BITS_PALABRAS]; // Bit x de la fila y: hay nave del equipo (o de cualquiera)
+	unsigned short mip[MIP_CELDAS][N_EQUIPOS]; // Naves de cada equipo por bloque, niveles 1 a MIP_NIVELES seguidos
+	tipo_estadisticas estadisticas[N_EQUIPOS]; // Estadísticas de cada equipo
+	int vivas[N_EQUIPOS][N_NAVES]; // Números de las naves vivas de cada equipo, las estadisticas[e].naves_vivas primeras
+	int indice_viva[N_EQUIPOS][N_NAVES]; // Posición de cada nave viva en 'vivas'
+	int equipos_vivos; // Número de equipos con alguna nave viva
+	int marcas[MAPA_MAXY * MAPA_MAXX]; // Casillas cuyo símbolo se ha cambiado este turno (y * MAPA_MAXX + x)
+	int num_marcas;
+	unsigned long acciones_procesadas; // Mensajes de la cola ya procesados por el simulador
+	int turno; // Turno en curso, para que jefes y naves lo anoten en las trazas
+	tipo_vista vistas[2]; // Doble buffer: una publicada y la otra para el turno siguiente
+	uint32_t vista_actual; // Índice de la vista publicada
+	uint32_t generacion; // Se incrementa con cada cambio visible del mapa (palabra futex)
+	tipo_planificacion planificacion[N_EQUIPOS]; // Métricas del planificador por equipo
+	uint64_t plazo_ns; // Plazo de cada nave para decidir en un turno, 0 sin plazo
+	tipo_tiempos_nave tiempos[N_EQUIPOS][N_NAVES]; // Tiempos de decisión de cada nave
+	int naves_listas; // Número de procesos nave que ya esperan órdenes
+	sem_t sem_listas; // Se activa cuando todas las naves están listas
 } tipo_mapa;
 
 
@@ -62,9 +201,14 @@ typedef struct {
 	int oriX;
 	int desY;
 	int desX;
+	uint64_t t_envio; // Instante de envío en ns de CLOCK_MONOTONIC (0 si no se conoce)
+	int turno; // Turno para el que se decidió (lo anotan las naves)
 } tipo_accion;
 
 #define SHM_MAP_NAME "/shm_naves"
+/* Procesos bloqueados esperando un cambio de generación (un uint32_t). Va aparte para
+ * que quien solo observa el mapa lo mapee en solo lectura y pueda apuntarse igualmente */
+#define SHM_AVISOS_NAME SHM_MAP_NAME "_avisos"
 #define SEM_CTRL "/sem_ctrl"
 #define MQ_NAME "/mq_naves"
 
@@ -0,0 +1,241 @@
+/**
+ *
+ * Descripcion: trazas de intervalos entre procesos. El simulador crea antes de
+ *		los fork un segmento compartido con un buffer por proceso (simulador,
+ *		jefes y naves). Cada proceso es el único escritor de su buffer, así
+ *		que anotar un intervalo es copiar 32 bytes sin cerrojos. Al terminar,
+ *		el simulador guarda todos los buffers en un fichero que 'traza'
+ *		convierte al formato JSON de Chrome/Perfetto.
+ *
+ * Fichero: traza.c
+ * Autor: Miguel González Bustamante, miguel.gonzalezb@estudiante.uam.es
+ * Grupo: 2261
+ * Fecha: 08-05-2019
+ *
+ */
+
+#include <sys/mman.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <traza.h>
+
+#define TRAZA_VERSION 1
+
+static const char *nombres[TR_NUM_TIPOS] = {
+	[TR_FIN_TURNO] = "fin de turno",
+	[TR_RESOLUCION] = "resolucion",
+	[TR_ACCION] = "accion",
+	[TR_RELEVO] = "relevo jefe",
+	[TR_DECISION] = "decision",
+	[TR_ENVIO] = "envio",
+};
+
+static char *segmento = NULL; // Buffers de todos los procesos
+static size_t tam_segmento = 0;
+static tipo_traza_buffer *propio = NULL; // Buffer del proceso que llama
+static tipo_intervalo_traza *intervalos = NULL;
+
+/****************************************************************************/
+/* Funcion: traza_capacidad                                                 */
+/*                                                                          */
+/* Descripcion: obtiene la capacidad del buffer de un proceso.              */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		int proceso: número de buffer                                       */
+/* Parametros de salida: número de intervalos.                              */
+/****************************************************************************/
+static uint32_t traza_capacidad(int proceso) {
+	if(proceso == TRAZA_SIMULADOR)
+		return TRAZA_CAP_SIMULADOR;
+	return (proceso < TRAZA_NAVE(0, 0)) ? TRAZA_CAP_JEFE : TRAZA_CAP_NAVE;
+}
+
+/****************************************************************************/
+/* Funcion: traza_desplazamiento                                            */
+/*                                                                          */
+/* Descripcion: calcula dónde empieza el buffer de un proceso.              */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		int proceso: número de buffer (TRAZA_PROCESOS para el total)        */
+/* Parametros de salida: bytes desde el inicio del segmento.                */
+/****************************************************************************/
+static size_t traza_desplazamiento(int proceso) {
+	size_t bytes = 0;
+	int previos;
+
+	/* Simulador, jefes y naves van en ese orden */
+	for(int p = 0; p < 3; p++) {
+		int primero = (p == 0) ? TRAZA_SIMULADOR : (p == 1) ? TRAZA_JEFE(0) : TRAZA_NAVE(0, 0);
+		int ultimo = (p == 0) ? TRAZA_JEFE(0) : (p == 1) ? TRAZA_NAVE(0, 0) : TRAZA_PROCESOS;
+
+		previos = ((proceso < ultimo) ? proceso : ultimo) - primero;
+		if(previos <= 0)
+			break;
+		bytes += previos * (sizeof(tipo_traza_buffer) + traza_capacidad(primero) * sizeof(tipo_intervalo_traza));
+	}
+	return bytes;
+}
+
+/****************************************************************************/
+/* Funcion: traza_crear                                                     */
+/*                                                                          */
+/* Descripcion: reserva los buffers de todos los procesos en una región     */
+/*		compartida anónima. Las páginas de las naves que no llegan a anotar */
+/*		nada no ocupan memoria.                                             */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/* Parametros de salida: 0 si se ha creado o -1 si no.                      */
+/****************************************************************************/
+int traza_crear() {
+	tam_segmento = traza_desplazamiento(TRAZA_PROCESOS);
+	segmento = mmap(NULL, tam_segmento, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if(segmento == MAP_FAILED) {
+		segmento = NULL;
+		return -1;
+	}
+
+	for(int p = 0; p < TRAZA_PROCESOS; p++)
+		((tipo_traza_buffer *)(segmento + traza_desplazamiento(p)))->capacidad = traza_capacidad(p);
+	traza_proceso(TRAZA_SIMULADOR);
+	return 0;
+}
+
+/****************************************************************************/
+/* Funcion: traza_proceso                                                   */
+/*                                                                          */
+/* Descripcion: selecciona el buffer en el que anota el proceso.            */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		int proceso: número de buffer                                       */
+/* Parametros de salida: void                                               */
+/****************************************************************************/
+void traza_proceso(int proceso) {
+	if(segmento == NULL)
+		return;
+	propio = (tipo_traza_buffer *)(segmento + traza_desplazamiento(proceso));
+	propio->pid = getpid();
+	propio->proceso = proceso;
+	intervalos = (tipo_intervalo_traza *)(propio + 1);
+}
+
+/****************************************************************************/
+/* Funcion: traza_inicio                                                    */
+/*                                                                          */
+/* Descripcion: marca el inicio de un intervalo.                            */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/* Parametros de salida: nanosegundos de CLOCK_MONOTONIC, o 0 si las trazas */
+/*		no están activas.                                                   */
+/****************************************************************************/
+uint64_t traza_inicio() {
+	struct timespec t;
+
+	if(propio == NULL)
+		return 0;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t)t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+/****************************************************************************/
+/* Funcion: traza_fin                                                       */
+/*                                                                          */
+/* Descripcion: anota un intervalo en el buffer del proceso. Si está lleno  */
+/*		sobrescribe los más antiguos.                                       */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		int tipo: tipo_intervalo                                            */
+/*		uint64_t inicio: valor devuelto por traza_inicio                    */
+/*		int turno, equipo, nave: a qué corresponde el intervalo             */
+/*		int dato: información adicional según el tipo                       */
+/* Parametros de salida: void                                               */
+/****************************************************************************/
+void traza_fin(int tipo, uint64_t inicio, int turno, int equipo, int nave, int dato) {
+	tipo_intervalo_traza *it;
+
+	if(propio == NULL || inicio == 0)
+		return;
+
+	it = &intervalos[propio->escritos % propio->capacidad];
+	it->inicio = inicio;
+	it->fin = traza_inicio();
+	it->turno = turno;
+	it->equipo = equipo;
+	it->nave = nave;
+	it->tipo = tipo;
+	it->dato = dato;
+	__atomic_store_n(&propio->escritos, propio->escritos + 1, __ATOMIC_RELEASE);
+}
+
+/****************************************************************************/
+/* Funcion: traza_guardar                                                   */
+/*                                                                          */
+/* Descripcion: escribe la cabecera y, de cada proceso que haya anotado     */
+/*		algo, su buffer con los intervalos que conserva en orden.           */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		const char *fichero: fichero de destino                             */
+/* Parametros de salida: 0 si se ha guardado o -1 si no.                    */
+/****************************************************************************/
+int traza_guardar(const char *fichero) {
+	tipo_traza_cabecera cab;
+	tipo_traza_buffer buf;
+	tipo_intervalo_traza *lista;
+	uint32_t guardados, primero;
+	FILE *f;
+	int p, procesos = 0;
+
+	if(segmento == NULL)
+		return -1;
+
+	f = fopen(fichero, "wb");
+	if(f == NULL)
+		return -1;
+
+	for(p = 0; p < TRAZA_PROCESOS; p++)
+		procesos += ((tipo_traza_buffer *)(segmento + traza_desplazamiento(p)))->escritos > 0;
+
+	memcpy(cab.magia, TRAZA_MAGIA, sizeof(cab.magia));
+	cab.version = TRAZA_VERSION;
+	cab.num_equipos = N_EQUIPOS;
+	cab.num_naves = N_NAVES;
+	cab.procesos = procesos;
+	fwrite(&cab, sizeof(cab), 1, f);
+
+	for(p = 0; p < TRAZA_PROCESOS; p++) {
+		buf = *(tipo_traza_buffer *)(segmento + traza_desplazamiento(p));
+		if(buf.escritos == 0)
+			continue;
+		lista = (tipo_intervalo_traza *)(segmento + traza_desplazamiento(p) + sizeof(tipo_traza_buffer));
+
+		/* Se guardan los que quedan, del más antiguo al más reciente */
+		guardados = (buf.escritos < buf.capacidad) ? buf.escritos : buf.capacidad;
+		primero = (buf.escritos < buf.capacidad) ? 0 : buf.escritos % buf.capacidad;
+		buf.escritos = guardados;
+		fwrite(&buf, sizeof(buf), 1, f);
+		fwrite(&lista[primero], sizeof(tipo_intervalo_traza), guardados - primero, f);
+		fwrite(lista, sizeof(tipo_intervalo_traza), primero, f);
+	}
+
+	fclose(f);
+	munmap(segmento, tam_segmento);
+	segmento = NULL;
+	propio = NULL;
+	return 0;
+}
+
+/****************************************************************************/
+/* Funcion: traza_nombre                                                    */
+/*                                                                          */
+/* Descripcion: obtiene el nombre de un tipo de intervalo.                  */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		int tipo: tipo_intervalo                                            */
+/* Parametros de salida: nombre o "?" si no existe.                         */
+/****************************************************************************/
+const char *traza_nombre(int tipo) {
+	if(tipo < 0 || tipo >= TR_NUM_TIPOS)
+		return "?";
+	return nombres[tipo];
+}
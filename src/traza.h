@@ -0,0 +1,76 @@
+#ifndef SRC_TRAZA_H_
+#define SRC_TRAZA_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <simulador.h>
+
+#define TRAZA_MAGIA "TRAZNAV1" // Cabecera de los ficheros de trazas
+#define TRAZA_CAP_SIMULADOR 65536 // Intervalos que guarda el simulador (se conservan los últimos)
+#define TRAZA_CAP_JEFE 4096 // Intervalos que guarda cada jefe
+#define TRAZA_CAP_NAVE 512 // Intervalos que guarda cada nave
+
+/* Buffer de cada proceso dentro del segmento de trazas */
+#define TRAZA_SIMULADOR 0
+#define TRAZA_JEFE(equipo) (1 + (equipo))
+#define TRAZA_NAVE(equipo, nave) (1 + N_EQUIPOS + (equipo) * N_NAVES + (nave))
+#define TRAZA_PROCESOS (1 + N_EQUIPOS + N_EQUIPOS * N_NAVES)
+
+/* Tipos de intervalo. El nombre de cada uno está en traza_nombre */
+typedef enum {
+	TR_FIN_TURNO, // Simulador: cierre del turno y envío de TURNO a los jefes
+	TR_RESOLUCION, // Simulador: resolución conjunta de los movimientos
+	TR_ACCION, // Simulador: aplicación de una acción recibida
+	TR_RELEVO, // Jefe: reparto de la orden del turno a sus naves
+	TR_DECISION, // Nave: decisión de sus acciones
+	TR_ENVIO, // Nave: envío de las acciones por la cola de mensajes
+	TR_NUM_TIPOS
+} tipo_intervalo;
+
+/* Intervalo de tiempo de un proceso */
+typedef struct {
+	uint64_t inicio; // Nanosegundos de CLOCK_MONOTONIC
+	uint64_t fin;
+	int32_t turno;
+	int16_t equipo; // -1 si no corresponde
+	int16_t nave;
+	int32_t tipo; // tipo_intervalo
+	int32_t dato; // Según el tipo: en TR_ACCION microsegundos desde que la nave envió la acción
+} tipo_intervalo_traza;
+
+/* Cabecera de un buffer y del fichero, antes de sus intervalos */
+typedef struct {
+	int32_t pid;
+	int32_t proceso; // TRAZA_SIMULADOR, TRAZA_JEFE o TRAZA_NAVE
+	uint32_t escritos; // Intervalos escritos; si supera la capacidad solo quedan los últimos
+	uint32_t capacidad;
+} tipo_traza_buffer;
+
+typedef struct {
+	char magia[8]; // TRAZA_MAGIA
+	int32_t version;
+	int32_t num_equipos;
+	int32_t num_naves;
+	int32_t procesos; // Buffers que siguen a la cabecera
+} tipo_traza_cabecera;
+
+/* Crea el segmento de trazas con un buffer para cada proceso. Debe hacerse
+ * antes de crear los procesos, que lo heredan. Retorna -1 si no es posible */
+int traza_crear();
+
+/* Elige el buffer del proceso que llama (TRAZA_SIMULADOR, TRAZA_JEFE(i) o TRAZA_NAVE(i, j)) */
+void traza_proceso(int proceso);
+
+/* Instante de inicio de un intervalo, o 0 si las trazas no están activas */
+uint64_t traza_inicio();
+
+/* Guarda el intervalo que empezó en 'inicio' y termina ahora */
+void traza_fin(int tipo, uint64_t inicio, int turno, int equipo, int nave, int dato);
+
+/* Escribe en el fichero los buffers de todos los procesos y libera el segmento */
+int traza_guardar(const char *fichero);
+
+/* Obtiene el nombre de un tipo de intervalo */
+const char *traza_nombre(int tipo);
+
+#endif /* SRC_TRAZA_H_ */
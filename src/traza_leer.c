@@ -0,0 +1,134 @@
+/**
+ *
+ * Descripcion: convierte los ficheros de trazas que guarda el simulador con la
+ *		opción -T al formato JSON de eventos de Chrome, que se abre con
+ *		chrome://tracing o con ui.perfetto.dev. Cada proceso aparece con
+ *		su nombre (simulador, jefe o nave) y cada intervalo lleva el turno,
+ *		el equipo y la nave a los que corresponde.
+ *
+ * Fichero: traza_leer.c
+ * Autor: Miguel González Bustamante, miguel.gonzalezb@estudiante.uam.es
+ * Grupo: 2261
+ * Fecha: 08-05-2019
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <traza.h>
+
+/****************************************************************************/
+/* Funcion: traza_nombre_proceso                                            */
+/*                                                                          */
+/* Descripcion: nombre con el que se muestra un buffer de la traza.         */
+/*                                                                          */
+/* Parametros de entrada:                                                   */
+/*		tipo_traza_cabecera *cab: cabecera del fichero                      */
+/*		int proceso: número de buffer                                       */
+/*		char *nombre: cadena donde se escribe (al menos 32 caracteres)      */
+/* Parametros de salida: void                                               */
+/****************************************************************************/
+void traza_nombre_proceso(tipo_traza_cabecera *cab, int proceso, char *nombre) {
+	int nave;
+
+	/* Se decodifica con los tamaños del fichero, que pueden no ser los de esta compilación */
+	if(proceso == TRAZA_SIMULADOR) {
+		sprintf(nombre, "simulador");
+	} else if(proceso <= cab->num_equipos) {
+		sprintf(nombre, "jefe %c", 'A' + proceso - 1);
+	} else {
+		nave = proceso - 1 - cab->num_equipos;
+		sprintf(nombre, "nave %c%d", 'A' + nave / cab->num_naves, nave % cab->num_naves);
+	}
+}
+
+int main(int argc, char *argv[]) {
+	tipo_traza_cabecera cab;
+	tipo_traza_buffer *bufs;
+	tipo_intervalo_traza **listas, *it;
+	uint64_t origen = UINT64_MAX;
+	char nombre[32];
+	FILE *f, *salida = stdout;
+	int opt, p;
+	bool primero = true;
+
+	while((opt = getopt(argc, argv, "o:")) != -1) {
+		switch(opt) {
+			case 'o':
+				salida = fopen(optarg, "w");
+				if(salida == NULL) {
+					printf("ERROR DE TRAZA: creando %s.\n", optarg);
+					exit(EXIT_FAILURE);
+				}
+				break;
+			default:
+				printf("Uso: %s [-o salida.json] fichero\n", argv[0]);
+				exit(EXIT_FAILURE);
+		}
+	}
+
+	if(optind >= argc) {
+		printf("Uso: %s [-o salida.json] fichero\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	f = fopen(argv[optind], "rb");
+	if(f == NULL) {
+		printf("ERROR DE TRAZA: abriendo %s.\n", argv[optind]);
+		exit(EXIT_FAILURE);
+	}
+
+	if(fread(&cab, sizeof(cab), 1, f) != 1 || memcmp(cab.magia, TRAZA_MAGIA, sizeof(cab.magia)) != 0) {
+		printf("ERROR DE TRAZA: %s no es un fichero de trazas.\n", argv[optind]);
+		exit(EXIT_FAILURE);
+	}
+
+	/* Se cargan todos los buffers para conocer el instante más antiguo */
+	bufs = calloc(cab.procesos, sizeof(tipo_traza_buffer));
+	listas = calloc(cab.procesos, sizeof(tipo_intervalo_traza *));
+	if(bufs == NULL || listas == NULL) {
+		printf("ERROR DE TRAZA: sin memoria.\n");
+		exit(EXIT_FAILURE);
+	}
+	for(p = 0; p < cab.procesos; p++) {
+		if(fread(&bufs[p], sizeof(tipo_traza_buffer), 1, f) != 1
+			|| (listas[p] = malloc(bufs[p].escritos * sizeof(tipo_intervalo_traza) + 1)) == NULL
+			|| fread(listas[p], sizeof(tipo_intervalo_traza), bufs[p].escritos, f) != bufs[p].escritos) {
+			printf("ERROR DE TRAZA: %s está truncado.\n", argv[optind]);
+			exit(EXIT_FAILURE);
+		}
+		if(bufs[p].escritos > 0 && listas[p][0].inicio < origen)
+			origen = listas[p][0].inicio;
+	}
+	fclose(f);
+
+	/* Tiempos en microsegundos desde el primer intervalo; pid y tid son los del proceso */
+	fprintf(salida, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	for(p = 0; p < cab.procesos; p++) {
+		traza_nombre_proceso(&cab, bufs[p].proceso, nombre);
+		fprintf(salida, "%s{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":%d,\"args\":{\"name\":\"%s\"}}",
+			primero ? "" : ",\n", bufs[p].pid, nombre);
+		fprintf(salida, ",\n{\"ph\":\"M\",\"name\":\"process_sort_index\",\"pid\":%d,\"args\":{\"sort_index\":%d}}",
+			bufs[p].pid, bufs[p].proceso);
+		primero = false;
+
+		for(uint32_t k = 0; k < bufs[p].escritos; k++) {
+			it = &listas[p][k];
+			fprintf(salida, ",\n{\"ph\":\"X\",\"name\":\"%s\",\"cat\":\"%s\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,"
+				"\"args\":{\"turno\":%d,\"equipo\":\"%c\",\"nave\":%d,\"dato\":%d}}",
+				traza_nombre(it->tipo), bufs[p].proceso == TRAZA_SIMULADOR ? "simulador" : "equipo", bufs[p].pid, bufs[p].pid,
+				(it->inicio - origen) / 1e3, (it->fin - it->inicio) / 1e3,
+				it->turno, it->equipo < 0 ? '-' : 'A' + it->equipo, it->nave, it->dato);
+		}
+		free(listas[p]);
+	}
+	fprintf(salida, "\n]}\n");
+
+	if(salida != stdout)
+		fclose(salida);
+	free(listas);
+	free(bufs);
+	exit(EXIT_SUCCESS);
+}
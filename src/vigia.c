@@ -0,0 +1,108 @@
+/**
+ *
+ * Descripcion: ejemplo de proceso que sigue una partida con la biblioteca
+ *		de observadores (libmapa_observer.a). Solo incluye observador.h,
+ *		así que no hay que compilarlo con las constantes del simulador.
+ *		Escribe una línea por turno con el resumen de cada equipo y avisa
+ *		cuando un equipo pierde más de un umbral de naves en un turno.
+ *
+ * Fichero: vigia.c
+ * Autor: Miguel González Bustamante, miguel.gonzalezb@estudiante.uam.es
+ * Grupo: 2261
+ * Fecha: 08-05-2019
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+#include <observador.h>
+
+volatile sig_atomic_t fin = false;
+
+/* manejador: rutina de tratamiento de la señal SIGINT */
+void manejador_SIGINT(int sig) {
+	fin = true;
+}
+
+/* Escribe el resumen de cada equipo y los avisos de bajas del turno */
+void vigia_turno(tipo_observador *obs, tipo_obs_instantanea *inst, int *previas, int umbral) {
+	tipo_obs_agregados ag;
+
+	printf("turno %d vivos %d", inst->turno, inst->equipos_vivos);
+	for(int e = 0; e < inst->num_equipos; e++) {
+		observador_agregados(inst, e, &ag);
+		printf(" | %c naves %d vida %.1f centro %.1f,%.1f bajas %d", observador_simbolo(obs, e),
+			ag.naves_vivas, ag.vida_media, ag.centroy, ag.centrox, inst->estadisticas[e].bajas);
+	}
+	printf("\n");
+
+	for(int e = 0; e < inst->num_equipos; e++) {
+		observador_agregados(inst, e, &ag);
+		if(previas[e] >= 0 && previas[e] - ag.naves_vivas >= umbral)
+			printf("AVISO: el equipo %c ha perdido %d naves en el turno %d\n",
+				observador_simbolo(obs, e), previas[e] - ag.naves_vivas, inst->turno);
+		previas[e] = ag.naves_vivas;
+	}
+	fflush(stdout);
+}
+
+int main(int argc, char *argv[]) {
+	tipo_observador *obs;
+	tipo_obs_instantanea *inst;
+	char *segmento = NULL;
+	int opt, umbral = 1, max_turnos = -1, turno = -1, turnos = 0, equipos;
+	int *previas;
+	uint32_t generacion;
+
+	while((opt = getopt(argc, argv, "n:u:t:")) != -1) {
+		switch(opt) {
+			case 'n':
+				segmento = optarg;
+				break;
+			case 'u':
+				umbral = atoi(optarg);
+				break;
+			case 't':
+				max_turnos = atoi(optarg);
+				break;
+			default:
+				printf("Uso: %s [-n segmento] [-u bajas] [-t turnos]\n", argv[0]);
+				printf("  -u bajas  avisa si un equipo pierde al menos ese número de naves en un turno\n");
+				exit(EXIT_FAILURE);
+		}
+	}
+
+	obs = observador_abrir(segmento);
+	if(obs == NULL) {
+		perror("ERROR DE VIGIA: abriendo el mapa del simulador");
+		exit(EXIT_FAILURE);
+	}
+	observador_dimensiones(obs, &equipos, NULL, NULL, NULL);
+	inst = observador_instantanea_crear(obs);
+	previas = malloc(equipos * sizeof(int));
+	if(inst == NULL || previas == NULL) {
+		printf("ERROR DE VIGIA: reservando memoria.\n");
+		exit(EXIT_FAILURE);
+	}
+	for(int e = 0; e < equipos; e++) previas[e] = -1;
+
+	signal(SIGINT, manejador_SIGINT);
+	while(!fin && (max_turnos < 0 || turnos < max_turnos)) {
+		generacion = observador_generacion(obs);
+		if(observador_capturar(obs, inst) == 0 && inst->turno != turno) {
+			turno = inst->turno;
+			turnos++;
+			vigia_turno(obs, inst, previas, umbral);
+			if(inst->equipos_vivos < 2)
+				break;
+		}
+		observador_esperar(obs, generacion, 1000);
+	}
+
+	free(previas);
+	observador_instantanea_liberar(inst);
+	observador_cerrar(obs);
+	exit(EXIT_SUCCESS);
+}